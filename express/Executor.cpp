@@ -278,6 +278,36 @@ bool Executor::RuntimeManager::getInfo(Interpreter::SessionInfoCode code, void*
             auto dst = (int*)ptr;
             *dst = mInside->mResizeStatus;
         } break;
+        case Interpreter::MODULE_PLAN_CACHE: {
+            auto dst = (int*)ptr;
+            dst[0] = mInside->mPlanCacheHit;
+            dst[1] = mInside->mPlanCacheMiss;
+            return true;
+        } break;
+        case Interpreter::THREAD_POOL_QUEUE_DELAY: {
+            for (auto& r : mInside->mRuntime.first) {
+                if (r.second->onGetQueueDelay((float*)ptr)) {
+                    return true;
+                }
+            }
+            return false;
+        } break;
+        case Interpreter::HUGE_PAGES: {
+            for (auto& r : mInside->mRuntime.first) {
+                if (r.second->onGetHugePages((int*)ptr)) {
+                    return true;
+                }
+            }
+            return false;
+        } break;
+        case Interpreter::WEIGHT_PREFETCH: {
+            for (auto& r : mInside->mRuntime.first) {
+                if (r.second->onGetWeightPrefetch((int*)ptr)) {
+                    return true;
+                }
+            }
+            return false;
+        } break;
         default: {
             // Do nothing
         } break;
@@ -8,6 +8,7 @@
 
 #define FLATBUFFERS_PREFER_PRINTF
 #include <stack>
+#include <unordered_map>
 #include "core/OpCommonUtils.hpp"
 #include <MNN/expr/Expr.hpp>
 #include <MNN/expr/Executor.hpp>
@@ -108,11 +109,11 @@ bool VARP::fix(VARP::InputType type) const {
 }
 
 Expr::Expr(int outputSize) {
-    mInside.reset(new Inside(outputSize));
+    mInside = std::make_shared<Inside>(outputSize);
     mOutputNames.resize(outputSize);
 }
 Expr::Expr(Tensor* tensor, bool own) {
-    mInside.reset(new Inside(tensor, own));
+    mInside = std::make_shared<Inside>(tensor, own);
     mOutputNames.resize(1);
 }
 
@@ -124,7 +125,7 @@ Variable::Info* Expr::outputInfo(int index) const {
 }
 
 void Expr::_addLinkForInputs(EXPRP expr) {
-    auto inputs = expr->inputs();
+    auto& inputs = expr->inputs();
     for (int i=0; i<inputs.size(); ++i) {
         if (inputs[i].get() == nullptr) {
             continue;
@@ -225,6 +226,62 @@ EXPRP Expr::create(std::shared_ptr<BufferStorage> extra, std::vector<VARP>&& inp
     return expr;
 }
 
+// Op buffers of the same content are shared by the exprs created on a thread, since per-step helpers create the
+// same small ops again and again. The buffers are immutable, so the exprs sharing one can be used by any thread.
+static std::shared_ptr<BufferStorage> _internOp(const OpT* op) {
+    static const size_t gMaxInternSize = 4096;
+    static const size_t gMaxInternNumber = 4096;
+    static thread_local flatbuffers::FlatBufferBuilder builder(1024);
+    static thread_local std::unordered_map<uint64_t, std::weak_ptr<BufferStorage>> interned;
+    builder.Clear();
+    builder.Finish(Op::Pack(builder, op));
+    auto src = builder.GetBufferPointer();
+    size_t size = builder.GetSize();
+    if (size > gMaxInternSize) {
+        // Large ops (eg: with weights) are rarely repeated, take the buffer without hashing it
+        std::shared_ptr<BufferStorage> extra(new BufferStorage);
+        extra->storage = builder.ReleaseRaw(extra->allocated_size, extra->offset);
+        return extra;
+    }
+    uint64_t key = size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        ::memcpy(&word, src + i, 8);
+        key = (key ^ word) * 0x9E3779B97F4A7C15ULL;
+        key ^= key >> 29;
+    }
+    for (; i < size; ++i) {
+        key = (key ^ src[i]) * 0x9E3779B97F4A7C15ULL;
+    }
+    auto iter = interned.find(key);
+    if (iter != interned.end()) {
+        auto res = iter->second.lock();
+        if (nullptr != res && res->size() == size && 0 == ::memcmp(res->buffer(), src, size)) {
+            return res;
+        }
+    }
+    std::shared_ptr<BufferStorage> extra(new BufferStorage);
+    extra->storage = new uint8_t[size];
+    extra->allocated_size = size;
+    extra->offset = 0;
+    ::memcpy(extra->storage, src, size);
+    if (interned.size() >= gMaxInternNumber) {
+        for (iter = interned.begin(); iter != interned.end();) {
+            if (iter->second.expired()) {
+                iter = interned.erase(iter);
+            } else {
+                iter++;
+            }
+        }
+        if (interned.size() >= gMaxInternNumber) {
+            interned.clear();
+        }
+    }
+    interned[key] = extra;
+    return extra;
+}
+
 EXPRP Expr::create(const OpT* op, std::vector<VARP> inputs, int outputSize) {
     if (OpType_Input == op->type) {
         Variable::Info info;
@@ -238,12 +295,7 @@ EXPRP Expr::create(const OpT* op, std::vector<VARP> inputs, int outputSize) {
     }
     if (OpType_Const == op->type || OpType_TrainableParam == op->type) {
         if (!op->externalPath.empty() || (!op->main.AsBlob()->external.empty())) {
-            flatbuffers::FlatBufferBuilder builder;
-            auto offset = Op::Pack(builder, op);
-            builder.Finish(offset);
-            std::shared_ptr<BufferStorage> extra(new BufferStorage);
-            extra->storage = builder.ReleaseRaw(extra->allocated_size, extra->offset);
-            auto resExpr = Expr::create(extra, std::move(inputs), outputSize);
+            auto resExpr = Expr::create(_internOp(op), std::move(inputs), outputSize);
             resExpr->setName(op->name);
             return resExpr;
         }
@@ -293,12 +345,7 @@ EXPRP Expr::create(const OpT* op, std::vector<VARP> inputs, int outputSize) {
         }
         return expr;
     }
-    flatbuffers::FlatBufferBuilder builder;
-    auto offset = Op::Pack(builder, op);
-    builder.Finish(offset);
-    std::shared_ptr<BufferStorage> extra(new BufferStorage);
-    extra->storage = builder.ReleaseRaw(extra->allocated_size, extra->offset);
-    auto resExpr = Expr::create(extra, std::move(inputs), outputSize);
+    auto resExpr = Expr::create(_internOp(op), std::move(inputs), outputSize);
     resExpr->setName(op->name);
     return resExpr;
 }
@@ -1447,7 +1447,7 @@ max_class_per_detection: A int, indicates max class per detection.
 detections_per_class: A int, indicates detections per class.
 nms_threshhold: A float, the threshold for nms.
 iou_threshold: A float, the threshold for iou.
-use_regular_nms: A bool, indicates whether use regular nms method, only false is implemented currently.
+use_regular_nms: A bool, indicates whether use regular nms method (nms of every class) instead of nms on the max class score of every anchor.
 centersize_encoding: A float vector, indicates the centersize encoding.
 Returns:
 4 variable, detection_boxes, detection_class, detection_scores, num_detections
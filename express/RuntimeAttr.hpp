@@ -26,6 +26,9 @@ struct RuntimeAttr {
     // Use for static module to compute flops
     float mFlops;
     mutable int mResizeStatus = 0;
+    // Hit and miss counts of the static module plan cache
+    mutable int mPlanCacheHit = 0;
+    mutable int mPlanCacheMiss = 0;
 };
 struct ExecutorAttr {
     std::shared_ptr<Backend> constantBackend;
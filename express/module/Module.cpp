@@ -43,7 +43,7 @@ static MNN::Express::Executor::RuntimeManager* _createDefaultRuntimeManager(cons
     return Executor::RuntimeManager::createRuntimeManager(sche_config);
 }
 
-static Module* loadInternal(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs, const uint8_t* buffer, size_t length, const std::shared_ptr<MNN::Express::Executor::RuntimeManager> _rtMgr, const Module::Config* config);
+static Module* loadInternal(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs, const uint8_t* buffer, size_t length, const std::shared_ptr<MNN::Express::Executor::RuntimeManager> _rtMgr, const Module::Config* config, std::shared_ptr<BufferStorage> storage = nullptr);
 
 class EmptyModule : public Module {
 public:
@@ -279,11 +279,14 @@ public:
     virtual Module* clone(CloneContext* ctx) const override {
         auto mModule = mChildren[0];
         auto origin = mInfo->runTimeManager->getInside();
-        ScheduleConfig config;
-        config.type = origin->mRuntime.first.begin()->first;
-        config.numThread = origin->mContent->mNumberThread;
-        std::shared_ptr<Executor::RuntimeManager> newRt (Executor::RuntimeManager::createRuntimeManager(config));
-        const_cast<RuntimeAttr*>(newRt->getInside())->mContent = origin->mContent;
+        std::shared_ptr<Executor::RuntimeManager> newRt = ctx->pTargetRuntimeManager;
+        if (nullptr == newRt) {
+            ScheduleConfig config;
+            config.type = origin->mRuntime.first.begin()->first;
+            config.numThread = origin->mContent->mNumberThread;
+            newRt.reset(Executor::RuntimeManager::createRuntimeManager(config));
+            const_cast<RuntimeAttr*>(newRt->getInside())->mContent = origin->mContent;
+        }
         std::shared_ptr<Module::Info> newInfo(new Module::Info);
         *newInfo = *mInfo;
         ctx->pRuntimeManager = newRt;
@@ -354,7 +357,19 @@ static void _loadInputs(Module::Info* info, const std::vector<std::string>& inpu
 
 Module* Module::load(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs, const char* fileName, const std::shared_ptr<MNN::Express::Executor::RuntimeManager> _rtMgr, const Module::Config* config) {
     AutoStorage<uint8_t> buffer;
-    {
+    std::shared_ptr<BufferStorage> storage;
+    if (nullptr != _rtMgr && _rtMgr->getInside()->mContent->modes.runtimeHint.mapModelFile > 0) {
+        // Read the model in place, the mapping lives as long as the module
+        std::shared_ptr<FileLoader> loader(new FileLoader(fileName));
+        if (loader->map()) {
+            storage.reset(new BufferStorage);
+            storage->storage = loader->mapped();
+            storage->offset = 0;
+            storage->allocated_size = loader->size();
+            storage->owner = loader;
+        }
+    }
+    if (nullptr == storage) {
         FileLoader loader(fileName, true);
         if (!loader.valid()) {
             MNN_ERROR("Error for open %s\n", fileName);
@@ -379,7 +394,12 @@ Module* Module::load(const std::vector<std::string>& inputs, const std::vector<s
         rtMgr->setExternalFile(std::string(fileName) + ".weight");
         needReset = true;
     }
-    auto res = loadInternal(inputs, outputs, buffer.get(), buffer.size(), rtMgr, config);
+    Module* res = nullptr;
+    if (nullptr != storage) {
+        res = loadInternal(inputs, outputs, storage->buffer(), storage->size(), rtMgr, config, storage);
+    } else {
+        res = loadInternal(inputs, outputs, buffer.get(), buffer.size(), rtMgr, config);
+    }
     if (needReset) {
         rtMgr->setExternalFile("");
     }
@@ -394,7 +414,7 @@ Module* Module::load(const std::vector<std::string>& inputs, const std::vector<s
     return loadInternal(inputs, outputs, buffer, length, rtmgr, config);
 }
 
-static Module* loadInternal(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs, const uint8_t* buffer, size_t length, const std::shared_ptr<MNN::Express::Executor::RuntimeManager> _rtMgr, const Module::Config* config) {
+static Module* loadInternal(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs, const uint8_t* buffer, size_t length, const std::shared_ptr<MNN::Express::Executor::RuntimeManager> _rtMgr, const Module::Config* config, std::shared_ptr<BufferStorage> storage) {
     // Check if runtime is valid
     if (nullptr == _rtMgr || _rtMgr->getInside()->mRuntime.first.empty()) {
         MNN_ERROR("Invalid runtime\n");
@@ -448,7 +468,7 @@ static Module* loadInternal(const std::vector<std::string>& inputs, const std::v
     if ((!inputs.empty()) && (!outputs.empty())) {
         _loadInputs(info.get(), inputs, net);
         info->runTimeManager = rtMgr;
-        std::shared_ptr<Module> m(PipelineModule::load(inputs, outputs, buffer, length, rtMgr, config));
+        std::shared_ptr<Module> m(nullptr != storage ? PipelineModule::load(inputs, outputs, storage, rtMgr, config) : PipelineModule::load(inputs, outputs, buffer, length, rtMgr, config));
         if (nullptr == m) {
             return nullptr;
         }
@@ -493,7 +513,7 @@ static Module* loadInternal(const std::vector<std::string>& inputs, const std::v
             }
         }
     }
-    std::shared_ptr<Module> m(PipelineModule::load(info->inputNames, info->outputNames, buffer, length, rtMgr, config));
+    std::shared_ptr<Module> m(nullptr != storage ? PipelineModule::load(info->inputNames, info->outputNames, storage, rtMgr, config) : PipelineModule::load(info->inputNames, info->outputNames, buffer, length, rtMgr, config));
     _loadInputs(info.get(), info->inputNames, net);
     info->runTimeManager = rtMgr;
     if (nullptr == m) {
@@ -539,6 +559,12 @@ Module* Module::clone(const Module* module, const bool shareParams) {
     return module->clone(&context);
 }
 
+Module* Module::clone(const Module* module, const std::shared_ptr<MNN::Express::Executor::RuntimeManager> rtMgr, const bool shareParams) {
+    CloneContext context(shareParams);
+    context.pTargetRuntimeManager = rtMgr;
+    return module->clone(&context);
+}
+
 Module* Module::cloneBaseTo(CloneContext* ctx, Module* module) const {
     for (const Express::VARP& var : mParameters) {
         module->mParameters.push_back(ctx->getOrClone(var));
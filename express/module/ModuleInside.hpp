@@ -25,6 +25,8 @@ public:
     EXPRP getOrClone(const EXPRP expr);
     VARP getOrClone(const VARP var);
     std::shared_ptr<Executor::RuntimeManager> pRuntimeManager;
+    // Runtime for the clone given by user, nullptr means creating one like the origin
+    std::shared_ptr<Executor::RuntimeManager> pTargetRuntimeManager;
 private:
     bool mShareParams = false;
     std::unordered_map<const Expr*, EXPRP> mExprMap;
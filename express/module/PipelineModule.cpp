@@ -679,7 +679,36 @@ static Module* _createSubModule(std::shared_ptr<BufferStorage> bufferStorage, co
     return new StaticModule(info.inputs, info.outputs, std::move(buffers), std::move(scheduleInfo), sharedConst, std::move(modes), std::move(rt), config);
 }
 
+static Module* _loadDynamic(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs, const uint8_t* buffer, size_t length) {
+    auto varMap = MNN::Express::Variable::loadMap(buffer, length);
+    std::vector<MNN::Express::VARP> inputsVar(inputs.size());
+    for (int i=0; i<inputs.size(); ++i) {
+        inputsVar[i] = varMap[inputs[i]];
+    }
+    std::vector<MNN::Express::VARP> outputsVar(outputs.size());
+    for (int i=0; i<outputs.size(); ++i) {
+        outputsVar[i] = varMap[outputs[i]];
+    }
+    return Module::extract(inputsVar, outputsVar, false);
+}
+
 Module* PipelineModule::load(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs, const uint8_t* buffer, size_t length, const std::shared_ptr<MNN::Express::Executor::RuntimeManager> rtMgr, const Module::Config* config) {
+    auto net = GetNet(buffer);
+    if (nullptr != config && config->dynamic && nullptr != net->oplists() && nullptr != net->tensorName() && nullptr == net->subgraphs()) {
+        // Dynamic load copies the ops, the buffer isn't kept
+        return _loadDynamic(inputs, outputs, buffer, length);
+    }
+    std::shared_ptr<BufferStorage> bufferStorage(new BufferStorage);
+    bufferStorage->storage = new uint8_t[length];
+    ::memcpy(bufferStorage->storage, buffer, length);
+    bufferStorage->offset = 0;
+    bufferStorage->allocated_size = length;
+    return load(inputs, outputs, bufferStorage, rtMgr, config);
+}
+
+Module* PipelineModule::load(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs, std::shared_ptr<BufferStorage> bufferStorage, std::shared_ptr<MNN::Express::Executor::RuntimeManager> rtMgr, const Module::Config* config) {
+    auto buffer = bufferStorage->buffer();
+    auto length = bufferStorage->size();
     // Create Subgraph
     auto net = GetNet(buffer);
     if (nullptr == net->oplists() || nullptr == net->tensorName()) {
@@ -694,27 +723,13 @@ Module* PipelineModule::load(const std::vector<std::string>& inputs, const std::
     if (config->dynamic) {
         // TODO: Support subgraph
         if (nullptr == subGraphs) {
-            auto varMap = MNN::Express::Variable::loadMap(buffer, length);
-            std::vector<MNN::Express::VARP> inputsVar(inputs.size());
-            for (int i=0; i<inputs.size(); ++i) {
-                inputsVar[i] = varMap[inputs[i]];
-            }
-            std::vector<MNN::Express::VARP> outputsVar(outputs.size());
-            for (int i=0; i<outputs.size(); ++i) {
-                outputsVar[i] = varMap[outputs[i]];
-            }
-            return extract(inputsVar, outputsVar, false);
+            return _loadDynamic(inputs, outputs, buffer, length);
         } else {
             MNN_ERROR("Don't support subgraph for dynamic load, turn back to static load\n");
         }
     }
     std::map<std::string, SubGraph> subGraphMap;
     _createSubGraph(net, rtMgr, config, subGraphMap);
-    std::shared_ptr<BufferStorage> bufferStorage(new BufferStorage);
-    bufferStorage->storage = new uint8_t[length];
-    ::memcpy(bufferStorage->storage, buffer, length);
-    bufferStorage->offset = 0;
-    bufferStorage->allocated_size = length;
     return load(inputs, outputs, bufferStorage, rtMgr, config, subGraphMap);
 }
 
@@ -745,8 +760,14 @@ Module* PipelineModule::load(const std::vector<std::string>& inputs, const std::
     modRuntime.needGeometry = needGeometry;
     {
         modRuntime.modes = rtMgr->getInside()->mContent->modes;
+        auto& runtimeHint = modRuntime.modes.runtimeHint;
+        if (runtimeHint.modelUUID.empty() && runtimeHint.useCachedMmap > 0) {
+            // Models without uuid are keyed by their content, so that they never read the packed weights of each other.
+            // Only this load uses the key, the runtime manager is shared by other models
+            runtimeHint.modelUUID = OpCommonUtils::modelKey(net, buffer, length);
+        }
         modRuntime.rt = rtMgr;
-        rtMgr->getInside()->mRuntime.first.begin()->second->setRuntimeHint(rtMgr->getInside()->mContent->modes.runtimeHint);
+        rtMgr->getInside()->mRuntime.first.begin()->second->setRuntimeHint(runtimeHint);
         modRuntime.externalFile = rtMgr->getInside()->mContent->mExternalFile;
         modRuntime.userConfig = &rtMgr->getInside()->mContent->mConfig;
         modRuntime.compute.type = rtMgr->getInside()->mRuntime.first.begin()->first;
@@ -389,6 +389,77 @@ void StaticModule::onClearCache() {
             std::get<3>(iter.second) = true;
         }
     }
+    for (auto& plan : mPlans) {
+        for (auto& prev : plan.second.prevInputTensor) {
+            prev.first = nullptr;
+        }
+        for (auto& iter : plan.second.session->getPipelineInfo(0).first.inputTensorCopyCache) {
+            std::get<3>(iter.second) = true;
+        }
+    }
+}
+void StaticModule::_swapPlan(ShapePlan& plan) {
+    std::swap(mSession, plan.session);
+    std::swap(mInputTensors, plan.inputTensors);
+    std::swap(mPrevInputTensor, plan.prevInputTensor);
+    std::swap(mOutputTensors, plan.outputTensors);
+}
+void StaticModule::_selectPlan(const std::vector<Express::VARP>& inputs) {
+    auto rtmInside = mRuntimeManager->getInside();
+    int capacity = rtmInside->mContent->modes.runtimeHint.staticModulePlanCache;
+    if (capacity <= 1 || mShapeInferSeperate || mResource->mUseContentInputs || mResource->mModes.inputMode != Interpreter::Session_Input_User) {
+        return;
+    }
+    std::vector<int> key;
+    for (auto& input : inputs) {
+        auto info = input->getInfo();
+        if (nullptr == info) {
+            return;
+        }
+        key.emplace_back(info->order);
+        key.emplace_back(info->type.code);
+        key.emplace_back(info->type.bits);
+        key.emplace_back((int)info->dim.size());
+        key.insert(key.end(), info->dim.begin(), info->dim.end());
+    }
+    if (key == mPlanKey) {
+        rtmInside->mPlanCacheHit++;
+        return;
+    }
+    if (!mPlanKey.empty()) {
+        // Park the current plan
+        auto& parked = mPlans[mPlanKey];
+        _swapPlan(parked);
+        parked.lastUse = mPlanUse++;
+    }
+    mPlanKey = key;
+    auto iter = mPlans.find(key);
+    if (iter != mPlans.end()) {
+        rtmInside->mPlanCacheHit++;
+        _swapPlan(iter->second);
+        mPlans.erase(iter);
+        return;
+    }
+    rtmInside->mPlanCacheMiss++;
+    if (mPlans.empty()) {
+        // First shape, the current plan is free
+        return;
+    }
+    if (mPlans.size() + 1 > capacity) {
+        // Reuse the least recently used plan, it is resized for the new shape
+        auto lru = mPlans.begin();
+        for (auto it = mPlans.begin(); it != mPlans.end(); ++it) {
+            if (it->second.lastUse < lru->second.lastUse) {
+                lru = it;
+            }
+        }
+        _swapPlan(lru->second);
+        mPlans.erase(lru);
+        return;
+    }
+    auto rt = rtmInside->mRuntime;
+    mSession.reset(mPlans.begin()->second.session->clone(std::move(rt), mResource->mSharedConst));
+    resetInputOutputs();
 }
 ErrorCode StaticModule::_resize(const std::vector<Express::VARP>& inputs) {
     ErrorCode code = NO_ERROR;
@@ -576,6 +647,7 @@ std::vector<Express::VARP> StaticModule::onForward(const std::vector<Express::VA
 
     ErrorCode code = NO_ERROR;
     if (runResize) {
+        _selectPlan(inputs);
         code = _resize(inputs);
     }
     if (NO_ERROR == code && runCompute) {
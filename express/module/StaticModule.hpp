@@ -31,6 +31,7 @@ public:
 private:
     ErrorCode _resize(const std::vector<Express::VARP>& inputs);
     ErrorCode _execute();
+    void _selectPlan(const std::vector<Express::VARP>& inputs);
 
     StaticModule() = default;
     void resetInputOutputs();
@@ -60,6 +61,20 @@ private:
     bool mShapeInferSeperate = false;
     std::vector<MNN::Express::VARP> mOutputVars;
     std::shared_ptr<MNN::Express::Executor::RuntimeManager> mRuntimeManager;
+
+    // Resized plans parked for other input shapes, see Interpreter::STATIC_MODULE_PLAN_CACHE
+    struct ShapePlan {
+        std::shared_ptr<Session> session;
+        std::vector<Tensor*> inputTensors;
+        std::vector<std::pair<Tensor*, MNNForwardType>> prevInputTensor;
+        std::vector<Tensor*> outputTensors;
+        size_t lastUse = 0;
+    };
+    void _swapPlan(ShapePlan& plan);
+    std::map<std::vector<int>, ShapePlan> mPlans;
+    // Input shape key of the current plan
+    std::vector<int> mPlanKey;
+    size_t mPlanUse = 0;
 };
 }
 }
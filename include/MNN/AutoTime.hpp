@@ -51,6 +51,30 @@ private:
     int mLine;
     char* mName;
 };
+
+/**
+ Built-in tracer: records the commands run by sessions / modules (name, type, flops, bytes of inputs and outputs),
+ allocations and thread pool regions into a ring of the latest events, and exports them as Chrome trace JSON,
+ which chrome://tracing and Perfetto open. Recording takes no lock, so it can stay on with sampling.
+ */
+class MNN_PUBLIC Tracer {
+public:
+    /**
+     @brief start recording, or change the sampling if started
+     @param capacity number of latest events kept, rounded up to a power of 2
+     @param sampleInterval record one execution of every sampleInterval
+     */
+    static void start(int capacity = 65536, int sampleInterval = 1);
+    /** stop recording, the events are kept for dump until the next start. */
+    static void stop();
+    static bool isStarted();
+    /**
+     @brief write the events kept as Chrome trace JSON
+     @param path file to write
+     @return false if the file can't be written
+     */
+    static bool dump(const char* path);
+};
 } // namespace MNN
 
 #ifdef MNN_OPEN_TIME_TRACE
@@ -111,6 +111,14 @@ public:
      * @return created net if success, NULL otherwise.
      */
     static Interpreter* createFromFile(const char* file);
+    /**
+     * @brief create net from file.
+     * @param file  given file.
+     * @param mapFile   map the file instead of reading it, the model is read in place and shares page cache with
+     * other processes. releaseModel unmaps it.
+     * @return created net if success, NULL otherwise.
+     */
+    static Interpreter* createFromFile(const char* file, bool mapFile);
     /**
      * @brief create net from buffer.
      * @param buffer    given data buffer.
@@ -209,6 +217,8 @@ public:
         MAX_TUNING_NUMBER = 0,
         // Strictly check model file or not, default 1. if set 0, will not check model file valid/invalid
         STRICT_CHECK_MODEL = 1,
+        // Memory allocator type, default 0. 0: defer, 1: eager, 2: defer and put CPU weights, feature maps and
+        // kvcache in transparent huge pages, falling back to normal pages
         MEM_ALLOCATOR_TYPE = 2,
         // Winograd unit candidates count, default 3. if set 0, will use less unit candidates for less memory at the expense of performance.
         WINOGRAD_MEMORY_LEVEL = 3,
@@ -264,7 +274,45 @@ public:
         CPU_SME2_NEON_DIVISION_RATIO = 17,
 
         // Set SME cores, default is 2, if supports sme
-        CPU_SME_CORES = 18
+        CPU_SME_CORES = 18,
+
+        // Store kvcache in fixed-size blocks taken from a pool shared by the runtime, default is 0
+        // Growing the kvcache only appends blocks instead of copying the whole cache
+        KVCACHE_PAGED = 19,
+
+        // Priority of the session in the CPU thread pool shared with other sessions, default is 0
+        // Idle threads join the parallel regions of higher priority first
+        CPU_TASK_PRIORITY = 20,
+
+        // Max threads (including the calling thread) running one parallel region of the session, default is 0 (no limit)
+        CPU_CORE_BUDGET = 21,
+
+        // Map the model file instead of reading it when Module::load from file, default is 0
+        // Cold start is bounded by page faults and processes loading the same model share page cache
+        MAP_MODEL_FILE = 22,
+
+        // Weights mapped by EXTERNAL_WEIGHT_DIR are streamed during execution: the next N ops are prefetched
+        // in background and the weights of finished ops are released, default is 0 (all weights resident)
+        WEIGHT_PREFETCH_WINDOW = 23,
+
+        // Max resized plans a static module keeps, keyed by the input shapes, default is 0 (only the current plan)
+        // Switching back to a cached shape skips shape inference, geometry compute and memory planning,
+        // each plan holds its own memory
+        STATIC_MODULE_PLAN_CACHE = 24,
+
+        // Run independent ops of a session concurrently on the CPU thread pool, the threads are split between
+        // the ops running together, default is 0 (ops run one by one). Ops are put in dependency levels when
+        // resizing and ops of one level don't share memory, so the session may use more memory
+        CPU_INTER_OP_PARALLEL = 25,
+
+        // NUMA node the CPU runtime works on, default is -1 (no binding). The threads are bound to the cpus of
+        // the node unless CPU_CORE_IDS is set, and the weights and feature maps are allocated on the node.
+        // Set it before creating the first session / module of the runtime
+        CPU_NUMA_NODE = 26,
+
+        // 1: Module::clone onto a runtime of another NUMA node copies the weights of the ops to that node instead
+        // of sharing them, default is 0
+        CPU_NUMA_REPLICATE_WEIGHT = 27
     };
 
     enum ExternalPathType {
@@ -463,6 +511,22 @@ public:
         /** Mode / NumberThread, int* */
         THREAD_NUMBER = 4,
 
+        /** CPU thread pool queueing, float*, length 3: parallel regions, mean and max delay in ms before
+         another thread joins a region (the whole region if none joins) */
+        THREAD_POOL_QUEUE_DELAY = 5,
+
+        /** Plan cache of static modules, see STATIC_MODULE_PLAN_CACHE, int*, length 2: hit and miss counts,
+         only supported by RuntimeManager::getInfo */
+        MODULE_PLAN_CACHE = 6,
+
+        /** CPU memory allocated with MEM_ALLOCATOR_TYPE 2, int*, length 2: 2MB pages advised as huge pages and
+         pages the system actually backed with huge pages */
+        HUGE_PAGES = 7,
+
+        /** Weight streaming of WEIGHT_PREFETCH_WINDOW, int*, length 2: ops whose weights are streamed and
+         madvise calls issued to prefetch or release them */
+        WEIGHT_PREFETCH = 8,
+
         ALL
     };
 
@@ -78,6 +78,8 @@ public:
     static Module* extract(std::vector<Express::VARP> inputs, std::vector<Express::VARP> outputs, bool fortrain, const std::map<std::string, SubGraph>& subGraph = {});
 
     static Module* clone(const Module* module, const bool shareParams = false);
+    // Clone to run on rtMgr instead of a new runtime of the same config, e.g. a runtime bound to another NUMA node
+    static Module* clone(const Module* module, const std::shared_ptr<MNN::Express::Executor::RuntimeManager> rtMgr, const bool shareParams = false);
 
     struct Info {
         // Input info load from model
@@ -42,7 +42,7 @@ static void _maskQK(float * qkPacked, const float* scale, size_t seqLen, size_t
 
     // mask: [seq, kvseq]
     // data: [UP_DIV(kvseq, pack), seq, pack]
-    if (sinksPtr != nullptr) {
+    if (sinksPtr != nullptr && maskPtr != nullptr) {
         auto mask = (T*)maskPtr;
         for (int i = 0; i < UP_DIV(subKvSeqLen, pack); ++i) {
             for (int j = 0; j < seqLen; ++j) {
@@ -58,6 +58,45 @@ static void _maskQK(float * qkPacked, const float* scale, size_t seqLen, size_t
 
 }
 
+// Implicit masks, computed from the token positions instead of a [seq, kvseq] mask tensor.
+// data: [UP_DIV(subKvSeqLen, pack), seqLen, pack], row j is the token at kvValidOffset + j
+// Only the masked range of each row is written. Causal masking of MaskSliding and MaskSegments is left to MNNSoftmax.
+template <typename T>
+static void _maskQKImplicit(float* qkPacked, size_t seqLen, int subKvSeqLen, int pack, int kvoffset, int kvValidOffset, const KVMeta* meta, int maskMode) {
+    auto source = (T*)qkPacked;
+    const T maskValue = (T)(sizeof(T) == 2 ? -65504.0f : std::numeric_limits<float>::lowest());
+    const int kvEnd = kvoffset + subKvSeqLen;
+    if (maskMode == KVMeta::MaskSegments) {
+        // Only the new kv before the row can be visible, the later ones are masked by MNNSoftmax
+        auto segments = meta->segments.data();
+        for (int j = 0; j < seqLen; ++j) {
+            int end = ALIMIN(kvEnd, kvValidOffset + j);
+            for (int t = ALIMAX(kvoffset, kvValidOffset); t < end; ++t) {
+                if (segments[t - kvValidOffset] != segments[j]) {
+                    int k = t - kvoffset;
+                    source[(k / pack) * seqLen * pack + j * pack + (k % pack)] = maskValue;
+                }
+            }
+        }
+        return;
+    }
+    for (int j = 0; j < seqLen; ++j) {
+        int pos = kvValidOffset + j;
+        int begin, end;
+        if (maskMode == KVMeta::MaskSliding) {
+            begin = ALIMAX(kvoffset, meta->sink_tokens);
+            end = ALIMIN(kvEnd, pos - meta->sliding_window + 1);
+        } else {
+            begin = ALIMAX(kvoffset, ALIMAX(pos, meta->prefix_len - 1) + 1);
+            end = kvEnd;
+        }
+        for (int t = begin; t < end; ++t) {
+            int k = t - kvoffset;
+            source[(k / pack) * seqLen * pack + j * pack + (k % pack)] = maskValue;
+        }
+    }
+}
+
 ErrorCode CPUAttention::onResize(const std::vector<Tensor*>& inputs, const std::vector<Tensor*>& outputs) {
     auto gcore = static_cast<CPUBackend *>(backend())->functions();
     auto core = static_cast<CPUBackend*>(backend())->int8Functions();
@@ -250,6 +289,23 @@ ErrorCode CPUAttention::onExecute(const std::vector<Tensor*>& inputs, const std:
     }
     int insertLen = seqLen;
 
+    // A single element mask input means the mask is implicit and described by mMeta. For attention
+    // mixing full and sliding layers, the element selects the window for the layer: 0 means full.
+    int maskMode = KVMeta::MaskInput;
+    if (mMeta != nullptr && mMeta->mask_mode != KVMeta::MaskInput && (inputs.size() < 4 || inputs[3]->elementSize() <= 1)) {
+        maskMode = mMeta->mask_mode;
+        if (maskMode == KVMeta::MaskSliding && mask != nullptr) {
+            float selector = (mBytes == 2) ? (float)(((FLOAT16_T*)mask)[0]) : ((float*)mask)[0];
+            if (selector == 0.0f) {
+                maskMode = KVMeta::MaskCausal;
+            }
+        }
+        if (maskMode == KVMeta::MaskSliding && mMeta->sliding_window <= 0) {
+            maskMode = KVMeta::MaskCausal;
+        }
+        mask = nullptr;
+    }
+
     if (mKVCache && mMeta != nullptr) {
         if (mMeta->previous == mMeta->remove) {
             mKVCacheManager->onClear();
@@ -281,6 +337,36 @@ ErrorCode CPUAttention::onExecute(const std::vector<Tensor*>& inputs, const std:
     int32_t units[2] = {eP, lP};
     const float* sinksPtr = sinks ? sinks->host<float>() : nullptr;
     int kvValidOffset = kvSeqLen - seqLen; // reuse_kv=true or decode, kvValidOffset>0
+    if (maskMode == KVMeta::MaskSegments && mMeta->segments.size() != seqLen) {
+        MNN_ERROR("Attention segments don't match the added tokens, fall back to the causal mask\n");
+        maskMode = KVMeta::MaskCausal;
+    }
+    bool useMask = (maskMode == KVMeta::MaskInput) ? (sinksPtr == nullptr) : (maskMode != KVMeta::MaskPrefixLM);
+
+    // Visible kv blocks, and for each block the rows [rowStart, rowEnd) that see at least one of its keys.
+    // Blocks no row can see are skipped; QK is not computed for the other rows when they are masked
+    // without reading it, which roughly halves the causal prefill work.
+    std::vector<int> blockIndex, blockRowStart, blockRowEnd, blockQKRowStart;
+    for (int i = 0; i < UP_DIV(kvSeqLen, mBlockKV); ++i) {
+        int kvStart = i * mBlockKV;
+        int kvEnd = ALIMIN(kvStart + mBlockKV, kvSeqLen);
+        int rowStart = (kvStart < kvValidOffset) ? 0 : (kvStart - kvValidOffset);
+        int rowEnd = seqLen;
+        if (maskMode == KVMeta::MaskSliding && kvStart >= mMeta->sink_tokens) {
+            // the last row sees (pos - sliding_window, pos]
+            rowEnd = ALIMIN(seqLen, kvEnd - 1 + mMeta->sliding_window - kvValidOffset);
+            if (rowEnd <= rowStart) {
+                continue;
+            }
+        }
+        if (maskMode == KVMeta::MaskPrefixLM && kvStart < mMeta->prefix_len) {
+            rowStart = 0;
+        }
+        blockIndex.emplace_back(i);
+        blockRowStart.emplace_back(rowStart);
+        blockRowEnd.emplace_back(rowEnd);
+        blockQKRowStart.emplace_back((useMask || maskMode != KVMeta::MaskInput) ? rowStart : 0);
+    }
 
     // Temporary tensors for intermediate results
     std::shared_ptr<Tensor> unpackQK(Tensor::createDevice<int32_t>({mThreadNum, seqLen, mBlockKV}));
@@ -428,6 +514,7 @@ ErrorCode CPUAttention::onExecute(const std::vector<Tensor*>& inputs, const std:
         auto outputPacked = mTempOut ? mTempOut->host<int8_t>() + tId * mTempOut->stride(0) : qkvPacked;
 
         int  kvBlocks = UP_DIV(kvSeqLen, mBlockKV);
+        int  visibleBlocks = (int)blockIndex.size();
 
         QuanPostTreatParameters gemmParam4QxK, gemmParam4QKxV; // used by int8 gemm, allocated per thread.
         SumByAxisParams sumParams4QxK, sumParams4QKxV;
@@ -511,8 +598,11 @@ ErrorCode CPUAttention::onExecute(const std::vector<Tensor*>& inputs, const std:
             if (runningSum && runningMax) {
                 if (sinksPtr == nullptr) {
                     memset(runningSum, 0, mRunningSum->stride(0));
+                    // With a sliding window or segments a row may see nothing in its first blocks, start from a
+                    // finite max so those masked scores give exp(mask - max) = 0 instead of exp(0)
+                    float initMax = (maskMode == KVMeta::MaskSliding || maskMode == KVMeta::MaskSegments) ? -60000.0f : std::numeric_limits<float>::lowest();
                     for (int k = 0; k < seqLen; ++k) {
-                        runningMax[k] = std::numeric_limits<float>::lowest();
+                        runningMax[k] = initMax;
                     }
                 } else {
                     for (int k = 0; k < seqLen; ++k) {
@@ -550,19 +640,27 @@ ErrorCode CPUAttention::onExecute(const std::vector<Tensor*>& inputs, const std:
             }
 
             // Start computing
-            for (int i = 0; i < kvBlocks; ++i) {
+            for (int bi = 0; bi < visibleBlocks; ++bi) {
+                int i = blockIndex[bi];
                 int subKvSeqLen = ALIMIN(mBlockKV, kvSeqLen - i * mBlockKV);
                 // 1. query @ key
                 if (mQuantKey == false) {
                     auto keyPtr = keyAddr + i * UP_DIV(mBlockKV, hP) * ROUND_UP(mHeadDim, lP) * hP * mBytes;
+                    if (mKVCacheManager->paged()) {
+                        keyPtr = mKVCacheManager->addrOfKeyBlock(kvHeadIndex, i);
+                    }
                     int loop_e = seqLen / eP;
                     int remain = seqLen % eP;
+                    int eBegin = blockQKRowStart[bi] / eP;
+                    int eEnd = UP_DIV(blockRowEnd[bi], eP);
                     auto qStride0 = ROUND_UP(mHeadDim, lP) * eP * mBytes;
                     size_t shapeParameters[7] = {(size_t)eP * lP *  mBytes, ROUND_UP((size_t)mHeadDim, lP), (size_t)subKvSeqLen, (size_t)seqLen * mPack * mBytes, 0, 0, 0};
-                    for (int ei = 0 ; ei < loop_e; ei++) {
+                    for (int ei = eBegin; ei < ALIMIN(eEnd, loop_e); ei++) {
                         gcore->MNNPackedMatMul((float*)(qkPacked + (ei * eP * mPack) * mBytes), (float*)(qReordered + ei * qStride0), (float*)keyPtr, shapeParameters, nullptr, nullptr, nullptr, nullptr);
                     }
-                    gcore->MNNPackedMatMulRemain((float*)(qkPacked + (loop_e * eP * mPack) * mBytes), (float*)(qReordered + loop_e * qStride0), (float*)keyPtr, remain, shapeParameters, nullptr, nullptr, nullptr, nullptr);
+                    if (eEnd > loop_e) {
+                        gcore->MNNPackedMatMulRemain((float*)(qkPacked + (loop_e * eP * mPack) * mBytes), (float*)(qReordered + loop_e * qStride0), (float*)keyPtr, remain, shapeParameters, nullptr, nullptr, nullptr, nullptr);
+                    }
                 } else {
                     auto eRemain = seqLen;
                     auto srcInt8 = qReordered;
@@ -599,15 +697,24 @@ ErrorCode CPUAttention::onExecute(const std::vector<Tensor*>& inputs, const std:
                             _maskQK<float>((float*)qkPacked, &mScale, seqLen, subKvSeqLen, mPack, kvSeqLen, i * mBlockKV, sinksPtr, mask, mQuantKey);
                         }
                     }
-                    bool useMask = (sinksPtr == nullptr);
+                    if (maskMode == KVMeta::MaskSliding || maskMode == KVMeta::MaskPrefixLM || maskMode == KVMeta::MaskSegments) {
+                        if (mBytes == 2) {
+                            _maskQKImplicit<FLOAT16_T>((float*)qkPacked, seqLen, subKvSeqLen, mPack, i * mBlockKV, kvValidOffset, mMeta, maskMode);
+                        } else {
+                            _maskQKImplicit<float>((float*)qkPacked, seqLen, subKvSeqLen, mPack, i * mBlockKV, kvValidOffset, mMeta, maskMode);
+                        }
+                    }
                     gcore->MNNSoftmax(qkSoftmax, (float*)qkPacked, runningMax, runningSum, diffScale, seqLen, subKvSeqLen, i * mBlockKV, kvValidOffset, mPack, useMask);
                 }
                 // 3. qk @ v
                 auto qkStride0 = ROUND_UP(subKvSeqLen, lP) * eP * mBytes;
-                auto rowStart = (i * mBlockKV < kvValidOffset)? 0 : (i * mBlockKV - kvValidOffset);
+                auto rowStart = blockRowStart[bi];
 
                 if (mQuantValue == false) {
                     auto valuePtr = valueAddr + i * vstride0 * mBytes;
+                    if (mKVCacheManager->paged()) {
+                        valuePtr = mKVCacheManager->addrOfValueBlock(kvHeadIndex, i);
+                    }
                     size_t shapeParameters[7] = {(size_t)eP * lP * mBytes, ROUND_UP((size_t)subKvSeqLen, lP), (size_t)mHeadDim, (size_t)seqLen * mPack * mBytes, 0, 0, 0};
                     size_t bExtraStride = (i < kvBlocks - 1) ? 0 : (ROUND_UP(mKVCacheManager->getFlashAttentionBlockKv(), lP) - ROUND_UP(subKvSeqLen, lP)) * hP * mBytes;
                     shapeParameters[5] = bExtraStride;
@@ -670,7 +777,7 @@ ErrorCode CPUAttention::onExecute(const std::vector<Tensor*>& inputs, const std:
 
                 // 4. flash attention, update each sub kvSeq's final results
                 if (runningMax != nullptr && runningSum != nullptr && diffScale != nullptr) {
-                    gcore->MNNFlashAttentionUpdateBlockOutput((float*)outputPacked, (float*)qkvPacked, diffScale, runningSum, UP_DIV(mHeadDim, mPack), seqLen, mPack, i, kvBlocks, mPackQKV->stride(0) / mBytes, mBytes, rowStart);
+                    gcore->MNNFlashAttentionUpdateBlockOutput((float*)outputPacked, (float*)qkvPacked, diffScale, runningSum, UP_DIV(mHeadDim, mPack), seqLen, mPack, bi, visibleBlocks, mPackQKV->stride(0) / mBytes, mBytes, rowStart);
                 }
             }
 
@@ -729,6 +836,7 @@ CPUAttention::CPUAttention(Backend *backend, bool kv_cache) : Execution(backend)
     kvconfig.mPrefixCacheDir = static_cast<CPUBackend *>(backend)->getRuntime()->hint().prefixcacheDirPath;
     kvconfig.mExpandChunk = 64;
     kvconfig.mBlockNum = 1;
+    kvconfig.mPaged = static_cast<CPUBackend *>(backend)->getRuntime()->hint().kvcachePaged > 0;
     mKVCacheManager.reset(new CPUKVCacheManager(backend, kvconfig));
 }
 
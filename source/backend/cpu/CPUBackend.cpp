@@ -7,10 +7,13 @@
 //
 
 #include "backend/cpu/CPUBackend.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <mutex>
 #include <unordered_map>
 #include "CPUResizeCache.hpp"
+#include "CPUKVBlockPool.hpp"
 #include "core/BufferAllocator.hpp"
 #include "CPUTensorConvert.hpp"
 #include "compute/CommonOptFunction.h"
@@ -107,7 +110,7 @@ void CPURuntime::_bindCPUCore() const {
         ThreadPool::TASK task = std::make_pair([&](int i) {
             MNNSetSchedAffinity(lockCPUIndexes[i].first, lockCPUIndexes[i].second);
         }, mThreadNumber);
-        mThreadPool->enqueue(&task, mTaskIndex);
+        mThreadPool->enqueue(&task, mTaskIndex, true);
         mThreadPool->deactive();
     }
 #endif
@@ -203,6 +206,60 @@ void CPURuntime::_validateCpuIds() const{
         }
     }
 }
+void CPURuntime::_resetRootAllocator() const {
+    int node = -1;
+    if (hint().numaNode >= 0) {
+        auto& nodes = MNNGetNumaNodes();
+        auto target = std::find_if(nodes.begin(), nodes.end(), [this](const MNNNumaNode& n) {
+            return n.id == hint().numaNode;
+        });
+        if (target == nodes.end()) {
+            if (mNumaNode != hint().numaNode) {
+                MNN_ERROR("NUMA node %d is not found, don't bind to it\n", hint().numaNode);
+            }
+        } else {
+            node = target->id;
+            if (hint().cpuIds.empty() && !target->cpus.empty()) {
+                // Threads run on the node owning their memory
+                mCpuIds = target->cpus;
+            }
+        }
+    }
+    bool hugePage = hint().memoryAllocatorType == Runtime::Allocator_HugePage;
+    if (mNumaNode == node && mHugePage == hugePage) {
+        return;
+    }
+    // Memory already allocated can't move, only change the root before the first session
+    bool allocated = mStaticAllocator->totalSize() > 0 || nullptr != mStaticAllocatorMMap.get();
+    for (auto& buf : mDynamic) {
+        allocated = allocated || nullptr != buf.current.first;
+    }
+    if (allocated) {
+        MNN_ERROR("The memory of cpu runtime is allocated, can't bind it to NUMA node %d or huge pages\n", node);
+        return;
+    }
+    mNumaNode = node;
+    mHugePage = hugePage;
+    if (hugePage) {
+        mRootAllocator = BufferAllocator::Allocator::createHugePage(node);
+    } else if (node >= 0) {
+        mRootAllocator = BufferAllocator::Allocator::createNuma(node);
+    } else {
+        mRootAllocator = nullptr;
+    }
+    auto root = nullptr != mRootAllocator.get() ? mRootAllocator : BufferAllocator::Allocator::createDefault();
+    // Small weights share mapped arenas instead of taking one mmap / page each
+    size_t minChunk = 0;
+    if (hugePage) {
+        minChunk = 2 * 1024 * 1024;
+    } else if (node >= 0) {
+        minChunk = 256 * 1024;
+    }
+    mStaticAllocator.reset(new EagerBufferAllocator(root, MNN_MEMORY_ALIGN_DEFAULT, minChunk));
+    for (auto& buf : mDynamic) {
+        buf.root = root;
+    }
+}
 void CPURuntime::onReset(int numberThread, const BackendConfig* config, bool full) {
     if (config != nullptr) {
         mPower = config->power;
@@ -215,6 +272,7 @@ void CPURuntime::onReset(int numberThread, const BackendConfig* config, bool ful
     mThreadNumber = numberThread;
     mCpuIds = hint().cpuIds;
     _validateCpuIds();
+    _resetRootAllocator();
     mCpuMask = MNNGetCPUMask(mCpuIds);
     _resetThreadPool();
 }
@@ -251,7 +309,24 @@ float CPURuntime::onGetMemoryInMB() {
     for (auto& buf : mDynamic) {
         dynamicMemoryInMB += buf.currentSize / 1024.0f / 1024.0f;
     }
-    return staticMemoryInMB + dynamicMemoryInMB;
+    float kvMemoryInMB = 0.0f;
+    {
+        std::lock_guard<std::mutex> _l(mKVBlockPoolLock);
+        for (auto& iter : mKVBlockPools) {
+            kvMemoryInMB += iter.second->totalBlocks() * iter.second->blockBytes() / 1024.0f / 1024.0f;
+        }
+    }
+    return staticMemoryInMB + dynamicMemoryInMB + kvMemoryInMB;
+}
+std::shared_ptr<CPUKVBlockPool> CPURuntime::getKVBlockPool(size_t blockBytes) const {
+    std::lock_guard<std::mutex> _l(mKVBlockPoolLock);
+    auto iter = mKVBlockPools.find(blockBytes);
+    if (iter != mKVBlockPools.end()) {
+        return iter->second;
+    }
+    std::shared_ptr<CPUKVBlockPool> pool(new CPUKVBlockPool(blockBytes, 16, mRootAllocator));
+    mKVBlockPools.insert(std::make_pair(blockBytes, pool));
+    return pool;
 }
 bool CPURuntime::onCheckInfo(Backend::Info& info) const {
     info.numThread = mThreadNumber;
@@ -264,10 +339,29 @@ SingleBufferWithAllocator* CPURuntime::buffer(int index) const {
     return mDynamicMmap.data() + index;
 }
 
+// Packed weight layouts depend on the MNN version and the kernels selected for this cpu
+static std::string _packedWeightKey(const std::string& uuid) {
+    auto core = MNNGetCoreFunctions();
+    auto info = MNNGetCPUInfo();
+    int eP, lP, hP;
+    core->MNNGetMatMulPackMode(&eP, &lP, &hP);
+    int unit, srcUnit, dstUnit;
+    MNNGetInt8CoreFunctions()->MNNGetGemmUnit(&unit, &srcUnit, &dstUnit);
+    char isa[128];
+    snprintf(isa, sizeof(isa), "%s_p%de%dl%dh%d_i%d.%d.%d_f%d%d%d%d%d%d_", MNN_VERSION, core->pack, eP, lP, hP, unit, srcUnit, dstUnit,
+             (int)core->supportFp16arith, (int)core->supportSDot, (int)core->supportI8mm, (int)info->sve2, (int)info->sme2, (int)core->matmulBytes);
+    std::string key = isa;
+    if (!uuid.empty()) {
+        key += uuid + "_";
+    }
+    return key;
+}
+
 Backend* CPURuntime::onCreate(const BackendConfig* config, Backend* origin) const {
     {
         mCpuIds = hint().cpuIds;
         _validateCpuIds();
+        _resetRootAllocator();
         mCpuMask = MNNGetCPUMask(mCpuIds);
         _resetThreadPool();
     }
@@ -287,14 +381,21 @@ Backend* CPURuntime::onCreate(const BackendConfig* config, Backend* origin) cons
         prefix[2] += mPrecision;
         prefix[4] += mMemory;
         prefix[6] += mPower;
-        // prefix += hint().modelUUID + "_";
         bool autoRemove = true;
         if (hint().useCachedMmap) {
+            // The cache is kept after exit, only reuse it for the same model and weight layout
+            prefix += _packedWeightKey(hint().modelUUID);
             autoRemove = false;
             std::string fileName = MNNFilePathConcat(hint().weightMemoryPath, prefix + "sync.static");
-            const_cast<RuntimeHint&>(hint()).useCachedMmap += MNNFileExist(fileName.c_str());
+            // The static mmap is opened once, by the first model. The weights of the models loaded later are packed
+            // in memory, they must not skip packing even if a cache of their own exists
+            bool ownMmap = nullptr == mStaticAllocatorMMap.get() || (mStaticAllocator == mStaticAllocatorMMap && mStaticMmapPrefix == prefix);
+            if (ownMmap) {
+                const_cast<RuntimeHint&>(hint()).useCachedMmap += MNNFileExist(fileName.c_str());
+            }
         }
         if (nullptr == mStaticAllocatorMMap.get()) {
+            mStaticMmapPrefix = prefix;
             // Only support set weightmap dir once
             mStaticAllocatorRaw = mStaticAllocator;
             auto mmapMem = BufferAllocator::Allocator::createMmap(hint().weightMemoryPath.c_str(), prefix.c_str(), "static", autoRemove);
@@ -374,7 +475,15 @@ int CPURuntime::onGetRuntimeStatus(RuntimeStatus statusEnum) const {
 }
 
 void CPURuntime::onGabageCollect(int level) {
+    // Pending advices may point to the mmap chunks released below
+    _drainPrefetch();
     mStaticAllocator->release(false);
+    {
+        std::lock_guard<std::mutex> _l(mKVBlockPoolLock);
+        for (auto& iter : mKVBlockPools) {
+            iter.second->shrink();
+        }
+    }
     if (nullptr != mStaticAllocatorMMap) {
         mStaticAllocatorMMap->release(false);
     }
@@ -386,10 +495,106 @@ void CPURuntime::onGabageCollect(int level) {
 }
 
 
+bool CPURuntime::onGetQueueDelay(float* dst) const {
+#ifdef MNN_USE_THREAD_POOL
+    if (nullptr == mThreadPool) {
+        return false;
+    }
+    dst[0] = (float)mQueueStats.regions;
+    dst[1] = mQueueStats.regions > 0 ? (float)mQueueStats.queueDelayUs / (float)mQueueStats.regions / 1000.0f : 0.0f;
+    dst[2] = (float)mQueueStats.maxQueueDelayUs / 1000.0f;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CPURuntime::onGetWeightPrefetch(int* dst) const {
+    if (hint().weightPrefetchWindow <= 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> _l(mWeightRegionLock);
+    dst[0] = (int)mWeightRegions.size();
+    dst[1] = mPrefetchAdvices;
+    return true;
+}
+
+void CPURuntime::_recordWeights(const std::string& name, std::vector<std::pair<void*, size_t>>&& weights) const {
+    std::lock_guard<std::mutex> _l(mWeightRegionLock);
+    for (auto& region : weights) {
+        mWeightOwners[region.first] = name;
+    }
+    auto& regions = mWeightRegions[name];
+    regions.insert(regions.end(), weights.begin(), weights.end());
+}
+
+void CPURuntime::_adviseWeights(const std::string& name, bool release) const {
+    std::lock_guard<std::mutex> _l(mWeightRegionLock);
+    auto iter = mWeightRegions.find(name);
+    if (iter == mWeightRegions.end()) {
+        return;
+    }
+    // One worker for the runtime's lifetime, instead of one thread per execution
+    if (nullptr == mPrefetchQueue.get()) {
+        mPrefetchQueue.reset(new WorkerThread);
+    }
+    auto regions = iter->second;
+    mPrefetchQueue->postTask([regions, release]() {
+        for (auto& region : regions) {
+            MNNMmapAdvise(region.first, region.second, release);
+        }
+        return 0;
+    });
+    mPrefetchAdvices++;
+}
+
+void CPURuntime::_releaseWeight(void* ptr) const {
+    {
+        std::lock_guard<std::mutex> _l(mWeightRegionLock);
+        auto owner = mWeightOwners.find(ptr);
+        if (owner == mWeightOwners.end()) {
+            return;
+        }
+        auto iter = mWeightRegions.find(owner->second);
+        if (iter != mWeightRegions.end()) {
+            auto& regions = iter->second;
+            regions.erase(std::remove_if(regions.begin(), regions.end(), [ptr](const std::pair<void*, size_t>& region) {
+                return region.first == ptr;
+            }), regions.end());
+            if (regions.empty()) {
+                mWeightRegions.erase(iter);
+            }
+        }
+        mWeightOwners.erase(owner);
+    }
+    _drainPrefetch();
+}
+
+void CPURuntime::_drainPrefetch() const {
+    std::shared_ptr<WorkerThread> queue;
+    {
+        std::lock_guard<std::mutex> _l(mWeightRegionLock);
+        queue = std::move(mPrefetchQueue);
+    }
+    // Completes the remaining advices and joins the worker
+    queue.reset();
+}
+
+bool CPURuntime::onGetHugePages(int* dst) const {
+    size_t pages[2];
+    if (nullptr == mRootAllocator.get() || !mRootAllocator->onGetHugePages(pages)) {
+        return false;
+    }
+    dst[0] = (int)pages[0];
+    dst[1] = (int)pages[1];
+    return true;
+}
+
 void CPURuntime::onConcurrencyBegin() const {
 #ifdef MNN_USE_THREAD_POOL
     if (mTaskIndex < 0 && nullptr != mThreadPool) {
         mTaskIndex = mThreadPool->acquireWorkIndex();
+        mThreadPool->setWorkConfig(mTaskIndex, hint().cpuTaskPriority, hint().cpuCoreBudget);
     }
     if (mTaskIndex >= 0) {
         // mThreadOpen 0 -> 1, active ThreadPool
@@ -414,7 +619,16 @@ void CPURuntime::onConcurrencyEnd() const {
         mThreadOpen--;
         mThreadOpen = mThreadOpen < 0 ? 0 : mThreadOpen;
         if (0 == mThreadOpen) {
+            auto stats = mThreadPool->getWorkStats(mTaskIndex);
+            mQueueStats.regions += stats.regions;
+            mQueueStats.unhelped += stats.unhelped;
+            mQueueStats.queueDelayUs += stats.queueDelayUs;
+            mQueueStats.maxQueueDelayUs = ALIMAX(mQueueStats.maxQueueDelayUs, stats.maxQueueDelayUs);
             mThreadPool->releaseWorkIndex(mTaskIndex);
+            for (auto index : mLaneTaskIndex) {
+                mThreadPool->releaseWorkIndex(index);
+            }
+            mLaneTaskIndex.clear();
             mThreadPool->deactive();
             mTaskIndex = -1;
         }
@@ -437,7 +651,7 @@ bool CPUBackend::addCreator(OpType t, Creator* c) {
     return true;
 }
 BufferAllocator* CPURuntime::createDynamicBufferAlloctor(int index) const {
-    if (hint().memoryAllocatorType == Runtime::Allocator_Defer) {
+    if (hint().memoryAllocatorType != Runtime::Allocator_Eager) {
         return new DeferBufferAllocator(buffer(index));
     }
     if (nullptr != mStaticAllocatorRaw.get()) {
@@ -533,7 +747,14 @@ void CPUBackend::onExecuteBegin() const {
 }
 
 void CPUBackend::onExecuteEnd() const {
-    // Do nothing
+    // Do nothing, pending advices finish in background. They are drained before the weights are freed or unmapped
+}
+
+void CPUBackend::onPrefetch(const Op* op, bool release) const {
+    if (nullptr == op || nullptr == op->name()) {
+        return;
+    }
+    mRuntime->_adviseWeights(op->name()->str(), release);
 }
 
 void CPUBackend::onResizeBegin() {
@@ -565,6 +786,18 @@ ErrorCode CPUBackend::onResizeEnd() {
     return NO_ERROR;
 }
 
+// Static chunk of a streamed weight, forgotten by the runtime before it is freed
+class CPUWeightMemObj : public CPUMemObj {
+public:
+    CPUWeightMemObj(const CPURuntime* runtime, BufferAllocator* allocator, MemChunk chunk, int size) : CPUMemObj(allocator, chunk, size), mRuntime(runtime) {
+    }
+    virtual ~CPUWeightMemObj() {
+        mRuntime->_releaseWeight(chunk().ptr());
+    }
+private:
+    const CPURuntime* mRuntime;
+};
+
 Backend::MemObj* CPUBackend::allocBuffer(size_t size, Tensor* dest, StorageType storageType) {
     auto originMem = TensorUtils::getDescribeOrigin(dest)->mem.get();
     if (nullptr != originMem) {
@@ -589,6 +822,9 @@ Backend::MemObj* CPUBackend::allocBuffer(size_t size, Tensor* dest, StorageType
     switch (storageType) {
         case STATIC: {
             chunk = mRuntime->mStaticAllocator->alloc(size, false);
+            if (nullptr != mWeightRecord && !chunk.invalid()) {
+                mWeightRecord->emplace_back(chunk.ptr(), size);
+            }
             break;
         }
         case DYNAMIC: {
@@ -611,7 +847,9 @@ Backend::MemObj* CPUBackend::allocBuffer(size_t size, Tensor* dest, StorageType
 
     Backend::MemObj* res = nullptr;
 
-    if (storageType == STATIC) {
+    if (storageType == STATIC && nullptr != mWeightRecord) {
+        res = new CPUWeightMemObj(mRuntime, mRuntime->mStaticAllocator.get(), chunk, size);
+    } else if (storageType == STATIC) {
         res = new CPUMemObj(mRuntime->mStaticAllocator.get(), chunk, size);
     } else {
         res = new CPUMemObj(mDmaInfo->mCurrentDynamicAllocator, chunk, size);
@@ -632,6 +870,53 @@ void CPUBackend::enqueueTask(std::function<int()>&& task) {
     }
 }
 
+#ifdef MNN_USE_THREAD_POOL
+// Work index of the op run by this thread inside runConcurrently, -1 outside
+static thread_local int gLaneTaskIndex = -1;
+static thread_local ThreadPool* gLanePool = nullptr;
+
+void CPUBackend::enqueue(ThreadPool::TASK& task) const {
+    auto pool = threadPool();
+    pool->enqueue(&task, (gLaneTaskIndex >= 0 && gLanePool == pool) ? gLaneTaskIndex : taskIndex());
+}
+#endif
+
+void CPUBackend::runConcurrently(const std::function<void(int)>& task, int number) const {
+#ifdef MNN_USE_THREAD_POOL
+    auto pool = threadPool();
+    int budget = mThreadNumber;
+    if (mRuntime->hint().cpuCoreBudget > 0) {
+        budget = ALIMIN(budget, mRuntime->hint().cpuCoreBudget);
+    }
+    int lanes = ALIMIN(number, budget);
+    if (nullptr != pool && taskIndex() >= 0 && gLaneTaskIndex < 0 && lanes > 1) {
+        // One work index per lane, so that the regions of the ops don't wait each other
+        auto& laneIndex = mRuntime->mLaneTaskIndex;
+        while (laneIndex.size() < lanes) {
+            laneIndex.emplace_back(pool->acquireWorkIndex());
+        }
+        for (int i = 0; i < lanes; ++i) {
+            pool->setWorkConfig(laneIndex[i], mRuntime->hint().cpuTaskPriority, ALIMAX(budget / lanes, 1));
+        }
+        std::atomic_int next(0);
+        ThreadPool::TASK laneTask = std::make_pair([&](int lane) {
+            gLaneTaskIndex = laneIndex[lane];
+            gLanePool = pool;
+            for (int i = next++; i < number; i = next++) {
+                task(i);
+            }
+            gLaneTaskIndex = -1;
+            gLanePool = nullptr;
+        }, lanes);
+        pool->enqueue(&laneTask, taskIndex());
+        return;
+    }
+#endif
+    for (int i = 0; i < number; ++i) {
+        task(i);
+    }
+}
+
 Backend::MemObj* CPUBackend::onAcquire(const MNN::Tensor* nativeTensorConst, StorageType storageType) {
     if (nativeTensorConst == nullptr) {
         return nullptr;
@@ -744,9 +1029,18 @@ Execution* CPUBackend::onCreate(const std::vector<Tensor*>& inputs, const std::v
     }
     Execution* exe = nullptr;
     bool needCast = false;
+    // Weights acquired by the execution are streamed by onPrefetch if they live in the mmap file
+    std::vector<std::pair<void*, size_t>> weights;
+    if (mRuntime->hint().weightPrefetchWindow > 0 && nullptr != op->name() && nullptr != mRuntime->mStaticAllocatorMMap.get() && mRuntime->mStaticAllocator == mRuntime->mStaticAllocatorMMap) {
+        mWeightRecord = &weights;
+    }
     if (exe == nullptr) {
         exe = iter->second->onCreate(inputs, outputs, op, this);
     }
+    mWeightRecord = nullptr;
+    if (nullptr != exe && !weights.empty()) {
+        mRuntime->_recordWeights(op->name()->str(), std::move(weights));
+    }
     return exe;
 }
 const Runtime* CPUBackend::getRuntime() {
@@ -9,8 +9,10 @@
 #ifndef CPUBackend_hpp
 #define CPUBackend_hpp
 
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <MNN/AutoTime.hpp>
 #include "core/Backend.hpp"
 #include "core/Execution.hpp"
@@ -24,6 +26,7 @@
 namespace MNN {
 class WorkerThread;
 class CPUResizeCache;
+class CPUKVBlockPool;
 class CPURuntime : public Runtime {
 public:
     struct DynamicAllocator {
@@ -40,6 +43,9 @@ public:
     virtual void onReset(int numberThread, const BackendConfig* config, bool full) override;
     virtual void onGabageCollect(int level) override;
     virtual float onGetMemoryInMB() override;
+    virtual bool onGetQueueDelay(float* dst) const override;
+    virtual bool onGetHugePages(int* dst) const override;
+    virtual bool onGetWeightPrefetch(int* dst) const override;
     virtual CompilerType onGetCompilerType() const override {
         return Compiler_Loop;
     }
@@ -49,11 +55,23 @@ public:
 
     SingleBufferWithAllocator* buffer(int index) const;
     BufferAllocator* createDynamicBufferAlloctor(int index) const;
+    // Paged kvcache blocks of the same size are shared by all sessions created from this runtime
+    std::shared_ptr<CPUKVBlockPool> getKVBlockPool(size_t blockBytes) const;
 
 private:
     void _bindCPUCore() const;
     void _resetThreadPool() const;
     void _validateCpuIds() const;
+    // Switches the root of static and dynamic memory to the NUMA node / huge pages asked by the hint
+    void _resetRootAllocator() const;
+    // Weight streaming, see CPUBackend::onPrefetch
+    void _recordWeights(const std::string& name, std::vector<std::pair<void*, size_t>>&& weights) const;
+    void _adviseWeights(const std::string& name, bool release) const;
+    // Called before a streamed weight is freed, no advice may touch it afterwards
+    void _releaseWeight(void* ptr) const;
+    // Wait for the pending advices
+    void _drainPrefetch() const;
+    friend class CPUWeightMemObj;
     mutable std::shared_ptr<EagerBufferAllocator> mStaticAllocator;
     mutable int mThreadNumber;
     mutable std::vector<int> mCpuIds;
@@ -64,6 +82,10 @@ private:
 #ifdef MNN_USE_THREAD_POOL
     mutable int mTaskIndex = -1;
     mutable int mThreadOpen = 0;
+    // Accumulated when the work index is released
+    mutable ThreadPool::Stats mQueueStats;
+    // Work indices of the ops run together by CPUBackend::runConcurrently, released with mTaskIndex
+    mutable std::vector<int> mLaneTaskIndex;
 #endif
     BackendConfig::MemoryMode mMemory;
     BackendConfig::PowerMode mPower;
@@ -79,6 +101,21 @@ private:
     mutable std::shared_ptr<DynamicAllocator> mSharedDmaInfo;
     mutable std::shared_ptr<EagerBufferAllocator> mStaticAllocatorRaw;
     mutable std::shared_ptr<EagerBufferAllocator> mStaticAllocatorMMap;
+    // File prefix of mStaticAllocatorMMap, its model and weight layout when USE_CACHED_MMAP is set
+    mutable std::string mStaticMmapPrefix;
+    // NUMA node and huge pages of mStaticAllocator and the roots of mDynamic, root is nullptr for the default
+    mutable int mNumaNode = -1;
+    mutable bool mHugePage = false;
+    mutable std::shared_ptr<BufferAllocator::Allocator> mRootAllocator;
+    mutable std::mutex mKVBlockPoolLock;
+    mutable std::map<size_t, std::shared_ptr<CPUKVBlockPool>> mKVBlockPools;
+    // Weights living in the static mmap file keyed by op name, only recorded when weight prefetch is enabled.
+    // Kept by the runtime so that the backends of cloned sessions stream them too
+    mutable std::mutex mWeightRegionLock;
+    mutable std::map<std::string, std::vector<std::pair<void*, size_t>>> mWeightRegions;
+    mutable std::map<void*, std::string> mWeightOwners;
+    mutable std::shared_ptr<WorkerThread> mPrefetchQueue;
+    mutable int mPrefetchAdvices = 0;
 };
 struct CoreFunctions;
 struct CoreInt8Functions;
@@ -124,6 +161,7 @@ public:
 
     virtual void onExecuteBegin() const override;
     virtual void onExecuteEnd() const override;
+    virtual void onPrefetch(const Op* op, bool release) const override;
     virtual void* onMapTensor(Tensor::MapType mtype, Tensor::DimensionType dtype, const Tensor* srcTensor) override;
 
     virtual bool onUnmapTensor(Tensor::MapType mtype, Tensor::DimensionType dtype, const Tensor* dstTensor, void* mapPtr) override;
@@ -176,10 +214,12 @@ public:
 #ifdef MNN_USE_THREAD_POOL
     inline int taskIndex() const {return mRuntime->mTaskIndex;}
     inline ThreadPool* threadPool() const {return mRuntime->mThreadPool;}
-    void enqueue(ThreadPool::TASK& task) const {
-        threadPool()->enqueue(&task, taskIndex());
-    }
+    // Inside runConcurrently the parallel regions go to the work index of the calling op
+    void enqueue(ThreadPool::TASK& task) const;
 #endif
+    // Run task(i) for i in [0, number) concurrently, each i is an op with its own parallel regions and the
+    // threads are split between the ops running together. In order if the thread pool isn't available
+    void runConcurrently(const std::function<void(int)>& task, int number) const;
     static void initCreatorMap();
     static size_t getBytes(const Backend* backend, const Tensor* output);
     static DataType getDataType(const Tensor* tensor);
@@ -194,6 +234,8 @@ protected:
     CPURuntime* mRuntime;
 private:
     mutable std::shared_ptr<WorkerThread> mInitWorkQueue;
+    // Static chunks allocated by the op being created, streamed by onPrefetch
+    std::vector<std::pair<void*, size_t>>* mWeightRecord = nullptr;
     mutable int mThreadNumber = 1;
     std::vector<std::pair<float, int>> mGroupWithComputeRate;
     float mComputeI = 0.f;
@@ -11,6 +11,7 @@
 #include "backend/cpu/CPUBackend.hpp"
 #include "backend/cpu/CPUDetectionPostProcess.hpp"
 #include "backend/cpu/CPUNonMaxSuppressionV2.hpp"
+#include "core/Concurrency.h"
 
 namespace MNN {
 
@@ -46,10 +47,20 @@ static void _decodeBoxes(const Tensor* boxesEncoding, const Tensor* anchors, con
     }
 }
 
-static void _NonMaxSuppressionMultiClassFastImpl(const DetectionPostProcessParamT& postProcessParam,
-                                                 const Tensor* decodedBoxes, const Tensor* classPredictions,
-                                                 Tensor* detectionBoxes, Tensor* detectionClass,
-                                                 Tensor* detectionScores, Tensor* numDetections) {
+void CPUDetectionPostProcess::_select(NMSCandidates* candidates, int maxDetections, int threadNumber, std::vector<int>* selected) {
+    if (candidates->preferBitmask(maxDetections, threadNumber)) {
+        candidates->prepareRows(maxDetections);
+        MNN_CONCURRENCY_BEGIN(tId, threadNumber) {
+            candidates->computeRows((int)tId, threadNumber, mParam.iouThreshold);
+        }
+        MNN_CONCURRENCY_END();
+    }
+    candidates->select(maxDetections, mParam.iouThreshold, selected);
+}
+
+void CPUDetectionPostProcess::_fastNMS(const Tensor* decodedBoxes, const Tensor* classPredictions, Tensor* detectionBoxes,
+                                       Tensor* detectionClass, Tensor* detectionScores, Tensor* numDetections) {
+    const auto& postProcessParam = mParam;
     // decoded_boxes shape is [numBoxes, 4]
     const int numBoxes               = decodedBoxes->length(0);
     const int numClasses             = postProcessParam.numClasses;
@@ -64,20 +75,25 @@ static void _NonMaxSuppressionMultiClassFastImpl(const DetectionPostProcessParam
     std::vector<int> sortedClassIndices;
     sortedClassIndices.resize(numBoxes * numClasses);
     const auto scoresStartPtr = classPredictions->host<float>();
+    int threadNumber = static_cast<CPUBackend*>(backend())->threadNumber();
     // sort scores on every anchor
-    for (int idx = 0; idx < numBoxes; ++idx) {
-        const auto boxScores = scoresStartPtr + idx * numClassWithBackground + labelOffset;
-        auto classIndices    = sortedClassIndices.data() + idx * numClasses;
-
-        std::iota(classIndices, classIndices + numClasses, 0);
-        std::partial_sort(classIndices, classIndices + numCategoriesPerAnchor, classIndices + numClasses,
-                          [&boxScores](const int i, const int j) { return boxScores[i] > boxScores[j]; });
-        maxScores[idx] = boxScores[classIndices[0]];
+    MNN_CONCURRENCY_BEGIN(tId, threadNumber) {
+        for (int idx = (int)tId; idx < numBoxes; idx += threadNumber) {
+            const auto boxScores = scoresStartPtr + idx * numClassWithBackground + labelOffset;
+            auto classIndices    = sortedClassIndices.data() + idx * numClasses;
+
+            std::iota(classIndices, classIndices + numClasses, 0);
+            std::partial_sort(classIndices, classIndices + numCategoriesPerAnchor, classIndices + numClasses,
+                              [&boxScores](const int i, const int j) { return boxScores[i] > boxScores[j]; });
+            maxScores[idx] = boxScores[classIndices[0]];
+        }
     }
+    MNN_CONCURRENCY_END();
 
     std::vector<int> seleted;
-    NonMaxSuppressionSingleClasssImpl(decodedBoxes, maxScores.data(), postProcessParam.maxDetections,
-                                      postProcessParam.iouThreshold, postProcessParam.nmsScoreThreshold, &seleted);
+    auto& candidates = mCandidates[0];
+    candidates.prepare(decodedBoxes->host<float>(), maxScores.data(), 1, numBoxes, postProcessParam.nmsScoreThreshold);
+    _select(&candidates, postProcessParam.maxDetections, threadNumber, &seleted);
 
     const auto decodedBoxesPtr = reinterpret_cast<const BoxCornerEncoding*>(decodedBoxes->host<float>());
     auto detectionBoxesPtr     = reinterpret_cast<BoxCornerEncoding*>(detectionBoxes->host<float>());
@@ -100,13 +116,63 @@ static void _NonMaxSuppressionMultiClassFastImpl(const DetectionPostProcessParam
     *numDetectionsPtr = outputBoxIndex;
 }
 
+void CPUDetectionPostProcess::_regularNMS(const Tensor* decodedBoxes, const Tensor* classPredictions, Tensor* detectionBoxes,
+                                          Tensor* detectionClass, Tensor* detectionScores, Tensor* numDetections) {
+    const int numBoxes               = decodedBoxes->length(0);
+    const int numClasses             = mParam.numClasses;
+    const int numClassWithBackground = classPredictions->length(2);
+    const int labelOffset            = numClassWithBackground - numClasses;
+    const int detectionsPerClass     = mParam.detectionsPerClass > 0 ? mParam.detectionsPerClass : mParam.maxDetections;
+    const auto scoresStartPtr        = classPredictions->host<float>() + labelOffset;
+    const auto boxesPtr              = decodedBoxes->host<float>();
+    int threadNumber                 = (int)mCandidates.size();
+
+    // nms of every class on its own, the classes are split across threads
+    std::vector<std::vector<int>> classSelected(numClasses);
+    MNN_CONCURRENCY_BEGIN(tId, threadNumber) {
+        auto& candidates = mCandidates[tId];
+        for (int c = (int)tId; c < numClasses; c += threadNumber) {
+            candidates.prepare(boxesPtr, scoresStartPtr + c, numClassWithBackground, numBoxes, mParam.nmsScoreThreshold);
+            candidates.select(detectionsPerClass, mParam.iouThreshold, &classSelected[c]);
+        }
+    }
+    MNN_CONCURRENCY_END();
+
+    // then the best maxDetections of all classes are output
+    struct Detection {
+        float score;
+        int boxIndex;
+        int classIndex;
+    };
+    std::vector<Detection> detections;
+    for (int c = 0; c < numClasses; ++c) {
+        for (auto index : classSelected[c]) {
+            detections.emplace_back(Detection({scoresStartPtr[index * numClassWithBackground + c], index, c}));
+        }
+    }
+    const int outputNum = std::min((int)detections.size(), mParam.maxDetections);
+    std::partial_sort(detections.begin(), detections.begin() + outputNum, detections.end(),
+                      [](const Detection& a, const Detection& b) {
+                          return a.score > b.score || (a.score == b.score && a.classIndex < b.classIndex);
+                      });
+
+    const auto decodedBoxesPtr = reinterpret_cast<const BoxCornerEncoding*>(boxesPtr);
+    auto detectionBoxesPtr     = reinterpret_cast<BoxCornerEncoding*>(detectionBoxes->host<float>());
+    auto detectionClassesPtr   = detectionClass->host<float>();
+    auto detectionScoresPtr    = detectionScores->host<float>();
+    for (int i = 0; i < outputNum; ++i) {
+        detectionBoxesPtr[i]   = decodedBoxesPtr[detections[i].boxIndex];
+        detectionClassesPtr[i] = detections[i].classIndex;
+        detectionScoresPtr[i]  = detections[i].score;
+    }
+    *numDetections->host<float>() = outputNum;
+}
+
 CPUDetectionPostProcess::CPUDetectionPostProcess(Backend* bn, const MNN::Op* op) : Execution(bn) {
     auto param = op->main_as_DetectionPostProcessParam();
     param->UnPackTo(&mParam);
-    if (mParam.useRegularNMS) {
-        MNN_ERROR("TODO, use regular NMS to process decoded boxes!");
-        return;
-    }
+    // one candidates scratch for each thread
+    mCandidates.resize(static_cast<CPUBackend*>(bn)->threadNumber());
 }
 
 ErrorCode CPUDetectionPostProcess::onResize(const std::vector<Tensor*>& inputs, const std::vector<Tensor*>& outputs) {
@@ -132,11 +198,10 @@ ErrorCode CPUDetectionPostProcess::onExecute(const std::vector<Tensor*>& inputs,
     _decodeBoxes(inputs[0], inputs[2], scaleValues, mDecodedBoxes.get());
 
     if (mParam.useRegularNMS) {
-        return NOT_SUPPORT;
+        _regularNMS(mDecodedBoxes.get(), inputs[1], outputs[0], outputs[1], outputs[2], outputs[3]);
     } else {
         // perform NMS on max scores
-        _NonMaxSuppressionMultiClassFastImpl(mParam, mDecodedBoxes.get(), inputs[1], outputs[0], outputs[1], outputs[2],
-                                             outputs[3]);
+        _fastNMS(mDecodedBoxes.get(), inputs[1], outputs[0], outputs[1], outputs[2], outputs[3]);
     }
 
     return NO_ERROR;
@@ -10,6 +10,7 @@
 
 #include "core/Execution.hpp"
 #include "MNN_generated.h"
+#include "backend/cpu/CPUNonMaxSuppressionV2.hpp"
 
 namespace MNN {
 
@@ -42,7 +43,16 @@ public:
     virtual ErrorCode onExecute(const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs) override;
 
 private:
+    // nms of the max class score of every anchor
+    void _fastNMS(const Tensor* decodedBoxes, const Tensor* classPredictions, Tensor* detectionBoxes, Tensor* detectionClass,
+                  Tensor* detectionScores, Tensor* numDetections);
+    // nms of every class, then the best detections of all classes
+    void _regularNMS(const Tensor* decodedBoxes, const Tensor* classPredictions, Tensor* detectionBoxes, Tensor* detectionClass,
+                     Tensor* detectionScores, Tensor* numDetections);
+    void _select(NMSCandidates* candidates, int maxDetections, int threadNumber, std::vector<int>* selected);
+
     DetectionPostProcessParamT mParam;
+    std::vector<NMSCandidates> mCandidates;
 
     std::shared_ptr<Tensor> mDecodedBoxes;
 };
@@ -0,0 +1,113 @@
+//
+//  CPUKVBlockPool.cpp
+//  MNN
+//
+//  Created by MNN on 2026/10/15.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#include <algorithm>
+#include "CPUKVBlockPool.hpp"
+#include "core/Macro.h"
+#include "core/MNNMemoryUtils.h"
+
+namespace MNN {
+
+CPUKVBlockPool::CPUKVBlockPool(size_t blockBytes, int blocksPerChunk, std::shared_ptr<BufferAllocator::Allocator> allocator) {
+    mBlockBytes = UP_DIV(blockBytes, MNN_MEMORY_ALIGN_DEFAULT) * MNN_MEMORY_ALIGN_DEFAULT;
+    mBlocksPerChunk = ALIMAX(blocksPerChunk, 1);
+    mAllocator = allocator;
+}
+
+int8_t* CPUKVBlockPool::_allocChunk() {
+    if (nullptr != mAllocator) {
+        return (int8_t*)mAllocator->onAlloc(mBlockBytes * mBlocksPerChunk, MNN_MEMORY_ALIGN_DEFAULT).first;
+    }
+    return (int8_t*)MNNMemoryAllocAlign(mBlockBytes * mBlocksPerChunk, MNN_MEMORY_ALIGN_DEFAULT);
+}
+
+void CPUKVBlockPool::_freeChunk(int8_t* base) {
+    if (nullptr != mAllocator) {
+        mAllocator->onRelease(MemChunk(base, 0));
+        return;
+    }
+    MNNMemoryFreeAlign(base);
+}
+
+CPUKVBlockPool::~CPUKVBlockPool() {
+    if (mUsed > 0) {
+        MNN_ERROR("CPUKVBlockPool released with %d blocks in use\n", (int)mUsed);
+    }
+    for (auto& chunk : mChunks) {
+        _freeChunk(chunk.base);
+    }
+}
+
+int8_t* CPUKVBlockPool::acquire() {
+    std::lock_guard<std::mutex> _l(mLock);
+    if (mFree.empty()) {
+        auto base = _allocChunk();
+        if (nullptr == base) {
+            return nullptr;
+        }
+        mChunks.emplace_back(Chunk{base, 0});
+        // Push in reverse order so that blocks are handed out by increasing address
+        for (int i = mBlocksPerChunk - 1; i >= 0; --i) {
+            mFree.emplace_back(base + i * mBlockBytes);
+        }
+    }
+    auto block = mFree.back();
+    mFree.pop_back();
+    for (auto& chunk : mChunks) {
+        if (block >= chunk.base && block < chunk.base + mBlockBytes * mBlocksPerChunk) {
+            chunk.used++;
+            break;
+        }
+    }
+    mUsed++;
+    return block;
+}
+
+void CPUKVBlockPool::release(int8_t* block) {
+    if (nullptr == block) {
+        return;
+    }
+    std::lock_guard<std::mutex> _l(mLock);
+    for (auto& chunk : mChunks) {
+        if (block >= chunk.base && block < chunk.base + mBlockBytes * mBlocksPerChunk) {
+            chunk.used--;
+            break;
+        }
+    }
+    mFree.emplace_back(block);
+    mUsed--;
+}
+
+size_t CPUKVBlockPool::totalBlocks() const {
+    std::lock_guard<std::mutex> _l(mLock);
+    return mChunks.size() * mBlocksPerChunk;
+}
+
+size_t CPUKVBlockPool::usedBlocks() const {
+    std::lock_guard<std::mutex> _l(mLock);
+    return mUsed;
+}
+
+void CPUKVBlockPool::shrink() {
+    std::lock_guard<std::mutex> _l(mLock);
+    auto chunkSize = mBlockBytes * mBlocksPerChunk;
+    for (auto iter = mChunks.begin(); iter != mChunks.end();) {
+        if (iter->used > 0) {
+            iter++;
+            continue;
+        }
+        auto base = iter->base;
+        mFree.erase(std::remove_if(mFree.begin(), mFree.end(), [base, chunkSize](int8_t* block) {
+            return block >= base && block < base + chunkSize;
+        }), mFree.end());
+        _freeChunk(base);
+        iter = mChunks.erase(iter);
+    }
+}
+
+} // namespace MNN
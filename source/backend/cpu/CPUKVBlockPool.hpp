@@ -0,0 +1,55 @@
+//
+//  CPUKVBlockPool.hpp
+//  MNN
+//
+//  Created by MNN on 2026/10/15.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#ifndef CPUKVBlockPool_hpp
+#define CPUKVBlockPool_hpp
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "core/BufferAllocator.hpp"
+#include "core/NonCopyable.hpp"
+
+namespace MNN {
+/**
+ Fixed-size blocks shared by the paged kvcache of all layers / sessions created by one CPURuntime.
+ Blocks are never moved, so a kvcache grows by appending a block to its block table.
+ */
+class CPUKVBlockPool : public NonCopyable {
+public:
+    // Chunks come from allocator if set, such as the huge page / NUMA root of the runtime
+    CPUKVBlockPool(size_t blockBytes, int blocksPerChunk = 16, std::shared_ptr<BufferAllocator::Allocator> allocator = nullptr);
+    ~CPUKVBlockPool();
+    int8_t* acquire();
+    void release(int8_t* block);
+    size_t blockBytes() const {
+        return mBlockBytes;
+    }
+    size_t totalBlocks() const;
+    size_t usedBlocks() const;
+    // Free the chunks whose blocks are all unused
+    void shrink();
+
+private:
+    int8_t* _allocChunk();
+    void _freeChunk(int8_t* base);
+    struct Chunk {
+        int8_t* base;
+        int used;
+    };
+    size_t mBlockBytes;
+    int mBlocksPerChunk;
+    std::shared_ptr<BufferAllocator::Allocator> mAllocator;
+    mutable std::mutex mLock;
+    std::vector<Chunk> mChunks;
+    std::vector<int8_t*> mFree;
+    size_t mUsed = 0;
+};
+} // namespace MNN
+
+#endif
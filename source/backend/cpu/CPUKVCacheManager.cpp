@@ -9,6 +9,7 @@
 #ifdef MNN_SUPPORT_TRANSFORMER_FUSE
 
 #include "CPUKVCacheManager.hpp"
+#include "core/AutoStorage.h"
 #include "core/Concurrency.h"
 
 namespace MNN {
@@ -362,12 +363,20 @@ void CPUKVCacheManager::onAlloc(KVMeta* meta, int seq_len) {
 
     // Do not use mMeta->add, because in VL models or Qnn case, mMeta->add is 0 or mMeta is nullptr.
     int kv_seq_len = seq_len;
+    int prefixLength = 0;
+    if (mMeta != nullptr && mMeta->prefix_block > 0 && mMeta->prefix_read > 0) {
+        prefixLength = mMeta->prefix_read * mMeta->prefix_block;
+        kv_seq_len += prefixLength;
+    }
     mMaxLength = kv_seq_len + mConfig.mExpandChunk;
     if (mUseFlashAttention) {
         setFlashAttentionUpperKv(MNN_FLASH_ATTENTION_BLOCK_SIZE);
     } else {
         setFlashAttentionUpperKv(mMaxLength);
     }
+    // Size of one flash attention block of a head, used by the paged layout and the prefix cache
+    mKeyBlockSizePerHead = (size_t)MNN_FLASH_ATTENTION_BLOCK_SIZE * ROUND_UP(mHeadDim, lP) * mBytes;
+    mValueBlockSizePerHead = (size_t)ROUND_UP(mHeadDim, hP) * ROUND_UP(MNN_FLASH_ATTENTION_BLOCK_SIZE, lP) * mBytes;
 
     // 1. compute size
     if (mQuantKey) {
@@ -389,6 +398,9 @@ void CPUKVCacheManager::onAlloc(KVMeta* meta, int seq_len) {
     // case2: multi prompts share a common prefix kv cache info
     bool storeKvInDisk  = !mConfig.mKVCacheDir.empty();
     bool sharePrefixKv = mMeta != nullptr && mMeta->file_name.size() > 0 && mMeta->file_flag == KVMeta::PendingWrite;
+    // A block must hold whole hP packs of keys, and the paged layout is only read by the float flash attention path
+    mPaged = mConfig.mPaged && mUseFlashAttention && !mQuantKey && !mQuantValue && !storeKvInDisk && !sharePrefixKv
+        && MNN_FLASH_ATTENTION_BLOCK_SIZE % hP == 0;
 
     if (sharePrefixKv) {
         mSaveShareKvPrefix = true;
@@ -410,6 +422,9 @@ void CPUKVCacheManager::onAlloc(KVMeta* meta, int seq_len) {
         resetKVCacheFileSize(keySize, valueSize);
         mmapKVCache(keySize, valueSize);
         mKVCacheInDisk = true;
+    } else if (mPaged) { // store kv in blocks of the runtime's pool
+        mBlockPool = static_cast<const CPURuntime*>(mBackend->getRuntime())->getKVBlockPool(mKvNumHead * (mKeyBlockSizePerHead + mValueBlockSizePerHead));
+        resizeBlocks(ALIMAX(UP_DIV(kv_seq_len, MNN_FLASH_ATTENTION_BLOCK_SIZE), 1));
     } else { // store kv in memory
         mPastKey.reset(Tensor::createDevice<int8_t>({mKvNumHead, (int)mCurrentKeySizePerHead}));
         mPastValue.reset(Tensor::createDevice<int8_t>({mKvNumHead, (int)mCurrentValueSizePerHead}));
@@ -445,11 +460,19 @@ void CPUKVCacheManager::onAlloc(KVMeta* meta, int seq_len) {
         mBackend->onAcquireBuffer(mValueSum.get(), Backend::STATIC);
         memset(mValueSum->host<int8_t>(), 0, mValueSum->stride(0) * mValueSum->length(0));
     }
+    if (prefixLength > 0) {
+        loadPrefixBlocks();
+    }
 }
 
 void CPUKVCacheManager::onRealloc(KVMeta* meta) {
     auto kv_seq_len = meta->previous + meta->add - meta->remove + meta->computeReverseSize();
-    if (kv_seq_len > mMaxLength) {
+    if (mPaged) {
+        // Only append blocks, the old ones are never moved
+        if (kv_seq_len > mMaxLength) {
+            resizeBlocks(UP_DIV((int)kv_seq_len, MNN_FLASH_ATTENTION_BLOCK_SIZE));
+        }
+    } else if (kv_seq_len > mMaxLength) {
         // Realloc
         int oldMaxLength = mMaxLength;
         mMaxLength = (int)kv_seq_len + mConfig.mExpandChunk;
@@ -510,6 +533,9 @@ void CPUKVCacheManager::onRealloc(KVMeta* meta) {
     auto start = mPastLength - meta->remove;
     if (0 == meta->n_reserve || mQuantKey || mQuantValue) { // n_reserve > 0 is not currently supported when K or V is quantized.
         mPastLength = start;
+        if (mPaged) {
+            resizeBlocks(ALIMAX(UP_DIV(mPastLength + (int)meta->add, MNN_FLASH_ATTENTION_BLOCK_SIZE), 1));
+        }
         return;
     }
 #if 1
@@ -526,6 +552,10 @@ void CPUKVCacheManager::onRealloc(KVMeta* meta) {
         dstIndex += size;
     }
     mPastLength = dstIndex;
+    if (mPaged) {
+        // Return the blocks after the removed tokens to the pool
+        resizeBlocks(ALIMAX(UP_DIV(mPastLength + (int)meta->add, MNN_FLASH_ATTENTION_BLOCK_SIZE), 1));
+    }
 #else
     // Don't support not align reserve
     auto align = hP;
@@ -664,6 +694,10 @@ void CPUKVCacheManager::onClear() {
         }
         mKVCacheInDisk = false;
     }
+    if (mPaged) {
+        resizeBlocks(0);
+        mPaged = false;
+    }
     mPastKey.reset();
     mPastValue.reset();
     mKeySum.reset();
@@ -693,8 +727,13 @@ void CPUKVCacheManager::ProcessKey(const Tensor* key, int seqLen, int kvHead) {
         auto stride1 = hP * lP;
         for (int i = 0; i < seqLen; i++) {
             T * key_src = key->host<T>() + i * mKvNumHead * mHeadDim + kvHead * mHeadDim;
-            int out_index = (mPastLength + i) / hP;
-            int in_index  = (mPastLength + i) % hP;
+            int seqIndex = mPastLength + i;
+            if (mPaged) {
+                key_dst = reinterpret_cast<T*>(addrOfKeyBlock(kvHead, seqIndex / MNN_FLASH_ATTENTION_BLOCK_SIZE));
+                seqIndex = seqIndex % MNN_FLASH_ATTENTION_BLOCK_SIZE;
+            }
+            int out_index = seqIndex / hP;
+            int in_index  = seqIndex % hP;
             for (int j = 0; j < mHeadDim; j++) {
                 key_dst[out_index * stride0 + (j / lP) * stride1 + in_index * lP + (j % lP)] = key_src[j];
             }
@@ -727,6 +766,10 @@ void CPUKVCacheManager::ProcessValue(const Tensor* value, int seqLen, int kvHead
             // int seqLenIn = (mPastLength + i) % lP;
 
             int kvSeqIndx = mPastLength + i;
+            if (mPaged) {
+                value_dst = reinterpret_cast<T*>(addrOfValueBlock(kvHead, kvSeqIndx / MNN_FLASH_ATTENTION_BLOCK_SIZE));
+                kvSeqIndx = kvSeqIndx % MNN_FLASH_ATTENTION_BLOCK_SIZE;
+            }
             int idxInner = (kvSeqIndx / (int32_t)mFlashAttentionUpperKv) * weightStride0 + (kvSeqIndx % (int32_t)mFlashAttentionUpperKv) / lP * weightStride2 + (kvSeqIndx % (int32_t)mFlashAttentionUpperKv) % lP;
             for (int j = 0; j < mHeadDim; j++) {
                 int idxBase = (j / hP) * weightStride1 + (j % hP) * lP;
@@ -753,8 +796,52 @@ size_t CPUKVCacheManager::valueIndex(int seq, int dim) const {
            (seq % lP);
 }
 
+size_t CPUKVCacheManager::blockValueIndex(int seq, int dim) const {
+    return (dim / hP) * ROUND_UP(MNN_FLASH_ATTENTION_BLOCK_SIZE, lP) * hP +
+           (seq / lP) * hP * lP +
+           (dim % hP) * lP +
+           (seq % lP);
+}
+
+void CPUKVCacheManager::resizeBlocks(int blockNumber) {
+    while (mBlockTable.size() > blockNumber) {
+        mBlockPool->release(mBlockTable.back());
+        mBlockTable.pop_back();
+    }
+    while (mBlockTable.size() < blockNumber) {
+        auto block = mBlockPool->acquire();
+        if (nullptr == block) {
+            MNN_ERROR("Failed to acquire kvcache block, kvcache length is limited to %d\n", (int)mBlockTable.size() * MNN_FLASH_ATTENTION_BLOCK_SIZE);
+            break;
+        }
+        // The padding of the last block must be zero for the packed matmul
+        ::memset(block, 0, mBlockPool->blockBytes());
+        mBlockTable.emplace_back(block);
+    }
+    mMaxLength = (int)mBlockTable.size() * MNN_FLASH_ATTENTION_BLOCK_SIZE;
+}
+
 template <typename T>
 void CPUKVCacheManager::moveKV(int src, int dst, int size) {
+    if (mPaged) {
+        for (int h = 0; h < mKvNumHead; ++h) {
+            for (int i = 0; i < size; i++) {
+                auto srcSeq = src + i;
+                auto dstSeq = dst + i;
+                auto srcK = reinterpret_cast<T*>(addrOfKeyBlock(h, srcSeq / MNN_FLASH_ATTENTION_BLOCK_SIZE));
+                auto dstK = reinterpret_cast<T*>(addrOfKeyBlock(h, dstSeq / MNN_FLASH_ATTENTION_BLOCK_SIZE));
+                auto srcV = reinterpret_cast<T*>(addrOfValueBlock(h, srcSeq / MNN_FLASH_ATTENTION_BLOCK_SIZE));
+                auto dstV = reinterpret_cast<T*>(addrOfValueBlock(h, dstSeq / MNN_FLASH_ATTENTION_BLOCK_SIZE));
+                srcSeq = srcSeq % MNN_FLASH_ATTENTION_BLOCK_SIZE;
+                dstSeq = dstSeq % MNN_FLASH_ATTENTION_BLOCK_SIZE;
+                for (int j = 0; j < mHeadDim; j++) {
+                    dstK[keyIndex(dstSeq, j)] = srcK[keyIndex(srcSeq, j)];
+                    dstV[blockValueIndex(dstSeq, j)] = srcV[blockValueIndex(srcSeq, j)];
+                }
+            }
+        }
+        return;
+    }
     for (int h = 0; h < mKvNumHead; ++h) {
         auto kPtr = reinterpret_cast<T*>(addrOfKey(h));
         auto vPtr = reinterpret_cast<T*>(addrOfValue(h));
@@ -789,6 +876,78 @@ void CPUKVCacheManager::onUpdateKV(const Tensor * key, const Tensor * value, int
         }
     } MNN_CONCURRENCY_END();
     mPastLength += seq_len;
+    if (mMeta != nullptr && mMeta->prefix_block > 0) {
+        savePrefixBlocks();
+    }
+}
+
+bool CPUKVCacheManager::supportPrefixBlocks() const {
+    return mUseFlashAttention && !mQuantKey && !mQuantValue && !mKVCacheInDisk
+        && MNN_FLASH_ATTENTION_BLOCK_SIZE % hP == 0 && mMeta->prefix_block == MNN_FLASH_ATTENTION_BLOCK_SIZE
+        && nullptr != mMeta->prefix_blocks && mMeta->layer_index < mMeta->layer_nums;
+}
+
+int8_t* CPUKVCacheManager::keyOfBlock(int kv_h, int block) {
+    if (mPaged) {
+        return addrOfKeyBlock(kv_h, block);
+    }
+    return addrOfKey(kv_h) + block * mKeyBlockSizePerHead;
+}
+
+int8_t* CPUKVCacheManager::valueOfBlock(int kv_h, int block) {
+    if (mPaged) {
+        return addrOfValueBlock(kv_h, block);
+    }
+    return addrOfValue(kv_h) + block * mValueBlockSizePerHead;
+}
+
+/*
+**  @brief  Copy the cached prefix blocks of this layer to the front of the kvcache
+*/
+void CPUKVCacheManager::loadPrefixBlocks() {
+    if (!supportPrefixBlocks()) {
+        MNN_ERROR("[Error]: Current kvcache layout can't load prefix cache blocks\n");
+        return;
+    }
+    auto sizePerHead = mKeyBlockSizePerHead + mValueBlockSizePerHead;
+    for (int b = 0; b < mMeta->prefix_read; ++b) {
+        auto block = std::static_pointer_cast<AutoStorage<int8_t>>((*mMeta->prefix_blocks)[b * mMeta->layer_nums + mMeta->layer_index]);
+        if (nullptr == block || block->size() != mKvNumHead * sizePerHead) {
+            MNN_ERROR("[Error]: Invalid prefix cache block %d for layer %d\n", b, mMeta->layer_index);
+            return;
+        }
+        for (int h = 0; h < mKvNumHead; ++h) {
+            ::memcpy(keyOfBlock(h, b), block->get() + h * sizePerHead, mKeyBlockSizePerHead);
+            ::memcpy(valueOfBlock(h, b), block->get() + h * sizePerHead + mKeyBlockSizePerHead, mValueBlockSizePerHead);
+        }
+    }
+    mPastLength = mMeta->prefix_read * MNN_FLASH_ATTENTION_BLOCK_SIZE;
+}
+
+/*
+**  @brief  Copy the filled blocks in [prefix_write_begin, prefix_write_end) out for the prefix cache,
+**          each block is numhead x {key block, value block}
+*/
+void CPUKVCacheManager::savePrefixBlocks() {
+    if (supportPrefixBlocks()) {
+        auto sizePerHead = mKeyBlockSizePerHead + mValueBlockSizePerHead;
+        auto filled = ALIMIN(mPastLength / MNN_FLASH_ATTENTION_BLOCK_SIZE, mMeta->prefix_write_end);
+        for (int b = mMeta->prefix_write_begin; b < filled; ++b) {
+            auto& dst = (*mMeta->prefix_blocks)[b * mMeta->layer_nums + mMeta->layer_index];
+            if (nullptr != dst) {
+                continue;
+            }
+            std::shared_ptr<AutoStorage<int8_t>> block(new AutoStorage<int8_t>((int)(mKvNumHead * sizePerHead)));
+            for (int h = 0; h < mKvNumHead; ++h) {
+                ::memcpy(block->get() + h * sizePerHead, keyOfBlock(h, b), mKeyBlockSizePerHead);
+                ::memcpy(block->get() + h * sizePerHead + mKeyBlockSizePerHead, valueOfBlock(h, b), mValueBlockSizePerHead);
+            }
+            dst = block;
+        }
+    }
+    if (mMeta->layer_nums > 0) {
+        mMeta->layer_index = (mMeta->layer_index + 1) % mMeta->layer_nums;
+    }
 }
 
 } // namespace MNN
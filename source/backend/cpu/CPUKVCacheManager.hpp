@@ -13,6 +13,7 @@
 
 #include "core/KVCacheManager.hpp"
 #include "backend/cpu/CPUBackend.hpp"
+#include "backend/cpu/CPUKVBlockPool.hpp"
 #include "backend/cpu/compute/CommonOptFunction.h"
 #if defined (__aarch64__)
 #define FLOAT16_T __fp16
@@ -42,6 +43,14 @@ private:
     template <typename T> void moveKV(int src, int dst, int size);
     size_t keyIndex(int seq, int dim) const;
     size_t valueIndex(int seq, int dim) const;
+    size_t blockValueIndex(int seq, int dim) const;
+    void resizeBlocks(int blockNumber);
+    // prefix cache: exchange whole flash attention blocks with KVMeta::prefix_blocks
+    bool supportPrefixBlocks() const;
+    int8_t* keyOfBlock(int kv_h, int block);
+    int8_t* valueOfBlock(int kv_h, int block);
+    void loadPrefixBlocks();
+    void savePrefixBlocks();
     void saveKVCacheInDisk();
 
     // The key/value size must be updated on every alloc or realloc call.
@@ -51,6 +60,14 @@ private:
     // flash attention
     bool mUseFlashAttention = true;
 
+    // paged kvcache: block b holds the tokens [b * MNN_FLASH_ATTENTION_BLOCK_SIZE, (b + 1) * MNN_FLASH_ATTENTION_BLOCK_SIZE)
+    // of all heads, laid out as numhead x {key: [blocksize/hP, headdim/lP, hP, lP], value: [headdim/hP, blocksize/lP, hP, lP]}
+    bool mPaged = false;
+    std::shared_ptr<CPUKVBlockPool> mBlockPool;
+    std::vector<int8_t*> mBlockTable;
+    size_t mKeyBlockSizePerHead = 0;
+    size_t mValueBlockSizePerHead = 0;
+
     // quant Key/Value
     bool mQuantValue    = false;                    // Quantize values to int8 or not
     bool mQuantKey      = false;                    // Whether to use int8 gemm kernel in CPU attention
@@ -78,11 +95,26 @@ public:
         int8_t * baseAddr = mKVCacheInDisk ? mMapValueAddr : mPastValue->host<int8_t>();
         return (uint8_t*)baseAddr;
     }
+    bool paged() const {
+        return mPaged;
+    }
+    int8_t * addrOfKeyBlock(int kv_h, int block) {
+        return mBlockTable[block] + kv_h * (mKeyBlockSizePerHead + mValueBlockSizePerHead);
+    }
+    int8_t * addrOfValueBlock(int kv_h, int block) {
+        return mBlockTable[block] + kv_h * (mKeyBlockSizePerHead + mValueBlockSizePerHead) + mKeyBlockSizePerHead;
+    }
     int8_t * addrOfKey(int kv_h) {
+        if (mPaged) {
+            return addrOfKeyBlock(kv_h, 0);
+        }
         int8_t * baseAddr = mKVCacheInDisk ? mMapKeyAddr : mPastKey->host<int8_t>();
         return baseAddr + kv_h * mCurrentKeySizePerHead;
     }
     int8_t * addrOfValue(int kv_h) {
+        if (mPaged) {
+            return addrOfValueBlock(kv_h, 0);
+        }
         int8_t * baseAddr = mKVCacheInDisk ? mMapValueAddr : mPastValue->host<int8_t>();
         return baseAddr + kv_h * mCurrentValueSizePerHead;
 
@@ -14,9 +14,13 @@
 
 #include "backend/cpu/CPUNonMaxSuppressionV2.hpp"
 #include <math.h>
-#include <queue>
+#include <algorithm>
 #include "backend/cpu/CPUBackend.hpp"
+#include "core/Concurrency.h"
 #include "core/Macro.h"
+#include "math/Vec.hpp"
+
+using Vec4 = MNN::Math::Vec<float, 4>;
 
 namespace MNN {
 
@@ -24,86 +28,173 @@ CPUNonMaxSuppressionV2::CPUNonMaxSuppressionV2(Backend* backend, const Op* op) :
     // nothing to do
 }
 
-// Return intersection-over-union overlap between boxes i and j
-static inline float IOU(const float* boxes, int i, int j) {
-    const float yMinI = std::min<float>(boxes[i * 4 + 0], boxes[i * 4 + 2]);
-    const float xMinI = std::min<float>(boxes[i * 4 + 1], boxes[i * 4 + 3]);
-    const float yMaxI = std::max<float>(boxes[i * 4 + 0], boxes[i * 4 + 2]);
-    const float xMaxI = std::max<float>(boxes[i * 4 + 1], boxes[i * 4 + 3]);
-    const float yMinJ = std::min<float>(boxes[j * 4 + 0], boxes[j * 4 + 2]);
-    const float xMinJ = std::min<float>(boxes[j * 4 + 1], boxes[j * 4 + 3]);
-    const float yMaxJ = std::max<float>(boxes[j * 4 + 0], boxes[j * 4 + 2]);
-    const float xMaxJ = std::max<float>(boxes[j * 4 + 1], boxes[j * 4 + 3]);
-    const float areaI = (yMaxI - yMinI) * (xMaxI - xMinI);
-    const float areaJ = (yMaxJ - yMinJ) * (xMaxJ - xMinJ);
-    if (areaI <= 0 || areaJ <= 0)
-        return 0.0;
-    const float intersectionYMin = std::max<float>(yMinI, yMinJ);
-    const float intersectionXMin = std::max<float>(xMinI, xMinJ);
-    const float intersectionYMax = std::min<float>(yMaxI, yMaxJ);
-    const float intersectionXMax = std::min<float>(xMaxI, xMaxJ);
-    const float intersectionArea = std::max<float>(intersectionYMax - intersectionYMin, 0.0) *
-                                   std::max<float>(intersectionXMax - intersectionXMin, 0.0);
-    return intersectionArea / (areaI + areaJ - intersectionArea);
+// The first candidates of this number get overlap rows, a bitmask of 2MB
+#define MAX_ROW_NUMBER 4096
+
+void NMSCandidates::Boxes::clear() {
+    size = 0;
+    ymin.clear();
+    xmin.clear();
+    ymax.clear();
+    xmax.clear();
+    area.clear();
 }
 
-void NonMaxSuppressionSingleClasssImpl(const Tensor* decodedBoxes, const float* scores, int maxDetections,
-                                       float iouThreshold, float scoreThreshold, std::vector<int32_t>* selected) {
-    MNN_ASSERT(iouThreshold >= 0.0f && iouThreshold <= 1.0f);
-    MNN_ASSERT(decodedBoxes->dimensions() == 2);
-    const int numBoxes = decodedBoxes->length(0);
-    MNN_ASSERT(decodedBoxes->length(1) == 4)
+void NMSCandidates::Boxes::push(const float* box) {
+    if (size % 4 == 0) {
+        ymin.resize(size + 4, 0.0f);
+        xmin.resize(size + 4, 0.0f);
+        ymax.resize(size + 4, 0.0f);
+        xmax.resize(size + 4, 0.0f);
+        area.resize(size + 4, 0.0f);
+    }
+    ymin[size] = std::min(box[0], box[2]);
+    xmin[size] = std::min(box[1], box[3]);
+    ymax[size] = std::max(box[0], box[2]);
+    xmax[size] = std::max(box[1], box[3]);
+    area[size] = (ymax[size] - ymin[size]) * (xmax[size] - xmin[size]);
+    size++;
+}
 
-    const int outputNum = std::min(maxDetections, numBoxes);
-    std::vector<float> scoresData(numBoxes);
-    std::copy_n(scores, numBoxes, scoresData.begin());
+// intersection - iouThreshold * union of a box against 4 boxes from offset, positive means iou > iouThreshold.
+// Empty boxes have no intersection, so they never overlap as the iou of them is defined as 0.
+static inline Vec4 _overlapExcess(const float* ymin, const float* xmin, const float* ymax, const float* xmax, const float* area,
+                                  int offset, const Vec4* box, float iouThreshold) {
+    auto zero  = Vec4(0.0f);
+    auto h     = Vec4::max(Vec4::min(box[2], Vec4::load(ymax + offset)) - Vec4::max(box[0], Vec4::load(ymin + offset)), zero);
+    auto w     = Vec4::max(Vec4::min(box[3], Vec4::load(xmax + offset)) - Vec4::max(box[1], Vec4::load(xmin + offset)), zero);
+    auto inter = h * w;
+    return inter - (box[4] + Vec4::load(area + offset) - inter) * iouThreshold;
+}
+
+void NMSCandidates::prepare(const float* boxes, const float* scores, int scoreStride, int numBoxes, float scoreThreshold) {
+    mBoxes = boxes;
+    mCandidates.clear();
+    mSorted    = 0;
+    mRowNumber = 0;
+    for (int i = 0; i < numBoxes; ++i) {
+        auto score = scores[i * scoreStride];
+        if (score > scoreThreshold) {
+            mCandidates.emplace_back(Candidate({score, i}));
+        }
+    }
+}
 
-    struct Candidate {
-        int boxIndex;
-        float score;
-    };
+// Most candidates are suppressed or never reached, so the order is only built as far as it is read
+void NMSCandidates::_sort(int end) {
+    if (end <= mSorted) {
+        return;
+    }
+    end = std::min(size(), std::max(std::max(end, 2 * mSorted), 64));
+    std::partial_sort(mCandidates.begin() + mSorted, mCandidates.begin() + end, mCandidates.end(),
+                      [](const Candidate& a, const Candidate& b) {
+                          return a.score > b.score || (a.score == b.score && a.index < b.index);
+                      });
+    mSorted = end;
+}
+
+bool NMSCandidates::preferBitmask(int maxDetections, int threadNumber) const {
+    int number = std::min(size(), MAX_ROW_NUMBER);
+    if (threadNumber <= 1 || number < 64) {
+        return false;
+    }
+    // Greedy compares each candidate with up to maxDetections kept boxes, the rows compare each pair once
+    return number / threadNumber < std::min(maxDetections, number);
+}
 
-    auto cmp = [](const Candidate bsI, const Candidate bsJ) { return bsI.score < bsJ.score; };
+int NMSCandidates::prepareRows(int maxDetections) {
+    int number = std::min(size(), MAX_ROW_NUMBER);
+    _sort(number);
+    mRowBoxes.clear();
+    for (int i = 0; i < number; ++i) {
+        mRowBoxes.push(mBoxes + 4 * mCandidates[i].index);
+    }
+    mRowWords  = UP_DIV(number, 64);
+    mRowNumber = number;
+    mRows.assign((size_t)number * mRowWords, 0);
+    return number;
+}
 
-    std::priority_queue<Candidate, std::deque<Candidate>, decltype(cmp)> candidatePriorityQueue(cmp);
+void NMSCandidates::computeRows(int start, int step, float iouThreshold) {
+    const auto& boxes = mRowBoxes;
+    float excess[4];
+    for (int i = start; i < mRowNumber; i += step) {
+        auto row = mRows.data() + (size_t)i * mRowWords;
+        Vec4 box[5] = {Vec4(boxes.ymin[i]), Vec4(boxes.xmin[i]), Vec4(boxes.ymax[i]), Vec4(boxes.xmax[i]), Vec4(boxes.area[i])};
+        for (int j = (i + 1) / 4 * 4; j < mRowNumber; j += 4) {
+            Vec4::save(excess, _overlapExcess(boxes.ymin.data(), boxes.xmin.data(), boxes.ymax.data(), boxes.xmax.data(),
+                                              boxes.area.data(), j, box, iouThreshold));
+            for (int l = 0; l < 4; ++l) {
+                int k = j + l;
+                if (k > i && k < mRowNumber && excess[l] > 0.0f) {
+                    row[k >> 6] |= (uint64_t)1 << (k & 63);
+                }
+            }
+        }
+    }
+}
 
-    for (int i = 0; i < scoresData.size(); ++i) {
-        if (scoresData[i] > scoreThreshold) {
-            candidatePriorityQueue.emplace(Candidate({i, scoresData[i]}));
+bool NMSCandidates::_overlap(const float* b, float iouThreshold) const {
+    if (mKept.size == 0) {
+        return false;
+    }
+    float ymin = std::min(b[0], b[2]), xmin = std::min(b[1], b[3]);
+    float ymax = std::max(b[0], b[2]), xmax = std::max(b[1], b[3]);
+    Vec4 box[5] = {Vec4(ymin), Vec4(xmin), Vec4(ymax), Vec4(xmax), Vec4((ymax - ymin) * (xmax - xmin))};
+    float excess[4];
+    // Overlapping boxes are likely to have similar scores,
+    // therefore we iterate through the previously selected boxes backwards
+    for (int j = (mKept.size - 1) / 4 * 4; j >= 0; j -= 4) {
+        Vec4::save(excess, _overlapExcess(mKept.ymin.data(), mKept.xmin.data(), mKept.ymax.data(), mKept.xmax.data(),
+                                          mKept.area.data(), j, box, iouThreshold));
+        if (excess[0] > 0.0f || excess[1] > 0.0f || excess[2] > 0.0f || excess[3] > 0.0f) {
+            return true;
         }
     }
+    return false;
+}
 
-    // std::vector<float> selectedScores;
-    Candidate nextCandidate;
-    float iou, originalScore;
-
-    const auto boxesPtr = decodedBoxes->host<float>();
-    while (selected->size() < outputNum && !candidatePriorityQueue.empty()) {
-        nextCandidate = candidatePriorityQueue.top();
-        originalScore = nextCandidate.score;
-        candidatePriorityQueue.pop();
-
-        // Overlapping boxes are likely to have similar scores,
-        // therefore we iterate through the previously selected boxes backwards
-        // in order to see if `next_candidate` should be suppressed.
-        bool shouldSelect = true;
-        for (int j = (int)selected->size() - 1; j >= 0; --j) {
-            iou = IOU(boxesPtr, nextCandidate.boxIndex, selected->at(j));
-            if (iou == 0.0) {
+void NMSCandidates::select(int maxDetections, float iouThreshold, std::vector<int>* selected) {
+    MNN_ASSERT(iouThreshold >= 0.0f && iouThreshold <= 1.0f);
+    mKept.clear();
+    int i = 0;
+    if (mRowNumber > 0) {
+        std::vector<uint64_t> removed(mRowWords, 0);
+        for (; i < mRowNumber && (int)selected->size() < maxDetections; ++i) {
+            if ((removed[i >> 6] >> (i & 63)) & 1) {
                 continue;
             }
-            if (iou > iouThreshold) {
-                shouldSelect = false;
+            auto index = mCandidates[i].index;
+            selected->push_back(index);
+            mKept.push(mBoxes + 4 * index);
+            auto row = mRows.data() + (size_t)i * mRowWords;
+            for (int w = i >> 6; w < mRowWords; ++w) {
+                removed[w] |= row[w];
             }
         }
-
-        if (shouldSelect) {
-            selected->push_back(nextCandidate.boxIndex);
-            // selectedScores.push_back(nextCandidate.score);
+        mRowNumber = 0;
+    }
+    for (; i < size() && (int)selected->size() < maxDetections; ++i) {
+        _sort(i + 1);
+        auto index = mCandidates[i].index;
+        auto box   = mBoxes + 4 * index;
+        if (!_overlap(box, iouThreshold)) {
+            selected->push_back(index);
+            mKept.push(box);
         }
     }
 }
 
+void NonMaxSuppressionSingleClasssImpl(const Tensor* decodedBoxes, const float* scores, int maxDetections,
+                                       float iouThreshold, float scoreThreshold, std::vector<int32_t>* selected) {
+    MNN_ASSERT(decodedBoxes->dimensions() == 2);
+    const int numBoxes = decodedBoxes->length(0);
+    MNN_ASSERT(decodedBoxes->length(1) == 4)
+    NMSCandidates candidates;
+    candidates.prepare(decodedBoxes->host<float>(), scores, 1, numBoxes, scoreThreshold);
+    candidates.select(maxDetections, iouThreshold, selected);
+}
+
 ErrorCode CPUNonMaxSuppressionV2::onExecute(const std::vector<Tensor*>& inputs, const std::vector<Tensor*>& outputs) {
     std::vector<int> selected;
     const int maxDetections    = inputs[2]->host<int32_t>()[0];
@@ -115,7 +206,16 @@ ErrorCode CPUNonMaxSuppressionV2::onExecute(const std::vector<Tensor*>& inputs,
         scoreThreshold = inputs[4]->host<float>()[0];
     }
     const auto scores          = inputs[1]->host<float>();
-    NonMaxSuppressionSingleClasssImpl(inputs[0], scores, maxDetections, iouThreshold, scoreThreshold, &selected);
+    mCandidates.prepare(inputs[0]->host<float>(), scores, 1, inputs[0]->length(0), scoreThreshold);
+    int threadNumber = static_cast<CPUBackend*>(backend())->threadNumber();
+    if (mCandidates.preferBitmask(maxDetections, threadNumber)) {
+        mCandidates.prepareRows(maxDetections);
+        MNN_CONCURRENCY_BEGIN(tId, threadNumber) {
+            mCandidates.computeRows((int)tId, threadNumber, iouThreshold);
+        }
+        MNN_CONCURRENCY_END();
+    }
+    mCandidates.select(maxDetections, iouThreshold, &selected);
     std::copy_n(selected.begin(), selected.size(), outputs[0]->host<int32_t>());
     for (int i = selected.size(); i < outputs[0]->elementSize(); i++) {
         outputs[0]->host<int32_t>()[i] = -1;
@@ -9,10 +9,65 @@
 #ifndef CPUNonMaxSuppressionV2_hpp
 #define CPUNonMaxSuppressionV2_hpp
 
+#include <vector>
 #include "core/Execution.hpp"
 
 namespace MNN {
 
+/**
+ * @brief Candidates of one class for greedy non max suppression. The boxes kept so far are stored as
+ * structure of arrays so that a candidate is compared against 4 of them at once.
+ * Usage: prepare, then optionally prepareRows and computeRows (may be split across threads), then select.
+ */
+class MNN_PUBLIC NMSCandidates {
+public:
+    /**
+     * @param boxes : float*, shape is [numBoxes, 4], where 4 represent [ymin, xmin, ymax, xmax] in any corner order
+     * @param scores : score of box i is scores[i * scoreStride], only the ones above scoreThreshold are kept
+     */
+    void prepare(const float* boxes, const float* scores, int scoreStride, int numBoxes, float scoreThreshold);
+    int size() const {
+        return (int)mCandidates.size();
+    }
+    /**
+     * @brief Whether the overlaps between the top candidates, computed on threadNumber threads, are cheaper
+     * than comparing every candidate against the kept boxes
+     */
+    bool preferBitmask(int maxDetections, int threadNumber) const;
+    // Sorts the top candidates for computeRows, returns the row number
+    int prepareRows(int maxDetections);
+    // Bit j of row i marks that candidate j overlaps the higher scored candidate i. Computes the rows
+    // start, start + step, ..., the later rows are shorter so interleaving balances the threads
+    void computeRows(int start, int step, float iouThreshold);
+    // Greedy selection, the candidates with computed rows are reduced by bitmask, the others compared one by one.
+    // The result is the same with or without rows.
+    void select(int maxDetections, float iouThreshold, std::vector<int>* selected);
+
+private:
+    struct Candidate {
+        float score;
+        int index;
+    };
+    // Corner normalized boxes padded with empty boxes to a multiple of 4
+    struct Boxes {
+        std::vector<float> ymin, xmin, ymax, xmax, area;
+        int size = 0;
+        void clear();
+        void push(const float* box);
+    };
+    void _sort(int end);
+    bool _overlap(const float* box, float iouThreshold) const;
+
+    const float* mBoxes = nullptr;
+    std::vector<Candidate> mCandidates;
+    int mSorted = 0;
+    Boxes mKept;
+    Boxes mRowBoxes;
+    std::vector<uint64_t> mRows;
+    int mRowNumber = 0;
+    int mRowWords = 0;
+};
+
 /**
  * @brief apply non_max_suppression, output the selected boxes index
  * @param decodedBoxes : Tensor, shape is [num_boxes, 4], where 4 represent [ymin, xmin, ymax, xmax]
@@ -30,6 +85,8 @@ public:
     CPUNonMaxSuppressionV2(Backend *backend, const Op *op);
     virtual ~CPUNonMaxSuppressionV2() = default;
     virtual ErrorCode onExecute(const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs) override;
+private:
+    NMSCandidates mCandidates;
 };
 
 } // namespace MNN
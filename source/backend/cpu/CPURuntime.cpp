@@ -163,7 +163,12 @@ cpu_mask_t MNNGetCPUMask(const std::vector<int>& cpuIds) {
     for (auto i :cpuIds){
         CPU_SET(i, &cpuMask);
     }
-    return cpuMask.__bits[0];
+    // The mask keys the thread pools, fold the higher words (e.g. the cpus of another socket) into it
+    cpu_mask_t high = 0;
+    for (int i = CPU_SETSIZE / __CPU_BITS - 1; i > 0; --i) {
+        high = (cpu_mask_t)((high ^ cpuMask.__bits[i]) * 0x9E3779B97F4A7C15ULL);
+    }
+    return cpuMask.__bits[0] ^ high;
 #endif
     return 0;
 }
@@ -1404,6 +1409,67 @@ static std::vector<int> _readNumber(const char* data, int length) {
     }
     return res;
 }
+// cpulist format of sysfs: "0-3,8-11"
+static std::vector<int> _readCpuList(const char* data, int length) {
+    std::vector<int> res;
+    int current = -1;
+    int rangeBegin = -1;
+    for (int i=0; i<=length; ++i) {
+        auto c = i < length ? data[i] : '\0';
+        if (c >= '0' && c <= '9') {
+            current = (current >= 0 ? current * 10 : 0) + (c - '0');
+            continue;
+        }
+        if (c == '-' && current >= 0) {
+            rangeBegin = current;
+            current = -1;
+            continue;
+        }
+        if (current >= 0) {
+            for (int v = rangeBegin >= 0 ? rangeBegin : current; v <= current; ++v) {
+                res.emplace_back(v);
+            }
+        }
+        current = -1;
+        rangeBegin = -1;
+    }
+    return res;
+}
+
+std::vector<MNNNumaNode> MNNReadNumaNodes(const char* sysRoot) {
+    std::vector<MNNNumaNode> nodes;
+#ifdef __linux__
+    std::string dir = std::string(sysRoot) + "/devices/system/node";
+    DIR* root = opendir(dir.c_str());
+    if (nullptr == root) {
+        return nodes;
+    }
+    struct dirent* ent;
+    while ((ent = readdir(root)) != NULL) {
+        if (strncmp(ent->d_name, "node", 4) != 0 || ent->d_name[4] < '0' || ent->d_name[4] > '9') {
+            continue;
+        }
+        MNNNumaNode node;
+        node.id = atoi(ent->d_name + 4);
+        MNN::AutoStorage<uint8_t> buffer;
+        if (_readAll(dir + "/" + ent->d_name + "/cpulist", buffer)) {
+            node.cpus = _readCpuList((const char*)buffer.get(), buffer.size());
+        }
+        nodes.emplace_back(std::move(node));
+    }
+    closedir(root);
+    std::sort(nodes.begin(), nodes.end(), [](const MNNNumaNode& left, const MNNNumaNode& right) {
+        return left.id < right.id;
+    });
+#endif
+    return nodes;
+}
+
+const std::vector<MNNNumaNode>& MNNGetNumaNodes() {
+    static std::vector<MNNNumaNode> gNodes = MNNReadNumaNodes("/sys");
+    return gNodes;
+}
+
 static MNNCPUInfo* gCPUInfo = nullptr;
 static void _fillInfo(MNNCPUInfo* cpuInfo);
 const MNNCPUInfo* MNNGetCPUInfo() {
@@ -26,10 +26,19 @@ struct MNNCPUInfo {
     int cpuNumber = 0;
     int smeCoreNumber = 0;
 };
+struct MNNNumaNode {
+    int id;
+    // May be empty for a memory only node
+    std::vector<int> cpus;
+};
 using cpu_mask_t = unsigned long;
 int MNNSetSchedAffinity(const int* cpuIDs, int size);
 int MNNGetCurrentPid();
 cpu_mask_t MNNGetCPUMask(const std::vector<int>& cpuIds);
 const MNNCPUInfo* MNNGetCPUInfo();
+// NUMA nodes under sysRoot/devices/system/node ("/sys" on a device), sorted by id, empty if not found
+MNN_PUBLIC std::vector<MNNNumaNode> MNNReadNumaNodes(const char* sysRoot);
+// NUMA nodes of this machine, read once
+MNN_PUBLIC const std::vector<MNNNumaNode>& MNNGetNumaNodes();
 
 #endif /* CPUInfo_hpp */
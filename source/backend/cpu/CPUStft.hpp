@@ -10,6 +10,7 @@
 #define CPUStft_hpp
 
 #include "core/Execution.hpp"
+#include "backend/cpu/compute/FFTFunction.hpp"
 
 namespace MNN {
 class CPUStft : public Execution {
@@ -20,6 +21,8 @@ public:
     virtual ErrorCode onExecute(const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs) override;
 private:
     bool mAbs;
+    std::shared_ptr<FFTPlan> mPlan;
+    std::shared_ptr<Tensor> mBuffer;
 };
 
 } // namespace MNN
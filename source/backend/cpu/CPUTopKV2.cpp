@@ -12,39 +12,163 @@
 #include "core/Concurrency.h"
 #include "backend/cpu/compute/CommonOptFunction.h"
 #include <algorithm>
+#include <functional>
+#include <math.h>
+#include <string.h>
 namespace MNN {
 
+// Order preserving keys: a larger value has a larger unsigned key
+static inline uint32_t _orderKey(float value) {
+    uint32_t bits;
+    ::memcpy(&bits, &value, sizeof(uint32_t));
+    // Negative values flip all bits, positive values only the sign bit
+    return bits ^ ((uint32_t)((int32_t)bits >> 31) | 0x80000000u);
+}
+static inline uint32_t _orderKey(int32_t value) {
+    return (uint32_t)value ^ 0x80000000u;
+}
+
+// Max keys sampled from a row to estimate the threshold
+static const int gTopKSampleSize = 1024;
+// A single row longer than this is split across the threads
+static const int gTopKSplitSize = 65536;
+
+// Candidates are packed as key << 32 | ~index, so the larger packed value is the larger key, then the smaller index
+template <typename T>
+static int _gatherCandidates(const T* data, int begin, int end, uint32_t flip, uint32_t lower, bool sparse, std::vector<uint64_t>& dst) {
+    if (sparse) {
+        // Most blocks have no candidate, test 8 keys at once and skip them without writing
+        dst.clear();
+        int i = begin;
+        for (; i + 8 <= end; i += 8) {
+            bool any = false;
+            for (int j = 0; j < 8; ++j) {
+                any |= (_orderKey(data[i + j]) ^ flip) >= lower;
+            }
+            if (!any) {
+                continue;
+            }
+            for (int j = 0; j < 8; ++j) {
+                uint32_t key = _orderKey(data[i + j]) ^ flip;
+                if (key >= lower) {
+                    dst.emplace_back(((uint64_t)key << 32) | (uint32_t)(~(uint32_t)(i + j)));
+                }
+            }
+        }
+        for (; i < end; ++i) {
+            uint32_t key = _orderKey(data[i]) ^ flip;
+            if (key >= lower) {
+                dst.emplace_back(((uint64_t)key << 32) | (uint32_t)(~(uint32_t)i));
+            }
+        }
+        return (int)dst.size();
+    }
+    if (dst.size() < end - begin) {
+        dst.resize(end - begin);
+    }
+    // Branchless compaction, the slot is overwritten unless the key reaches the threshold
+    auto dstPtr = dst.data();
+    int count = 0;
+    for (int i = begin; i < end; ++i) {
+        uint32_t key = _orderKey(data[i]) ^ flip;
+        dstPtr[count] = ((uint64_t)key << 32) | (uint32_t)(~(uint32_t)i);
+        count += key >= lower ? 1 : 0;
+    }
+    return count;
+}
+
+// Estimate from a strided sample a threshold reached by a few times k keys, filter the row with it
+// and sort the candidates. threadNumber > 1 splits the row across the threads, one scratch for each.
 template <typename T>
-void findTopK(int32_t rowSize, int32_t numRows, const T* data, int32_t k, int32_t* outputIndexes, T* outputValues, bool largest) {
-    struct DataType {
-        T value;
-        int index;
-    };
-    std::vector<DataType> cacheData(rowSize);
-    auto compareL = [](const DataType& A, const DataType& B) {
-        return A.value > B.value;
-    };
-    auto compareM = [](const DataType& A, const DataType& B) {
-        return A.value < B.value;
-    };
-    for (int row = 0; row < numRows; row++) {
-        const T* valuesRow = data + row * rowSize;
-        int32_t* indexesRow = outputIndexes + row * k;
-        T* outputRow         = outputValues + row * k;
-        for (int i=0; i<rowSize; ++i) {
-            cacheData[i].value = valuesRow[i];
-            cacheData[i].index = i;
+void CPUTopKV2::selectTopK(const T* data, int rowSize, int k, uint32_t flip, int threadNumber, Scratch* scratch, T* outputValues, int32_t* outputIndexes) {
+    uint32_t lower = 0;
+    bool sparse = false;
+    int sampleSize = ALIMIN(gTopKSampleSize, rowSize / 16);
+    if (sampleSize > 0) {
+        // Expected rank of the k-th key in the sample, plus a margin of three deviations
+        float rank = (float)k * (float)sampleSize / (float)rowSize;
+        int position = (int)(rank + 3.0f * sqrtf(rank) + 2.0f);
+        if (position < sampleSize) {
+            auto& sample = scratch[0].sample;
+            sample.resize(sampleSize);
+            int stride = rowSize / sampleSize;
+            for (int i = 0; i < sampleSize; ++i) {
+                sample[i] = _orderKey(data[i * stride]) ^ flip;
+            }
+            std::nth_element(sample.begin(), sample.begin() + position, sample.end(), std::greater<uint32_t>());
+            lower = sample[position];
+            sparse = position * 32 < sampleSize;
         }
-        if (largest) {
-            std::partial_sort(cacheData.begin(), cacheData.begin() + k, cacheData.end(), compareL);
+    }
+    const int segment = UP_DIV(rowSize, threadNumber);
+    int count = 0;
+    while (true) {
+        if (threadNumber > 1) {
+            std::vector<int> counts(threadNumber);
+            MNN_CONCURRENCY_BEGIN(tId, threadNumber) {
+                counts[tId] = _gatherCandidates(data, (int)tId * segment, ALIMIN(((int)tId + 1) * segment, rowSize), flip, lower, sparse, scratch[tId].candidates);
+            }
+            MNN_CONCURRENCY_END();
+            int total = 0;
+            for (auto c : counts) {
+                total += c;
+            }
+            if (scratch[0].candidates.size() < total) {
+                scratch[0].candidates.resize(total);
+            }
+            count = counts[0];
+            for (int t = 1; t < threadNumber; ++t) {
+                ::memcpy(scratch[0].candidates.data() + count, scratch[t].candidates.data(), counts[t] * sizeof(uint64_t));
+                count += counts[t];
+            }
         } else {
-            std::partial_sort(cacheData.begin(), cacheData.begin() + k, cacheData.end(), compareM);
+            count = _gatherCandidates(data, 0, rowSize, flip, lower, sparse, scratch[0].candidates);
+        }
+        if (count >= k || 0 == lower) {
+            break;
+        }
+        // The sample overestimated the threshold, take the whole row
+        lower = 0;
+        sparse = false;
+    }
+    auto begin = scratch[0].candidates.begin();
+    if (count < 4 * k) {
+        std::nth_element(begin, begin + k, begin + count, std::greater<uint64_t>());
+        std::sort(begin, begin + k, std::greater<uint64_t>());
+    } else {
+        // Few candidates replace the heap top when there are many more than k
+        std::partial_sort(begin, begin + k, begin + count, std::greater<uint64_t>());
+    }
+    for (int i = 0; i < k; ++i) {
+        int index = (int)(~(uint32_t)scratch[0].candidates[i]);
+        outputIndexes[i] = index;
+        outputValues[i]  = data[index];
+    }
+}
+
+template <typename T>
+void CPUTopKV2::findTopK(int32_t rowSize, int32_t numRows, const T* data, int32_t k, int32_t* outputIndexes, T* outputValues, int threadNumber) {
+    if (k <= 0 || numRows <= 0) {
+        return;
+    }
+    // The smallest values have the largest flipped keys
+    uint32_t flip = mLargest ? 0 : 0xFFFFFFFFu;
+    if (mScratch.size() < threadNumber) {
+        mScratch.resize(threadNumber);
+    }
+    if (numRows < threadNumber && rowSize >= gTopKSplitSize) {
+        for (int row = 0; row < numRows; row++) {
+            selectTopK(data + row * rowSize, rowSize, k, flip, threadNumber, mScratch.data(), outputValues + row * k, outputIndexes + row * k);
         }
-        for (int i=0; i<k; ++i) {
-            outputRow[i] = cacheData[i].value;
-            indexesRow[i] = cacheData[i].index;
+        return;
+    }
+    threadNumber = ALIMIN(threadNumber, numRows);
+    MNN_CONCURRENCY_BEGIN(tId, threadNumber) {
+        for (int row = (int)tId; row < numRows; row += threadNumber) {
+            selectTopK(data + row * rowSize, rowSize, k, flip, 1, mScratch.data() + tId, outputValues + row * k, outputIndexes + row * k);
         }
     }
+    MNN_CONCURRENCY_END();
 }
 
 CPUTopKV2::CPUTopKV2(Backend* b, const Op* op) : MNN::Execution(b) {
@@ -117,16 +241,17 @@ ErrorCode CPUTopKV2::onExecute(const std::vector<Tensor*>& inputs, const std::ve
         return NO_ERROR;
     }
 
+    auto threadNumber = static_cast<CPUBackend*>(backend())->threadNumber();
     if (halide_type_float == inputTensor->getType().code) {
         auto inputData   = inputTensor->host<float>();
         auto topkData    = outputData->host<float>();
         int* indicesData = outputIndices->host<int32_t>();
-        findTopK<float>(rowSize, numRows, inputData, k, indicesData, topkData, mLargest);
+        findTopK<float>(rowSize, numRows, inputData, k, indicesData, topkData, threadNumber);
     } else if(halide_type_int == inputTensor->getType().code && 32 == inputTensor->getType().bits) {
         auto inputData   = inputTensor->host<int32_t>();
         auto topkData    = outputData->host<int32_t>();
         int* indicesData = outputIndices->host<int32_t>();
-        findTopK<int32_t>(rowSize, numRows, inputData, k, indicesData, topkData, mLargest);
+        findTopK<int32_t>(rowSize, numRows, inputData, k, indicesData, topkData, threadNumber);
     } else {
         MNN_PRINT("TODO\n");
         MNN_ASSERT(false);
@@ -20,7 +20,17 @@ public:
     virtual ErrorCode onExecute(const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs) override;
 
 private:
+    // Buffers of the selection, one for each thread
+    struct Scratch {
+        std::vector<uint32_t> sample;
+        std::vector<uint64_t> candidates;
+    };
+    template <typename T>
+    void findTopK(int32_t rowSize, int32_t numRows, const T* data, int32_t k, int32_t* outputIndexes, T* outputValues, int threadNumber);
+    template <typename T>
+    void selectTopK(const T* data, int rowSize, int k, uint32_t flip, int threadNumber, Scratch* scratch, T* outputValues, int32_t* outputIndexes);
     bool mLargest = true;
+    std::vector<Scratch> mScratch;
 };
 } // namespace MNN
 
@@ -8,11 +8,17 @@
 #ifdef MNN_USE_THREAD_POOL
 #include "backend/cpu/ThreadPool.hpp"
 #include <string.h>
+#include <chrono>
+#include <algorithm>
 #include <unordered_map>
 #include <MNN/MNNDefine.h>
 #include "ThreadPool.hpp"
+#include "core/Macro.h"
+#include "core/TraceRecorder.hpp"
 
-#define MNN_THREAD_POOL_MAX_TASKS 2
+// Number of yields before an idle thread parks
+#define MNN_THREAD_POOL_SPIN_MAX 4096
+#define MNN_THREAD_POOL_SPIN_MIN 64
 namespace MNN {
 static std::unordered_map<long int, ThreadPool*> gInstances;
 static std::mutex gInitMutex;
@@ -42,32 +48,87 @@ void ThreadPool::destroy() {
     gInstances.clear();
 }
 
+static inline int64_t _nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline uint64_t _packRange(int begin, int end) {
+    return ((uint64_t)(uint32_t)begin << 32) | (uint32_t)end;
+}
+
+// Take the first index of a range, only called by the thread owning it
+static inline bool _popFront(std::atomic<uint64_t>& range, int& index) {
+    auto value = range.load();
+    while (true) {
+        int begin = (int)(value >> 32);
+        int end   = (int)(value & 0xffffffff);
+        if (begin >= end) {
+            return false;
+        }
+        if (range.compare_exchange_weak(value, _packRange(begin + 1, end))) {
+            index = begin;
+            return true;
+        }
+    }
+}
+
+// Take the back half of a range owned by another thread
+static inline bool _stealBack(std::atomic<uint64_t>& range, int& stealBegin, int& stealEnd) {
+    auto value = range.load();
+    while (true) {
+        int begin = (int)(value >> 32);
+        int end   = (int)(value & 0xffffffff);
+        if (begin >= end) {
+            return false;
+        }
+        int middle = end - ALIMAX((end - begin) / 2, 1);
+        if (range.compare_exchange_weak(value, _packRange(begin, middle))) {
+            stealBegin = middle;
+            stealEnd   = end;
+            return true;
+        }
+    }
+}
+
 ThreadPool::ThreadPool(int numberThread) {
     mNumberThread = numberThread;
     mActiveCount  = 0;
-    mTaskAvailable.resize(MNN_THREAD_POOL_MAX_TASKS);
-    mTasks.resize(MNN_THREAD_POOL_MAX_TASKS);
-    for (int t = 0; t < mTasks.size(); ++t) {
-        mTaskAvailable[t] = true;
-        for (int i = 0; i < mNumberThread; ++i) {
-            mTasks[t].second.emplace_back(new std::atomic_bool{false});
-        }
-    }
     for (int i = 1; i < mNumberThread; ++i) {
         int threadIndex = i;
         mWorkers.emplace_back([this, threadIndex]() {
+            // Spin limit adapts to the gap between parallel regions: doubled when new work
+            // arrives while spinning, halved when the worker has to park
+            int spinLimit = MNN_THREAD_POOL_SPIN_MAX;
+            int spin = 0;
             while (!mStop) {
-                while (mActiveCount > 0) {
-                    for (int i = 0; i < MNN_THREAD_POOL_MAX_TASKS; ++i) {
-                        if (*mTasks[i].second[threadIndex]) {
-                            mTasks[i].first->first(threadIndex);
-                            { *mTasks[i].second[threadIndex] = false; }
-                        }
+                int epoch = mEpoch;
+                bool executed = false;
+                if (mRunningCount > 0) {
+                    int rangeIndex = 0;
+                    auto work = joinWork(threadIndex, rangeIndex);
+                    if (nullptr != work) {
+                        executed = runWork(work, rangeIndex);
+                        work->users--;
                     }
+                }
+                if (executed) {
+                    if (spin > 0) {
+                        spinLimit = ALIMIN(spinLimit * 2, MNN_THREAD_POOL_SPIN_MAX);
+                    }
+                    spin = 0;
+                    continue;
+                }
+                if (spin < spinLimit) {
+                    spin++;
                     std::this_thread::yield();
+                    continue;
                 }
+                spin = 0;
+                spinLimit = ALIMAX(spinLimit / 2, MNN_THREAD_POOL_SPIN_MIN);
                 std::unique_lock<std::mutex> _l(mQueueMutex);
-                mCondition.wait(_l, [this] { return mStop || mActiveCount > 0; });
+                mSleeping++;
+                mCondition.wait(_l, [this, epoch] { return mStop || mEpoch != epoch; });
+                mSleeping--;
             }
         });
     }
@@ -82,43 +143,60 @@ ThreadPool::~ThreadPool() {
     for (auto& worker : mWorkers) {
         worker.join();
     }
-    for (auto& task : mTasks) {
-        for (auto c : task.second) {
-            delete c;
-        }
-    }
 }
 
 int ThreadPool::acquireWorkIndex() {
-    std::lock_guard<std::mutex> _l(mQueueMutex);
-    for (int i = 0; i < MNN_THREAD_POOL_MAX_TASKS; ++i) {
-        if (mTaskAvailable[i]) {
-            mTaskAvailable[i] = false;
-            return i;
+    std::lock_guard<std::mutex> _l(mWorkMutex);
+    int index = 0;
+    for (; index < mTaskAvailable.size(); ++index) {
+        if (mTaskAvailable[index]) {
+            break;
         }
     }
-    return -1;
+    if (index == mTaskAvailable.size()) {
+        mTaskAvailable.push_back(true);
+        mTasks.emplace_back(new Work(mNumberThread));
+    }
+    mTaskAvailable[index] = false;
+    auto work = mTasks[index].get();
+    work->priority = 0;
+    work->coreBudget = 0;
+    work->stats = Stats();
+    return index;
 }
 void ThreadPool::releaseWorkIndex(int index) {
-    if (index < 0 || index >= MNN_THREAD_POOL_MAX_TASKS) {
+    std::lock_guard<std::mutex> _l(mWorkMutex);
+    if (index < 0 || index >= mTaskAvailable.size()) {
         return;
     }
-    std::lock_guard<std::mutex> _l(mQueueMutex);
     mTaskAvailable[index] = true;
 }
 
-void ThreadPool::active() {
-    {
-        std::lock_guard<std::mutex> _l(mQueueMutex);
-        mActiveCount++;
+void ThreadPool::setWorkConfig(int index, int priority, int coreBudget) {
+    std::lock_guard<std::mutex> _l(mWorkMutex);
+    if (index < 0 || index >= mTasks.size()) {
+        return;
     }
-    mCondition.notify_all();
+    mTasks[index]->priority = priority;
+    mTasks[index]->coreBudget = ALIMAX(coreBudget, 0);
+}
+
+ThreadPool::Stats ThreadPool::getWorkStats(int index) {
+    std::lock_guard<std::mutex> _l(mWorkMutex);
+    if (index < 0 || index >= mTasks.size()) {
+        return Stats();
+    }
+    return mTasks[index]->stats;
+}
+
+void ThreadPool::active() {
+    mActiveCount++;
 }
 void ThreadPool::deactive() {
     mActiveCount--;
 }
 
-void ThreadPool::enqueue(TASK* taskp, int index) {
+void ThreadPool::enqueue(TASK* taskp, int index, bool bindThread) {
     auto& task = *taskp;
     if (1 >= task.second || 0 > index) {
         for (int i = 0; i < task.second; ++i) {
@@ -126,50 +204,195 @@ void ThreadPool::enqueue(TASK* taskp, int index) {
         }
         return;
     }
-    enqueueInternal(taskp, index);
+    enqueueInternal(taskp, index, bindThread);
+}
+
+void ThreadPool::execute(Work* work, int index) {
+    work->task->first(index);
+    if (1 == work->remain.fetch_sub(1) && work->waiting) {
+        std::lock_guard<std::mutex> _l(work->mutex);
+        work->finished.notify_one();
+    }
+}
+
+ThreadPool::Work* ThreadPool::joinWork(int threadIndex, int& rangeIndex) {
+    // Don't block the enqueuing threads, an idle worker just retries
+    std::unique_lock<std::mutex> _l(mWorkMutex, std::try_to_lock);
+    if (!_l.owns_lock()) {
+        return nullptr;
+    }
+    Work* best = nullptr;
+    for (auto work : mRunning) {
+        if (work->bindThread) {
+            auto value = work->ranges[threadIndex].value.load();
+            if ((int)(value >> 32) < (int)(value & 0xffffffff)) {
+                best = work;
+                break;
+            }
+            continue;
+        }
+        if (work->coreBudget > 0 && work->users >= work->coreBudget) {
+            continue;
+        }
+        if (nullptr != best && (work->priority < best->priority || (work->priority == best->priority && work->users >= best->users))) {
+            continue;
+        }
+        bool hasIndex = false;
+        for (int i = 0; i < work->parts && !hasIndex; ++i) {
+            auto value = work->ranges[i].value.load();
+            hasIndex = (int)(value >> 32) < (int)(value & 0xffffffff);
+        }
+        if (hasIndex) {
+            best = work;
+        }
+    }
+    if (nullptr == best) {
+        return nullptr;
+    }
+    if (best->bindThread) {
+        rangeIndex = threadIndex;
+    } else {
+        // Every range has one owner, threads joining after all ranges are handed out only steal
+        rangeIndex = best->joined.fetch_add(1);
+        if (rangeIndex >= best->parts) {
+            rangeIndex = -1;
+        }
+    }
+    if (1 == best->users.fetch_add(1) && 0 == best->firstJoinUs) {
+        best->firstJoinUs = _nowUs();
+    }
+    return best;
+}
+
+bool ThreadPool::runWork(Work* work, int rangeIndex) {
+    bool executed = false;
+    bool hasOwn = rangeIndex >= 0;
+    int index = 0;
+    while (true) {
+        if (hasOwn) {
+            auto& own = work->ranges[rangeIndex].value;
+            while (_popFront(own, index)) {
+                execute(work, index);
+                executed = true;
+            }
+        }
+        if (work->bindThread) {
+            break;
+        }
+        bool stolen = false;
+        for (int i = hasOwn ? 1 : 0; i < work->parts && !stolen; ++i) {
+            int begin, end;
+            auto& victim = work->ranges[(ALIMAX(rangeIndex, 0) + i) % work->parts].value;
+            if (_stealBack(victim, begin, end)) {
+                if (hasOwn) {
+                    // Own range is empty, publish the rest of the stolen part so it can be stolen again
+                    if (end - begin > 1) {
+                        work->ranges[rangeIndex].value.store(_packRange(begin + 1, end));
+                    }
+                    execute(work, begin);
+                } else {
+                    // No range to publish into, run the stolen part here
+                    for (int j = begin; j < end; ++j) {
+                        execute(work, j);
+                    }
+                }
+                executed = true;
+                stolen = true;
+            }
+        }
+        if (!stolen) {
+            break;
+        }
+    }
+    return executed;
 }
-void ThreadPool::enqueueInternal(TASK* taskp, int index) {
+
+void ThreadPool::enqueueInternal(TASK* taskp, int index, bool bindThread) {
     auto& task = *taskp;
-    if (mActiveCount == 0) {
-        for (int i = 0; i < task.second; ++i) {
+    int workSize = task.second;
+    Work* work = nullptr;
+    int parts = bindThread ? mNumberThread : ALIMIN(workSize, mNumberThread);
+    if (mActiveCount > 0) {
+        std::lock_guard<std::mutex> _l(mWorkMutex);
+        if (index < mTasks.size()) {
+            work = mTasks[index].get();
+            if (!bindThread && work->coreBudget > 0) {
+                parts = ALIMIN(parts, work->coreBudget);
+            }
+        }
+    }
+    if (nullptr == work || parts <= 1) {
+        for (int i = 0; i < workSize; ++i) {
             task.first(i);
         }
         return;
     }
-    int workSize = task.second;
-    TASK* tmpTask = nullptr;
-    if (workSize > mNumberThread) {
-        tmpTask = new TASK;
-        *tmpTask = std::make_pair([workSize, &task, this](int tId) {
-            for (int v = tId; v < workSize; v += mNumberThread) {
-                task.first(v);
-            }
-        }, mNumberThread);
-        mTasks[index].first = tmpTask;
-        workSize = mNumberThread;
-    } else {
-        mTasks[index].first = taskp;
+    work->task = taskp;
+    work->bindThread = bindThread;
+    work->parts = parts;
+    work->remain = workSize;
+    work->users = 1;
+    work->joined = 1;
+    // Contiguous ranges, index i is on range i when workSize <= parts
+    int unit = workSize / parts;
+    int extra = workSize % parts;
+    int begin = 0;
+    for (int i = 0; i < parts; ++i) {
+        int size = unit + (i < extra ? 1 : 0);
+        work->ranges[i].value.store(_packRange(begin, begin + size));
+        begin += size;
     }
+    auto ring = TraceRecorder::current();
+    uint64_t traceBeginNs = nullptr != ring ? TraceRecorder::now() : 0;
+    work->startUs = _nowUs();
+    work->firstJoinUs = 0;
     {
-        for (int i = 1; i < workSize; ++i) {
-            *mTasks[index].second[i] = true;
-        }
+        std::lock_guard<std::mutex> _l(mWorkMutex);
+        work->running = true;
+        mRunning.emplace_back(work);
+        mRunningCount++;
     }
-    mTasks[index].first->first(0);
-    bool complete = true;
-    do {
-        complete = true;
-        for (int i = 1; i < workSize; ++i) {
-            if (*mTasks[index].second[i]) {
-                complete = false;
-                break;
-            }
+    mEpoch++;
+    if (mSleeping > 0) {
+        std::lock_guard<std::mutex> _l(mQueueMutex);
+        mCondition.notify_all();
+    }
+    runWork(work, 0);
+    // Spin shortly for the other threads to finish their indices, then park
+    for (int i = 0; work->remain > 0 && i < MNN_THREAD_POOL_SPIN_MAX; ++i) {
+        std::this_thread::yield();
+    }
+    if (work->remain > 0) {
+        std::unique_lock<std::mutex> _l(work->mutex);
+        work->waiting = true;
+        work->finished.wait(_l, [work] { return work->remain <= 0; });
+        work->waiting = false;
+    }
+    auto endUs = _nowUs();
+    {
+        std::lock_guard<std::mutex> _l(mWorkMutex);
+        work->running = false;
+        mRunning.erase(std::find(mRunning.begin(), mRunning.end(), work));
+        mRunningCount--;
+        auto& stats = work->stats;
+        int64_t delay = endUs - work->startUs;
+        if (0 != work->firstJoinUs) {
+            delay = work->firstJoinUs - work->startUs;
+        } else {
+            stats.unhelped++;
         }
+        stats.regions++;
+        stats.queueDelayUs += delay;
+        stats.maxQueueDelayUs = ALIMAX(stats.maxQueueDelayUs, delay);
+    }
+    if (nullptr != ring) {
+        TraceRecorder::record(ring, TraceRecorder::PARALLEL, traceBeginNs, TraceRecorder::now(),
+                              (0 != work->firstJoinUs ? work->firstJoinUs - work->startUs : endUs - work->startUs) * 1000,
+                              (float)parts, nullptr, nullptr);
+    }
+    // Threads still leaving the region only find empty ranges, wait them before reusing the work
+    while (work->users > 1) {
         std::this_thread::yield();
-        // FUNC_PRINT(notComplete);
-    } while (!complete);
-    if (nullptr != tmpTask) {
-        delete tmpTask;
     }
 }
 } // namespace MNN
@@ -15,6 +15,7 @@
 #include <thread>
 #include <vector>
 #include <atomic>
+#include <memory>
 #include <MNN/MNNDefine.h>
 namespace MNN {
 
@@ -22,33 +23,92 @@ class MNN_PUBLIC ThreadPool {
 public:
     typedef std::pair<std::function<void(int)>, int> TASK;
 
+    // Queueing statistics of a work index since it was acquired
+    struct Stats {
+        // parallel regions run by the pool
+        int64_t regions = 0;
+        // regions finished before any other thread joined them
+        int64_t unhelped = 0;
+        // time between enqueue and the first other thread joining, the whole region if none joined
+        int64_t queueDelayUs = 0;
+        int64_t maxQueueDelayUs = 0;
+    };
+
     int numberThread() const {
         return mNumberThread;
     }
-    void enqueue(TASK* task, int index);
+    // Run task.first(i) for i in [0, task.second). Indices are balanced between threads by work stealing,
+    // bindThread keeps index i on thread i when task.second equals numberThread(), eg: for cpu affinity
+    void enqueue(TASK* task, int index, bool bindThread = false);
 
     void active();
     void deactive();
 
+    // Every session holds its own work index, the pool shares its threads between all of them
     int acquireWorkIndex();
     void releaseWorkIndex(int index);
+    // Idle threads join the running region of the highest priority first, then the one with fewest threads.
+    // coreBudget limits the threads (including the caller) running one region of the index, 0 means no limit
+    void setWorkConfig(int index, int priority, int coreBudget);
+    Stats getWorkStats(int index);
 
     static int init(int numberThread, unsigned long cpuMask, ThreadPool*& threadPool);
     static void destroy();
 
 private:
-    void enqueueInternal(TASK* task, int index);
+    // A parallel region. Its indices are split into one contiguous range per participant, packed as
+    // begin << 32 | end. Each thread takes indices from the front of its own range, and once that
+    // is empty steals the back half of the range of another thread.
+    struct Range {
+        std::atomic<uint64_t> value = {0};
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+    struct Work {
+        Work(int numberThread) : ranges(numberThread) {
+        }
+        TASK* task = nullptr;
+        bool bindThread = false;
+        int parts = 0;
+        std::vector<Range> ranges;
+        std::atomic_int remain = {0};
+        // threads in the region including the caller, and the next range to hand out
+        std::atomic_int users = {0};
+        std::atomic_int joined = {0};
+        bool running = false;
+        // the enqueuing thread parks here after spinning
+        std::atomic_bool waiting = {false};
+        std::mutex mutex;
+        std::condition_variable finished;
+
+        int priority = 0;
+        int coreBudget = 0;
+        int64_t startUs = 0;
+        int64_t firstJoinUs = 0;
+        Stats stats;
+    };
+    void enqueueInternal(TASK* task, int index, bool bindThread);
+    Work* joinWork(int threadIndex, int& rangeIndex);
+    bool runWork(Work* work, int rangeIndex);
+    void execute(Work* work, int index);
 
     ThreadPool(int numberThread = 0);
     ~ThreadPool();
 
     std::vector<std::thread> mWorkers;
-    std::vector<bool> mTaskAvailable;
     std::atomic<bool> mStop = {false};
 
-    std::vector<std::pair<TASK*, std::vector<std::atomic_bool*>>> mTasks;
+    // Work slots and the running regions, guarded by mWorkMutex
+    std::vector<std::unique_ptr<Work>> mTasks;
+    std::vector<bool> mTaskAvailable;
+    std::vector<Work*> mRunning;
+    std::mutex mWorkMutex;
+    std::atomic_int mRunningCount = {0};
+
+    // idle workers spin for a while, then park until mEpoch changes
     std::condition_variable mCondition;
     std::mutex mQueueMutex;
+    std::atomic_int mEpoch    = {0};
+    std::atomic_int mSleeping = {0};
 
     int mNumberThread            = 0;
     std::atomic_int mActiveCount = {0};
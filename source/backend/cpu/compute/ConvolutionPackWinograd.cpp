@@ -93,11 +93,14 @@ ConvolutionPackWinograd::ConvolutionPackWinograd(const Convolution2DCommon *conv
     if (!mValid) {
         return;
     }
-    generator.transformWeight(tempWeight.get(), sourceWeight.get(), true);
-    if (weightBytes != 4) {
-        core->MNNFp32ToLowp(tempWeight->host<float>(), mResource->mWeight->host<int16_t>(), tempWeight->elementSize());
-    } else {
-        ::memcpy(mResource->mWeight->host<float>(), tempWeight->host<float>(), tempWeight->size());
+    // Transformed weight is loaded from the cache file
+    if (b->getRuntime()->hint().useCachedMmap <= 1) {
+        generator.transformWeight(tempWeight.get(), sourceWeight.get(), true);
+        if (weightBytes != 4) {
+            core->MNNFp32ToLowp(tempWeight->host<float>(), mResource->mWeight->host<int16_t>(), tempWeight->elementSize());
+        } else {
+            ::memcpy(mResource->mWeight->host<float>(), tempWeight->host<float>(), tempWeight->size());
+        }
     }
 
     mPostParameters = getPostParameters();
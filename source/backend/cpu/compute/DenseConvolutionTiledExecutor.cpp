@@ -52,7 +52,9 @@ bool DenseConvolutionTiledExecutor::initQuantizeResource(std::shared_ptr<Convolu
     int originOffset = 0;
     auto srcWInt8 = int8Info->weight.get();
     std::vector<int8_t> blob;
-    if (int8Info->canUseInt4) {
+    // Packed weight is loaded from the cache file
+    bool useCachedMmap = resource->backend->getRuntime()->hint().useCachedMmap > 1;
+    if (int8Info->canUseInt4 && !useCachedMmap) {
         // Revert int4 to int8
         auto size = int8Info->weight.size();
         blob.resize(int8Info->weight.size() * 2);
@@ -73,6 +75,9 @@ bool DenseConvolutionTiledExecutor::initQuantizeResource(std::shared_ptr<Convolu
         if (!res) {
             return false;
         }
+        if (useCachedMmap) {
+            return true;
+        }
         // Reorder weight for int8
         auto dstWInt8 = resource->mWeight->host<int8_t>();
         ::memset(dstWInt8, 0, resource->mWeight->usize());
@@ -200,7 +205,10 @@ DenseConvolutionTiledExecutor::DenseConvolutionTiledExecutor(const Convolution2D
         if (!mValid) {
             return;
         }
-        initWeight(mResource->mWeight->host<float>(), originWeight, cache->host<float>(), srcCount, outputCount, common->kernelX() * common->kernelY(), core);
+        // Packed weight is loaded from the cache file, keep the allocations the same as when it was written
+        if (b->getRuntime()->hint().useCachedMmap <= 1) {
+            initWeight(mResource->mWeight->host<float>(), originWeight, cache->host<float>(), srcCount, outputCount, common->kernelX() * common->kernelY(), core);
+        }
         // MNN_PRINT("srcCount:%d, outputCount:%d, dense weight matrix tile:", srcCount, outputCount);
         // formatMatrix(mResource->mWeight->host<float>(), {UP_DIV(outputCount, hP), lSize, hP});
         backend()->onReleaseBuffer(cache.get(), Backend::STATIC);
@@ -0,0 +1,403 @@
+//
+//  FFTFunction.cpp
+//  MNN
+//
+//  Created by MNN on 2026/10/16.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#include "backend/cpu/compute/FFTFunction.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "core/Macro.h"
+#include "math/Vec.hpp"
+
+using Vec4 = MNN::Math::Vec<float, 4>;
+// Prime factors above it are cheaper as a power-of-two convolution than as a direct butterfly
+#define MAX_DIRECT_RADIX 64
+
+namespace MNN {
+
+static inline void _twiddle(double angle, float* dst) {
+    dst[0] = (float)cos(angle);
+    dst[1] = (float)-sin(angle);
+}
+
+static inline void _multiply(Vec4& r, Vec4& i, float c, float s) {
+    auto t = r * c - i * s;
+    i = r * s + i * c;
+    r = t;
+}
+
+struct Radix2 {
+    static inline void run(Vec4* r, Vec4* i, int, const float*) {
+        auto r1 = r[0] - r[1];
+        auto i1 = i[0] - i[1];
+        r[0] = r[0] + r[1];
+        i[0] = i[0] + i[1];
+        r[1] = r1;
+        i[1] = i1;
+    }
+};
+
+struct Radix3 {
+    static inline void run(Vec4* r, Vec4* i, int, const float*) {
+        const float s = 0.86602540378443864676f;
+        auto tr = r[1] + r[2];
+        auto ti = i[1] + i[2];
+        auto dr = (r[1] - r[2]) * s;
+        auto di = (i[1] - i[2]) * s;
+        auto mr = r[0] - tr * 0.5f;
+        auto mi = i[0] - ti * 0.5f;
+        r[0] = r[0] + tr;
+        i[0] = i[0] + ti;
+        r[1] = mr + di;
+        i[1] = mi - dr;
+        r[2] = mr - di;
+        i[2] = mi + dr;
+    }
+};
+
+struct Radix4 {
+    static inline void run(Vec4* r, Vec4* i, int, const float*) {
+        auto r0 = r[0] + r[2];
+        auto i0 = i[0] + i[2];
+        auto r1 = r[0] - r[2];
+        auto i1 = i[0] - i[2];
+        auto r2 = r[1] + r[3];
+        auto i2 = i[1] + i[3];
+        auto r3 = r[1] - r[3];
+        auto i3 = i[1] - i[3];
+        r[0] = r0 + r2;
+        i[0] = i0 + i2;
+        r[2] = r0 - r2;
+        i[2] = i0 - i2;
+        r[1] = r1 + i3;
+        i[1] = i1 - r3;
+        r[3] = r1 - i3;
+        i[3] = i1 + r3;
+    }
+};
+
+struct Radix5 {
+    static inline void run(Vec4* r, Vec4* i, int, const float*) {
+        const float c1 = 0.30901699437494742410f;
+        const float c2 = -0.80901699437494742410f;
+        const float s1 = 0.95105651629515357212f;
+        const float s2 = 0.58778525229247312917f;
+        auto ar = r[1] + r[4];
+        auto ai = i[1] + i[4];
+        auto br = r[2] + r[3];
+        auto bi = i[2] + i[3];
+        auto dr = r[1] - r[4];
+        auto di = i[1] - i[4];
+        auto er = r[2] - r[3];
+        auto ei = i[2] - i[3];
+        auto m1r = r[0] + ar * c1 + br * c2;
+        auto m1i = i[0] + ai * c1 + bi * c2;
+        auto m2r = r[0] + ar * c2 + br * c1;
+        auto m2i = i[0] + ai * c2 + bi * c1;
+        auto n1r = dr * s1 + er * s2;
+        auto n1i = di * s1 + ei * s2;
+        auto n2r = dr * s2 - er * s1;
+        auto n2i = di * s2 - ei * s1;
+        r[0] = r[0] + ar + br;
+        i[0] = i[0] + ai + bi;
+        r[1] = m1r + n1i;
+        i[1] = m1i - n1r;
+        r[4] = m1r - n1i;
+        i[4] = m1i + n1r;
+        r[2] = m2r + n2i;
+        i[2] = m2i - n2r;
+        r[3] = m2r - n2i;
+        i[3] = m2i + n2r;
+    }
+};
+
+// Direct dft of a prime radix, roots holds the radix-th roots of unity
+struct RadixAny {
+    static inline void run(Vec4* r, Vec4* i, int radix, const float* roots) {
+        Vec4 sr[MAX_DIRECT_RADIX], si[MAX_DIRECT_RADIX];
+        for (int k = 0; k < radix; ++k) {
+            sr[k] = r[0];
+            si[k] = i[0];
+            int index = 0;
+            for (int j = 1; j < radix; ++j) {
+                index += k;
+                if (index >= radix) {
+                    index -= radix;
+                }
+                auto c = roots[2 * index];
+                auto s = roots[2 * index + 1];
+                sr[k] = sr[k] + r[j] * c - i[j] * s;
+                si[k] = si[k] + r[j] * s + i[j] * c;
+            }
+        }
+        for (int k = 0; k < radix; ++k) {
+            r[k] = sr[k];
+            i[k] = si[k];
+        }
+    }
+};
+
+// Stockham step: the dfts of stride interleaved sequences of the given length are split into radix sequences
+// of length / radix, reading x[j + stride * (q + r * m)] and writing y[j + stride * (q * radix + k)]
+template <typename Butterfly>
+static void _radixStage(int radix, int length, int stride, const float* twiddle, const float* src, float* dst) {
+    Vec4 r[MAX_DIRECT_RADIX], i[MAX_DIRECT_RADIX];
+    const int m = length / radix;
+    const float* roots = twiddle + m * radix * 2;
+    for (int q = 0; q < m; ++q) {
+        auto w = twiddle + q * radix * 2;
+        for (int j = 0; j < stride; ++j) {
+            for (int k = 0; k < radix; ++k) {
+                auto s = src + (j + stride * (q + k * m)) * 8;
+                r[k] = Vec4::load(s);
+                i[k] = Vec4::load(s + 4);
+            }
+            Butterfly::run(r, i, radix, roots);
+            if (q > 0) {
+                for (int k = 1; k < radix; ++k) {
+                    _multiply(r[k], i[k], w[2 * k], w[2 * k + 1]);
+                }
+            }
+            for (int k = 0; k < radix; ++k) {
+                auto d = dst + (j + stride * (q * radix + k)) * 8;
+                Vec4::save(d, r[k]);
+                Vec4::save(d + 4, i[k]);
+            }
+        }
+    }
+}
+
+FFTPlan::FFTPlan(int length, bool realInput) : mLength(length), mReal(realInput) {
+    const double pi = 3.14159265358979323846;
+    if (realInput && length >= 2 && length % 2 == 0) {
+        // x[2j] + i * x[2j + 1] is transformed, then split into the spectrum of the even and odd samples
+        int half = length / 2;
+        mHalf.reset(new FFTPlan(half, false));
+        mSplit.resize((half + 1) * 2);
+        for (int k = 0; k <= half; ++k) {
+            _twiddle(2.0 * pi * k / length, mSplit.data() + 2 * k);
+        }
+        mBufferSize = std::max(mHalf->bufferSize(), (half + 1) * 8);
+        return;
+    }
+    std::vector<int> factors;
+    int rest = length;
+    while (rest % 4 == 0) {
+        factors.emplace_back(4);
+        rest /= 4;
+    }
+    if (rest % 2 == 0) {
+        factors.emplace_back(2);
+        rest /= 2;
+    }
+    for (int p = 3; p * p <= rest; p += 2) {
+        while (rest % p == 0) {
+            factors.emplace_back(p);
+            rest /= p;
+        }
+    }
+    if (rest > 1) {
+        factors.emplace_back(rest);
+    }
+    if (rest > MAX_DIRECT_RADIX) {
+        // Bluestein: X[k] = chirp[k] * sum_n (x[n] * chirp[n]) * conj(chirp[k - n]), chirp[n] = exp(-i * pi * n^2 / N)
+        int size = 1;
+        while (size < 2 * length - 1) {
+            size *= 2;
+        }
+        mConvolution.reset(new FFTPlan(size, false));
+        mBufferSize = mConvolution->bufferSize();
+        mChirp.resize(length * 2);
+        for (int k = 0; k < length; ++k) {
+            auto square = ((long long)k * k) % (2LL * length);
+            _twiddle(pi * square / length, mChirp.data() + 2 * k);
+        }
+        // The kernel is transformed once, divided by size for the inverse transform of the product
+        std::vector<float> data(mBufferSize, 0.0f), scratch(mBufferSize);
+        for (int k = 0; k < length; ++k) {
+            auto c = mChirp[2 * k] / size;
+            auto s = -mChirp[2 * k + 1] / size;
+            Vec4::save(data.data() + k * 8, Vec4(c));
+            Vec4::save(data.data() + k * 8 + 4, Vec4(s));
+            if (k > 0) {
+                Vec4::save(data.data() + (size - k) * 8, Vec4(c));
+                Vec4::save(data.data() + (size - k) * 8 + 4, Vec4(s));
+            }
+        }
+        auto result = mConvolution->execute(data.data(), scratch.data());
+        mKernel.resize(size * 2);
+        for (int k = 0; k < size; ++k) {
+            mKernel[2 * k]     = result[k * 8];
+            mKernel[2 * k + 1] = result[k * 8 + 4];
+        }
+        return;
+    }
+    mBufferSize = std::max(length, 1) * 8;
+    int stride = 1;
+    int current = length;
+    for (auto radix : factors) {
+        Stage stage;
+        stage.radix  = radix;
+        stage.length = current;
+        stage.stride = stride;
+        int m = current / radix;
+        bool direct = radix != 2 && radix != 3 && radix != 4 && radix != 5;
+        stage.twiddle.resize((m + (direct ? 1 : 0)) * radix * 2);
+        for (int q = 0; q < m; ++q) {
+            for (int k = 0; k < radix; ++k) {
+                _twiddle(2.0 * pi * q * k / current, stage.twiddle.data() + (q * radix + k) * 2);
+            }
+        }
+        if (direct) {
+            for (int k = 0; k < radix; ++k) {
+                _twiddle(2.0 * pi * k / radix, stage.twiddle.data() + (m * radix + k) * 2);
+            }
+        }
+        mStages.emplace_back(std::move(stage));
+        stride *= radix;
+        current = m;
+    }
+}
+
+void FFTPlan::_stage(const Stage& stage, const float* src, float* dst) const {
+    auto twiddle = stage.twiddle.data();
+    switch (stage.radix) {
+        case 2:
+            _radixStage<Radix2>(2, stage.length, stage.stride, twiddle, src, dst);
+            break;
+        case 3:
+            _radixStage<Radix3>(3, stage.length, stage.stride, twiddle, src, dst);
+            break;
+        case 4:
+            _radixStage<Radix4>(4, stage.length, stage.stride, twiddle, src, dst);
+            break;
+        case 5:
+            _radixStage<Radix5>(5, stage.length, stage.stride, twiddle, src, dst);
+            break;
+        default:
+            _radixStage<RadixAny>(stage.radix, stage.length, stage.stride, twiddle, src, dst);
+            break;
+    }
+}
+
+float* FFTPlan::_complex(float* data, float* scratch) const {
+    if (nullptr != mConvolution) {
+        return _bluestein(data, scratch);
+    }
+    for (auto& stage : mStages) {
+        _stage(stage, data, scratch);
+        std::swap(data, scratch);
+    }
+    return data;
+}
+
+float* FFTPlan::_bluestein(float* data, float* scratch) const {
+    const int size = mConvolution->length();
+    for (int k = 0; k < mLength; ++k) {
+        auto r = Vec4::load(data + k * 8);
+        auto i = Vec4::load(data + k * 8 + 4);
+        _multiply(r, i, mChirp[2 * k], mChirp[2 * k + 1]);
+        Vec4::save(data + k * 8, r);
+        Vec4::save(data + k * 8 + 4, i);
+    }
+    ::memset(data + mLength * 8, 0, (size - mLength) * 8 * sizeof(float));
+    auto result = mConvolution->execute(data, scratch);
+    // The inverse transform is conj(dft(conj(x)))
+    for (int k = 0; k < size; ++k) {
+        auto r = Vec4::load(result + k * 8);
+        auto i = Vec4::load(result + k * 8 + 4);
+        _multiply(r, i, mKernel[2 * k], mKernel[2 * k + 1]);
+        Vec4::save(result + k * 8, r);
+        Vec4::save(result + k * 8 + 4, Vec4(0.0f) - i);
+    }
+    result = mConvolution->execute(result, result == data ? scratch : data);
+    for (int k = 0; k < mLength; ++k) {
+        auto r = Vec4::load(result + k * 8);
+        auto i = Vec4(0.0f) - Vec4::load(result + k * 8 + 4);
+        _multiply(r, i, mChirp[2 * k], mChirp[2 * k + 1]);
+        Vec4::save(result + k * 8, r);
+        Vec4::save(result + k * 8 + 4, i);
+    }
+    return result;
+}
+
+float* FFTPlan::execute(float* data, float* scratch) const {
+    if (nullptr == mHalf) {
+        return _complex(data, scratch);
+    }
+    const int half = mLength / 2;
+    auto z   = mHalf->execute(data, scratch);
+    auto dst = z == data ? scratch : data;
+    for (int k = 0; k <= half; ++k) {
+        auto a  = z + (k % half) * 8;
+        auto b  = z + ((half - k) % half) * 8;
+        auto ar = Vec4::load(a);
+        auto ai = Vec4::load(a + 4);
+        auto br = Vec4::load(b);
+        auto bi = Vec4::load(b + 4);
+        // even = (Z[k] + conj(Z[h - k])) / 2, odd = -i * (Z[k] - conj(Z[h - k])) / 2
+        auto er = (ar + br) * 0.5f;
+        auto ei = (ai - bi) * 0.5f;
+        auto orr = (ai + bi) * 0.5f;
+        auto oi  = (br - ar) * 0.5f;
+        _multiply(orr, oi, mSplit[2 * k], mSplit[2 * k + 1]);
+        Vec4::save(dst + k * 8, er + orr);
+        Vec4::save(dst + k * 8 + 4, ei + oi);
+    }
+    return dst;
+}
+
+void FFTPlan::load(float* data, const float* const* frames, int number, const float* window) const {
+    const int count = nullptr != mHalf ? mLength / 2 : mLength;
+    for (int l = 0; l < LANE; ++l) {
+        if (l >= number) {
+            for (int j = 0; j < count; ++j) {
+                data[j * 8 + l]     = 0.0f;
+                data[j * 8 + 4 + l] = 0.0f;
+            }
+            continue;
+        }
+        auto src = frames[l];
+        if (nullptr != mHalf) {
+            for (int j = 0; j < count; ++j) {
+                data[j * 8 + l]     = src[2 * j] * (window ? window[2 * j] : 1.0f);
+                data[j * 8 + 4 + l] = src[2 * j + 1] * (window ? window[2 * j + 1] : 1.0f);
+            }
+        } else if (mReal) {
+            for (int j = 0; j < count; ++j) {
+                data[j * 8 + l]     = src[j] * (window ? window[j] : 1.0f);
+                data[j * 8 + 4 + l] = 0.0f;
+            }
+        } else {
+            for (int j = 0; j < count; ++j) {
+                auto w = window ? window[j] : 1.0f;
+                data[j * 8 + l]     = src[2 * j] * w;
+                data[j * 8 + 4 + l] = src[2 * j + 1] * w;
+            }
+        }
+    }
+}
+
+void FFTPlan::store(const float* result, float* const* outputs, int number, int bins) const {
+    const int half = mLength / 2;
+    bins = std::min(bins, mLength);
+    for (int l = 0; l < number; ++l) {
+        auto dst = outputs[l];
+        for (int k = 0; k < bins; ++k) {
+            if (nullptr != mHalf && k > half) {
+                // The spectrum of a real signal is conjugate symmetric
+                dst[2 * k]     = result[(mLength - k) * 8 + l];
+                dst[2 * k + 1] = -result[(mLength - k) * 8 + 4 + l];
+            } else {
+                dst[2 * k]     = result[k * 8 + l];
+                dst[2 * k + 1] = result[k * 8 + 4 + l];
+            }
+        }
+    }
+}
+
+} // namespace MNN
@@ -0,0 +1,74 @@
+//
+//  FFTFunction.hpp
+//  MNN
+//
+//  Created by MNN on 2026/10/16.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#ifndef FFTFunction_hpp
+#define FFTFunction_hpp
+
+#include <memory>
+#include <vector>
+
+namespace MNN {
+/**
+ Forward DFT plan of a fixed length, computing 4 frames at once in the lanes of a Vec4.
+ The length is factored into radix 4/2/3/5 stages (other primes use a direct butterfly, large
+ ones a power-of-two Bluestein convolution) run as a self-sorting Stockham FFT, with all twiddles
+ computed when planning. A real even length is transformed as a complex dft of half length.
+ Buffers hold complex lanes: element i is [re0, re1, re2, re3, im0, im1, im2, im3] at i * 8.
+ */
+class FFTPlan {
+public:
+    static constexpr int LANE = 4;
+    FFTPlan(int length, bool realInput);
+    ~FFTPlan() = default;
+
+    int length() const {
+        return mLength;
+    }
+    bool realInput() const {
+        return mReal;
+    }
+    // Floats needed by each of the two buffers passed to execute
+    int bufferSize() const {
+        return mBufferSize;
+    }
+    // Loads up to LANE frames multiplied by window (nullptr means none) into data. Real input frames hold
+    // length floats, complex ones length pairs of floats.
+    void load(float* data, const float* const* frames, int number, const float* window) const;
+    // Transforms the loaded frames, data and scratch are both clobbered, returns the one holding the result
+    float* execute(float* data, float* scratch) const;
+    // Stores the first bins (at most length) coefficients of each frame as pairs of floats
+    void store(const float* result, float* const* outputs, int number, int bins) const;
+
+private:
+    struct Stage {
+        int radix;
+        int length;
+        int stride;
+        // (cos, -sin) of the twiddle for every output q * radix + k of the stage, followed by the roots of
+        // unity when the radix has no specialized butterfly
+        std::vector<float> twiddle;
+    };
+    void _stage(const Stage& stage, const float* src, float* dst) const;
+    float* _complex(float* data, float* scratch) const;
+    float* _bluestein(float* data, float* scratch) const;
+
+    int mLength;
+    bool mReal;
+    int mBufferSize;
+    std::vector<Stage> mStages;
+    // Real input: complex plan of half length and the twiddles to split its result
+    std::shared_ptr<FFTPlan> mHalf;
+    std::vector<float> mSplit;
+    // Bluestein: power-of-two plan for the convolution, the chirp and the transformed kernel
+    std::shared_ptr<FFTPlan> mConvolution;
+    std::vector<float> mChirp;
+    std::vector<float> mKernel;
+};
+} // namespace MNN
+
+#endif /* FFTFunction_hpp */
@@ -47,7 +47,7 @@ static void _MetalApplyTensor(uint8_t* host, size_t offset, Tensor* t) {
     des->extra.offset = offset;
 }
 BufferAllocator* MetalRuntime::createDynamicAllocator(int index, bool secondResize) const {
-    if (hint().memoryAllocatorType == Runtime::Allocator_Defer && secondResize) {
+    if (hint().memoryAllocatorType != Runtime::Allocator_Eager && secondResize) {
         return new DeferBufferAllocator(buffer(index), 1024, _MetalApplyTensor);
     }
     if (mStaticAllocatorRaw.get() != nullptr) {
@@ -11,6 +11,7 @@
 
 #include <stdint.h>
 #include <string.h>
+#include <memory>
 #include "MNNMemoryUtils.h"
 
 namespace MNN {
@@ -237,13 +238,15 @@ struct BufferStorage {
         return storage + offset;
     }
     ~ BufferStorage() {
-        if (nullptr != storage) {
+        if (nullptr != storage && nullptr == owner) {
             delete [] storage;
         }
     }
     size_t allocated_size;
     size_t offset;
     uint8_t* storage = nullptr;
+    // Keeps storage alive when it isn't allocated by new [], eg: a mapped file
+    std::shared_ptr<void> owner;
 };
 
 } // namespace MNN
@@ -51,6 +51,9 @@ struct RuntimeHint {
     // -1 for no limit
     int kvcacheSizeLimit = -1;
 
+    // 1: store kvcache in fixed-size blocks of a runtime shared pool
+    int kvcachePaged = 0;
+
     // path of the kvcache directory
     std::string kvcacheDirPath = "";
 
@@ -59,6 +62,8 @@ struct RuntimeHint {
 
     std::string midMemoryPath;
     std::string weightMemoryPath;
+    // uuid of the model, keys the cached packed weights in weightMemoryPath
+    std::string modelUUID;
     int mmapFileSize = 1024; // MB
     int useCachedMmap = 0;
 
@@ -84,6 +89,27 @@ struct RuntimeHint {
     int divisionRatio = 41;
 
     int smeCores = 2; // Number of SME cores of the backend, default is 2, if supports sme
+
+    // Thread pool scheduling of the session, see Interpreter::CPU_TASK_PRIORITY and CPU_CORE_BUDGET
+    int cpuTaskPriority = 0;
+    int cpuCoreBudget = 0;
+
+    // 1: Module::load maps the model file instead of reading it
+    int mapModelFile = 0;
+
+    // > 0: Pipeline prefetches the weights of that many ops ahead and releases the weights of finished ops
+    int weightPrefetchWindow = 0;
+
+    // > 1: StaticModule keeps that many resized plans keyed by the input shapes
+    int staticModulePlanCache = 0;
+
+    // 1: Pipeline runs the commands of a dependency level concurrently on cpu
+    int cpuInterOpParallel = 0;
+
+    // >= 0: cpu runtime binds its threads and memory to this NUMA node
+    int numaNode = -1;
+    // 1: Session::clone doesn't share op weights with a session on another NUMA node
+    int numaReplicateWeight = 0;
 };
 /** abstract backend */
 class Backend : public NonCopyable {
@@ -182,6 +208,13 @@ public:
      * @brief callback after executing ops.
      */
     virtual void onExecuteEnd() const = 0;
+    /**
+     * @brief hint that the execution of op will run soon (load its weights) or has finished (release them).
+     * only called when RuntimeHint::weightPrefetchWindow > 0, must not block.
+     */
+    virtual void onPrefetch(const Op* op, bool release) const {
+        // Do nothing
+    }
 
     virtual const Runtime* getRuntime() {
         return nullptr;
@@ -299,6 +332,8 @@ public:
     enum AllocatorType {
         Allocator_Defer = 0,
         Allocator_Eager = 1,
+        // Defer, with static and dynamic memory in 2MB aligned transparent huge pages if the backend supports it
+        Allocator_HugePage = 2,
     };
     void setRuntimeHint(const RuntimeHint& hint) {
         mHint = hint;
@@ -337,6 +372,24 @@ public:
     virtual float onGetMemoryInMB() {
         return 0.0f;
     }
+    /**
+     @brief Queueing of parallel regions: count, mean and max delay in ms, see Interpreter::THREAD_POOL_QUEUE_DELAY
+     */
+    virtual bool onGetQueueDelay(float* dst) const {
+        return false;
+    }
+    /**
+     @brief Huge pages of Allocator_HugePage: 2MB pages advised and backed by the system, see Interpreter::HUGE_PAGES
+     */
+    virtual bool onGetHugePages(int* dst) const {
+        return false;
+    }
+    /**
+     @brief Streamed weights: ops tracked and advices issued, see Interpreter::WEIGHT_PREFETCH
+     */
+    virtual bool onGetWeightPrefetch(int* dst) const {
+        return false;
+    }
     // For NPU backend don't support load from buffer , use onSetCachePath
     virtual bool onSetCachePath(const char* path, int mode) {
         return false;
@@ -6,9 +6,17 @@
 //  Copyright © 2018, Alibaba Group Holding Limited
 //
 
+#include <map>
+#include <mutex>
 #include <string>
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 #include "core/BufferAllocator.hpp"
 #include "core/Macro.h"
+#include "core/TraceRecorder.hpp"
 #include "MNNFileUtils.h"
 
 // #define DUMP_USAGE
@@ -152,6 +160,130 @@ public:
         }
     }
 };
+#if defined(__linux__)
+// Anonymous pages mapped for each chunk. The preferred NUMA node is set before they are touched, huge page
+// chunks are 2MB aligned and advised to be backed by transparent huge pages
+class PageAllocator : public BufferAllocator::Allocator {
+public:
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+    PageAllocator(int node, bool hugePage) {
+        mNode = node;
+        mHugePage = hugePage;
+        mPageSize = hugePage ? HUGE_PAGE_SIZE : sysconf(_SC_PAGESIZE);
+    }
+    virtual ~ PageAllocator() {
+        for (auto& iter : mCache) {
+            _free(iter.first, iter.second);
+        }
+    }
+    virtual MemChunk onAlloc(size_t size, size_t align) override {
+        size_t length = UP_DIV(size, mPageSize) * mPageSize;
+        // Map one more huge page to cut an aligned range from it
+        size_t extra = mHugePage ? HUGE_PAGE_SIZE : 0;
+        auto raw = (uint8_t*)mmap(nullptr, length + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == raw) {
+            if (!mHugePage) {
+                MNN_ERROR("Alloc %lu on NUMA node %d failed\n", size, mNode);
+                return MemChunk();
+            }
+            // Fall back to 4KB pages, recorded with length 0
+            auto ptr = MNNMemoryAllocAlign(size, MNN_MEMORY_ALIGN_DEFAULT);
+            if (nullptr == ptr) {
+                return MemChunk();
+            }
+            std::lock_guard<std::mutex> _l(mLock);
+            mCache.insert(std::make_pair(ptr, 0));
+            return MemChunk(ptr, 0);
+        }
+        auto ptr = raw;
+        if (mHugePage) {
+            ptr = (uint8_t*)(((size_t)raw + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+            if (ptr > raw) {
+                munmap(raw, ptr - raw);
+            }
+            if (ptr + length < raw + length + extra) {
+                munmap(ptr + length, raw + extra - ptr);
+            }
+        }
+#if defined(SYS_mbind)
+        if (mNode >= 0) {
+            // MPOL_PREFERRED: fall back to other nodes instead of failing when the node is full
+            unsigned long nodeMask[16] = {0};
+            if (mNode < (int)sizeof(nodeMask) * 8) {
+                nodeMask[mNode / (sizeof(unsigned long) * 8)] |= 1UL << (mNode % (sizeof(unsigned long) * 8));
+                syscall(SYS_mbind, ptr, length, 1, nodeMask, sizeof(nodeMask) * 8 + 1, 0);
+            }
+        }
+#endif
+        std::lock_guard<std::mutex> _l(mLock);
+#ifdef MADV_HUGEPAGE
+        if (mHugePage && 0 == madvise(ptr, length, MADV_HUGEPAGE)) {
+            mAdvisedPages += length / HUGE_PAGE_SIZE;
+        }
+#endif
+        mCache.insert(std::make_pair(ptr, length));
+        return MemChunk(ptr, 0);
+    }
+    virtual void onRelease(MemChunk chunk) override {
+        MNN_ASSERT(chunk.second == 0);
+        std::lock_guard<std::mutex> _l(mLock);
+        auto iter = mCache.find(chunk.first);
+        if (iter == mCache.end()) {
+            return;
+        }
+        if (mHugePage && iter->second > 0) {
+            mAdvisedPages -= ALIMIN(mAdvisedPages, iter->second / HUGE_PAGE_SIZE);
+        }
+        _free(iter->first, iter->second);
+        mCache.erase(iter);
+    }
+    virtual bool onGetHugePages(size_t* dst) override {
+        if (!mHugePage) {
+            return false;
+        }
+        std::lock_guard<std::mutex> _l(mLock);
+        dst[0] = mAdvisedPages;
+        dst[1] = 0;
+        // The pages the kernel really backs with huge pages, summed over the mappings holding the chunks
+        auto f = fopen("/proc/self/smaps", "r");
+        if (nullptr == f) {
+            return true;
+        }
+        char line[512];
+        bool owned = false;
+        size_t hugeBytes = 0;
+        while (nullptr != fgets(line, sizeof(line), f)) {
+            unsigned long begin, end;
+            if (2 == sscanf(line, "%lx-%lx ", &begin, &end)) {
+                auto iter = mCache.lower_bound((void*)begin);
+                owned = iter != mCache.end() && (size_t)iter->first < end && iter->second > 0;
+                continue;
+            }
+            unsigned long kb;
+            if (owned && 1 == sscanf(line, "AnonHugePages: %lu kB", &kb)) {
+                hugeBytes += kb * 1024;
+            }
+        }
+        fclose(f);
+        dst[1] = ALIMIN(hugeBytes / HUGE_PAGE_SIZE, mAdvisedPages);
+        return true;
+    }
+private:
+    static void _free(void* ptr, size_t length) {
+        if (0 == length) {
+            MNNMemoryFreeAlign(ptr);
+            return;
+        }
+        munmap(ptr, length);
+    }
+    int mNode;
+    bool mHugePage;
+    size_t mPageSize;
+    size_t mAdvisedPages = 0;
+    std::mutex mLock;
+    std::map<void*, size_t> mCache;
+};
+#endif
 class RecurseAllocator : public BufferAllocator::Allocator {
 public:
     RecurseAllocator(BufferAllocator* parent) {
@@ -181,6 +313,26 @@ std::shared_ptr<BufferAllocator::Allocator> BufferAllocator::Allocator::createMm
     return _res;
 }
 
+std::shared_ptr<BufferAllocator::Allocator> BufferAllocator::Allocator::createNuma(int node) {
+    std::shared_ptr<BufferAllocator::Allocator> _res;
+#if defined(__linux__) && defined(SYS_mbind)
+    _res.reset(new PageAllocator(node, false));
+#else
+    _res.reset(new DefaultAllocator);
+#endif
+    return _res;
+}
+
+std::shared_ptr<BufferAllocator::Allocator> BufferAllocator::Allocator::createHugePage(int node) {
+    std::shared_ptr<BufferAllocator::Allocator> _res;
+#if defined(__linux__)
+    _res.reset(new PageAllocator(node, true));
+#else
+    _res.reset(new DefaultAllocator);
+#endif
+    return _res;
+}
+
 std::shared_ptr<BufferAllocator::Allocator> BufferAllocator::Allocator::createRecurse(BufferAllocator* parent) {
     std::shared_ptr<BufferAllocator::Allocator> _res;
     _res.reset(new RecurseAllocator(parent));
@@ -190,6 +342,7 @@ std::shared_ptr<BufferAllocator::Allocator> BufferAllocator::Allocator::createRe
 EagerBufferAllocator::Node::~Node() {
     if (nullptr == parent.get()) {
         outside->onRelease(pointer);
+        TraceRecorder::recordMemory(TraceRecorder::FREE, size);
     }
 }
 MemChunk EagerBufferAllocator::alloc(size_t size, bool separate, size_t align) {
@@ -227,6 +380,7 @@ MemChunk EagerBufferAllocator::alloc(size_t size, bool separate, size_t align) {
         return chunk;
     }
     mTotalSize += allocSize;
+    TraceRecorder::recordMemory(TraceRecorder::ALLOC, allocSize);
 
     // save node
     SharedPtr<Node> node(new Node);
@@ -342,10 +496,15 @@ void EagerBufferAllocator::release(bool allRelease) {
 }
 
 void EagerBufferAllocator::barrierBegin() {
-    MNN_ASSERT(mGroups.empty());
+    MNN_ASSERT(mBarrierDepth > 0 || mGroups.empty());
+    mBarrierDepth++;
 }
 
 void EagerBufferAllocator::barrierEnd() {
+    MNN_ASSERT(mBarrierDepth > 0);
+    if (--mBarrierDepth > 0) {
+        return;
+    }
     for (auto& freeGroup : mGroups) {
         auto freeList = *freeGroup;
         for (auto& iter : freeList) {
@@ -357,12 +516,18 @@ void EagerBufferAllocator::barrierEnd() {
 
 void EagerBufferAllocator::beginGroup() {
     std::shared_ptr<FREELIST> newFreeList(new FREELIST);
+    mGroupStack.emplace_back(mCurrentFreeList);
     mCurrentFreeList = newFreeList.get();
     mGroups.emplace_back(newFreeList);
 }
 
 void EagerBufferAllocator::endGroup() {
-    mCurrentFreeList = nullptr;
+    if (mGroupStack.empty()) {
+        mCurrentFreeList = nullptr;
+        return;
+    }
+    mCurrentFreeList = mGroupStack.back();
+    mGroupStack.pop_back();
 }
 
 void EagerBufferAllocator::sync() {
@@ -431,6 +596,7 @@ SingleBufferWithAllocator::~ SingleBufferWithAllocator() {
 void SingleBufferWithAllocator::release() {
     if (current.first != nullptr) {
         root->onRelease(current);
+        TraceRecorder::recordMemory(TraceRecorder::FREE, currentSize);
         current.first = nullptr;
         current.second = 0;
         currentSize = 0;
@@ -441,12 +607,14 @@ ErrorCode SingleBufferWithAllocator::realloc(size_t size, size_t align) {
     if (currentSize < size) {
         if (nullptr != current.first) {
             root->onRelease(current);
+            TraceRecorder::recordMemory(TraceRecorder::FREE, currentSize);
         }
         current = root->onAlloc(size, align);
         if (current.first == nullptr) {
             return OUT_OF_MEMORY;
         }
         currentSize = size;
+        TraceRecorder::recordMemory(TraceRecorder::ALLOC, size);
     }
     return NO_ERROR;
 }
@@ -534,12 +702,13 @@ void DeferBufferAllocator::release(bool allRelease) {
 }
 
 void DeferBufferAllocator::barrierBegin() {
-    MNN_ASSERT(!mBarrrier);
-    mBarrrier = true;
+    mBarrrier++;
 }
 void DeferBufferAllocator::barrierEnd() {
-    mBarrrier = false;
-    MNN_ASSERT(!mBarrrier);
+    MNN_ASSERT(mBarrrier > 0);
+    if (--mBarrrier > 0) {
+        return;
+    }
     for (auto& chunk : mBarrrierFreeChunks) {
         this->free(chunk);
     }
@@ -560,7 +729,7 @@ void DeferBufferAllocator::reset() {
     mPtr.second = 0;
     mHead = nullptr;
     mTail = nullptr;
-    mBarrrier = false;
+    mBarrrier = 0;
     mBarrrierFreeChunks.clear();
 }
 
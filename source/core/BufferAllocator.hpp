@@ -88,6 +88,14 @@ public:
         static std::shared_ptr<Allocator> createDefault();
         static std::shared_ptr<Allocator> createMmap(const char* dirName, const char* prefix, const char* posfix, bool autoRemove = true);
         static std::shared_ptr<Allocator> createRecurse(BufferAllocator* parent);
+        // Memory preferred on the NUMA node, the default allocator if the system can't bind memory
+        static std::shared_ptr<Allocator> createNuma(int node);
+        // 2MB aligned memory backed by transparent huge pages when the system allows, on the NUMA node if node >= 0
+        static std::shared_ptr<Allocator> createHugePage(int node = -1);
+        // Huge page allocator only, dst[0]: 2MB pages advised, dst[1]: pages the system backed with huge pages
+        virtual bool onGetHugePages(size_t* dst) {
+            return false;
+        }
     };
     BufferAllocator() = default;
     virtual ~BufferAllocator() = default;
@@ -160,6 +168,7 @@ public:
      begin group / end group means the memory allocated belong to one thread
      different group must use different memory,
      but the origin freelist can be used by every group
+     barriers and groups can be nested, the memory freed inside is only returned by the outermost barrierEnd
      */
     void barrierBegin() override;
     void barrierEnd() override;
@@ -187,6 +196,9 @@ private:
 
     FREELIST* mCurrentFreeList = nullptr;
     std::vector<std::shared_ptr<FREELIST>> mGroups;
+    // free lists of the enclosing groups
+    std::vector<FREELIST*> mGroupStack;
+    int mBarrierDepth = 0;
     std::shared_ptr<Allocator> mAllocator;
     size_t mAlign;
     size_t mMinAllocSize = 0;
@@ -226,8 +238,8 @@ private:
     // std::unique_ptr<uint8_t[]> mPtr;
     MemChunk mPtr;
     size_t mAlign;
-    // barrier
-    bool mBarrrier = false;
+    // barrier, nested barriers only end with the outermost one
+    int mBarrrier = 0;
     std::vector<MemChunk> mBarrrierFreeChunks;
 private:
     MemNode* createMemNode(size_t size);
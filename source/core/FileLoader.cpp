@@ -7,6 +7,7 @@
 //
 
 #include "core/FileLoader.hpp"
+#include "core/MNNFileUtils.h"
 #if defined(_MSC_VER)
 #include "Windows.h"
 #endif
@@ -62,6 +63,54 @@ FileLoader::~FileLoader() {
     for (auto iter : mBlocks) {
         MNNMemoryFreeAlign(iter.second);
     }
+    if (nullptr != mMapped) {
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64) || defined(_MSC_VER)
+        UnmapViewOfFile(mMapped);
+#else
+        munmap(mMapped, mMappedSize);
+#endif
+    }
+}
+
+bool FileLoader::map() {
+    if (nullptr != mMapped) {
+        return true;
+    }
+    if (mFilePath.empty()) {
+        return false;
+    }
+    auto file = MNNOpenFile(mFilePath.c_str(), MNN_FILE_READ);
+    if (INVALID_FILE == file) {
+        return false;
+    }
+    auto size = MNNGetFileSize(file);
+    if (0 == size || INVALID_SIZE == size) {
+        MNNCloseFile(file);
+        return false;
+    }
+    void* addr = nullptr;
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64) || defined(_MSC_VER)
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (NULL != mapping) {
+        addr = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, size);
+        CloseHandle(mapping);
+    }
+#else
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+    if (MAP_FAILED == addr) {
+        addr = nullptr;
+    }
+#endif
+    // The mapping keeps its own reference of the file
+    MNNCloseFile(file);
+    if (nullptr == addr) {
+        MNN_ERROR("Mmap %s failed, fall back to read\n", mFilePath.c_str());
+        return false;
+    }
+    mMapped     = (uint8_t*)addr;
+    mMappedSize = size;
+    mTotalSize  = size;
+    return true;
 }
 
 bool FileLoader::read() {
@@ -69,6 +118,33 @@ bool FileLoader::read() {
     if (nullptr == mFile) {
         return false;
     }
+    // Read the whole file into one block when its size is known, merge then takes it without copying
+    int64_t fileSize = -1;
+#if defined(_MSC_VER)
+    if (0 == _fseeki64(mFile, 0, SEEK_END)) {
+        fileSize = _ftelli64(mFile);
+        _fseeki64(mFile, 0, SEEK_SET);
+    }
+#else
+    if (0 == fseek(mFile, 0, SEEK_END)) {
+        fileSize = ftell(mFile);
+        fseek(mFile, 0, SEEK_SET);
+    }
+#endif
+    if (fileSize > 0) {
+        auto block = MNNMemoryAllocAlign(fileSize, MNN_MEMORY_ALIGN_DEFAULT);
+        if (nullptr == block) {
+            MNN_PRINT("Memory Alloc Failed\n");
+            return false;
+        }
+        auto size = fread(block, 1, fileSize, mFile);
+        mTotalSize = size;
+        mBlocks.push_back(std::make_pair(size, block));
+        if (size != fileSize || ferror(mFile)) {
+            return false;
+        }
+        return true;
+    }
     auto block = MNNMemoryAllocAlign(gCacheSize, MNN_MEMORY_ALIGN_DEFAULT);
     if (nullptr == block) {
         MNN_PRINT("Memory Alloc Failed\n");
@@ -127,6 +203,11 @@ bool FileLoader::write(const char* filePath, std::pair<const void*, size_t> cach
 }
 
 bool FileLoader::merge(AutoStorage<uint8_t>& buffer) {
+    if (1 == mBlocks.size()) {
+        buffer.set((uint8_t*)mBlocks[0].second, (int)mBlocks[0].first);
+        mBlocks.clear();
+        return true;
+    }
     buffer.reset((int)mTotalSize);
     if (buffer.get() == nullptr) {
         MNN_PRINT("Memory Alloc Failed\n");
@@ -43,6 +43,13 @@ public:
 
     bool merge(AutoStorage<uint8_t>& buffer);
 
+    // Map the whole file instead of reading it, return false if mapping is not supported.
+    // Pages are copy-on-write: they are shared with other processes mapping the same file until written
+    bool map();
+    inline uint8_t* mapped() const {
+        return mMapped;
+    }
+
     int offset(int64_t offset);
 
     bool read(char* buffer, int64_t size);
@@ -54,6 +61,8 @@ private:
     size_t mTotalSize           = 0;
     std::string mFilePath;
     bool mInited = false;
+    uint8_t* mMapped = nullptr;
+    size_t mMappedSize = 0;
 };
 
 class MemoryLoader : public BaseLoader {
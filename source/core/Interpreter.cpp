@@ -30,6 +30,8 @@ namespace MNN {
 
 struct Content {
     AutoStorage<uint8_t> buffer;
+    // Set when buffer points to the mapped model file
+    std::shared_ptr<FileLoader> mappedFile;
     const Net* net = nullptr;
     std::vector<std::unique_ptr<Session>> sessions;
     std::map<Tensor*, const Session*> tensorMap;
@@ -59,11 +61,21 @@ static void writeCacheFile(const Content* net, std::pair<const void*, size_t> bu
     }
 }
 
-static Content* loadModelFile(const char* file) {
+static Content* loadModelFile(const char* file, bool mapFile) {
     if (nullptr == file) {
         MNN_PRINT("NULL file for create interpreter\n");
         return nullptr;
     }
+    if (mapFile) {
+        std::shared_ptr<FileLoader> mapped(new FileLoader(file));
+        if (mapped->map()) {
+            auto net = new Content;
+            net->mappedFile = mapped;
+            net->buffer.set(mapped->mapped(), (int)mapped->size());
+            net->buffer.set(mapped->mapped(), false);
+            return net;
+        }
+    }
     std::unique_ptr<FileLoader> loader(new FileLoader(file, true));
     if (!loader->valid()) {
         MNN_PRINT("Create interpreter failed, open %s error\n", file);
@@ -88,7 +100,10 @@ static Content* loadModelFile(const char* file) {
 }
 
 Interpreter* Interpreter::createFromFile(const char* file) {
-    Content* net = loadModelFile(file);
+    return createFromFile(file, false);
+}
+Interpreter* Interpreter::createFromFile(const char* file, bool mapFile) {
+    Content* net = loadModelFile(file, mapFile);
     if (nullptr == net) {
         return nullptr;
     }
@@ -225,6 +240,7 @@ Interpreter::Interpreter(Content* net) {
     // Store bizcode and uuid because we need them even after `releaseModel` is called.
     mNet->bizCode = std::string(mNet->net->bizCode() ? mNet->net->bizCode()->c_str() : "");
     mNet->uuid    = std::string(mNet->net->mnn_uuid() ? mNet->net->mnn_uuid()->c_str() : "");
+    mNet->modes.runtimeHint.modelUUID = mNet->uuid;
 #ifdef MNN_INTERNAL_ENABLED
     mNet->version = getModelVersion();
 #endif
@@ -253,13 +269,20 @@ Session* Interpreter::createMultiPathSession(const std::vector<ScheduleConfig>&
 }
 
 Session* Interpreter::createMultiPathSession(const std::vector<ScheduleConfig>& configs, const RuntimeInfo& runtime) {
+    auto modes = mNet->modes;
+    auto& hint = modes.runtimeHint;
+    if (hint.useCachedMmap > 0 && hint.modelUUID.empty() && nullptr != mNet->buffer.get()) {
+        // Models without uuid are keyed by their content, so that they never read the packed weights of each other.
+        // Only this session uses the key, the hint is kept as the user set it
+        hint.modelUUID = OpCommonUtils::modelKey(mNet->net, mNet->buffer.get(), mNet->buffer.size());
+    }
     for (auto& iter : runtime.first) {
-        iter.second->setRuntimeHint(mNet->modes.runtimeHint);
+        iter.second->setRuntimeHint(hint);
         if (!mNet->cacheFile.empty()) {
             iter.second->onSetCachePath(mNet->cacheFile.c_str(), 0);
         }
     }
-    runtime.second->setRuntimeHint(mNet->modes.runtimeHint);
+    runtime.second->setRuntimeHint(hint);
 
     if (nullptr == mNet->buffer.get()) {
         MNN_ERROR("The model buffer has been released. Can't create session\n");
@@ -303,7 +326,7 @@ Session* Interpreter::createMultiPathSession(const std::vector<ScheduleConfig>&
         }
     }
 
-    auto newSession = std::unique_ptr<Session>(new Session(std::move(info), mNet->modes, std::move(rt)));
+    auto newSession = std::unique_ptr<Session>(new Session(std::move(info), modes, std::move(rt)));
     if (!newSession->valid()) {
         MNN_PRINT("Invalide Session!!\n");
         return nullptr;
@@ -548,6 +571,11 @@ void Interpreter::releaseModel() {
     }
     if (mNet->buffer.get() != nullptr && mNet->net->usage() != Usage_INFERENCE_STATIC) {
         mNet->buffer.release();
+        if (nullptr != mNet->mappedFile) {
+            mNet->buffer.set(nullptr, true);
+            mNet->buffer.set(nullptr, 0);
+            mNet->mappedFile.reset();
+        }
     }
     mNet->cacheBuffer.release();
 }
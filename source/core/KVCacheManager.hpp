@@ -26,6 +26,7 @@ public:
         int  mExpandChunk = 64;                 // Number of expand chunks when the buffer is full
         int mBlockNum = 1;
         int mKvAlignNum;
+        bool mPaged = false;                    // Store the kvcache in fixed-size blocks instead of one buffer
     };
 protected:
     Backend * mBackend;
@@ -326,3 +326,28 @@ ErrorCode MNNMmapSync(void * addr, size_t size)
 #endif
     return NO_ERROR;
 }
+
+ErrorCode MNNMmapAdvise(void * addr, size_t size, bool release)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64) || defined(_MSC_VER)
+    return NOT_SUPPORT;
+#else
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    // Only touch whole pages inside the range when releasing, a shared page may still be used
+    auto begin = reinterpret_cast<size_t>(addr);
+    auto end = begin + size;
+    if (release) {
+        begin = (begin + pageSize - 1) / pageSize * pageSize;
+        end = end / pageSize * pageSize;
+    } else {
+        begin = begin / pageSize * pageSize;
+    }
+    if (end <= begin) {
+        return NO_ERROR;
+    }
+    if (0 != madvise(reinterpret_cast<void*>(begin), end - begin, release ? MADV_DONTNEED : MADV_WILLNEED)) {
+        return INVALID_VALUE;
+    }
+    return NO_ERROR;
+#endif
+}
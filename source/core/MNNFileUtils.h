@@ -198,4 +198,18 @@ MNN_PUBLIC ErrorCode MNNUnmapFile(void * addr, size_t size);
 */
 MNN_PUBLIC ErrorCode MNNMmapSync(void * addr, size_t size);
 
+/*=============================================================================================
+**  @brief      Advise the kernel about the residency of part of a mapped file
+**  @param      addr -- start address inside the mapped space, need not be page aligned
+**              size -- length of the range
+**              release -- false: start reading the range in background
+**                         true: drop the pages of the range from the process, they are read
+**                         back from the file on next access
+**  @return     If succeeded, returns NO_ERROR
+**              If the advice is rejected, returns INVALID_VALUE
+**              On Windows, returns NOT_SUPPORT
+**  @warning    Only use it on spaces mapped by MNNMmapFile(), release on other memory loses data
+*/
+MNN_PUBLIC ErrorCode MNNMmapAdvise(void * addr, size_t size, bool release);
+
 #endif // MNN_FileUtils_H
@@ -893,4 +893,28 @@ DataType OpCommonUtils::convertDataType(halide_type_t type) {
     }
     return DataType_DT_INVALID;
 }
+
+std::string OpCommonUtils::modelKey(const Net* net, const void* buffer, size_t length) {
+    if (nullptr != net && nullptr != net->mnn_uuid() && net->mnn_uuid()->size() > 0) {
+        return net->mnn_uuid()->str();
+    }
+    if (nullptr == buffer || 0 == length) {
+        return "";
+    }
+    // FNV-1a on 8 bytes a time
+    uint64_t hash = 14695981039346656037ULL ^ (uint64_t)length;
+    auto src = (const uint8_t*)buffer;
+    size_t words = length / sizeof(uint64_t);
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t v;
+        ::memcpy(&v, src + i * sizeof(uint64_t), sizeof(uint64_t));
+        hash = (hash ^ v) * 1099511628211ULL;
+    }
+    for (size_t i = words * sizeof(uint64_t); i < length; ++i) {
+        hash = (hash ^ src[i]) * 1099511628211ULL;
+    }
+    char key[32];
+    snprintf(key, sizeof(key), "h%016llx", (unsigned long long)hash);
+    return key;
+}
 } // namespace MNN
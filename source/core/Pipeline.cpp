@@ -7,14 +7,17 @@
 //
 
 #include <string.h>
+#include <algorithm>
 #include "core/Pipeline.hpp"
 #include "core/Backend.hpp"
 #include "core/Macro.h"
 #include "core/TensorUtils.hpp"
+#include "core/TraceRecorder.hpp"
 #include "core/WrapExecution.hpp"
 #include "geometry/GeometryComputerUtils.hpp"
 #include "shape/SizeComputer.hpp"
 #include "core/OpCommonUtils.hpp"
+#include "backend/cpu/CPUBackend.hpp"
 
 // TODO: Find better way for debug
 //#define MNN_OP_SEPERATE
@@ -201,6 +204,7 @@ Pipeline::Pipeline(const std::string& externalFile, Schedule::PipelineInfo&& inf
 ErrorCode Pipeline::encode(bool supportDebug, bool permitCodegen) {
     auto& mBackend = mInfo.first.cache.first;
     auto& mBackupBackend = mInfo.first.cache.second;
+    mTraceInfos.clear();
     // Static Model just copy info to command buffer
     if (!mInfo.first.needComputeGeometry) {
         for (int i=0; i<mInfo.second.size(); ++i) {
@@ -920,6 +924,196 @@ ErrorCode Pipeline::fixResizeCache() {
 #endif
     return NO_ERROR;
 }
+ErrorCode Pipeline::_resizeCommand(Command& iter, int index, bool allocInput) {
+    // Alloc for Tensors
+    auto curBackend = iter.execution->backend();
+    if (allocInput && iter.execution->needAllocIO()) {
+        for (auto t : iter.workInputs) {
+            auto allocRes = _allocTensor(t, curBackend, mOutputStatic, index);
+            if (!allocRes) {
+                return OUT_OF_MEMORY;
+            }
+        }
+    }
+    if (iter.execution->needAllocIO()) {
+        for (auto t : iter.workOutputs) {
+            auto res = _allocTensor(t, curBackend, mOutputStatic, index);
+            if (!res) {
+                return OUT_OF_MEMORY;
+            }
+        }
+    }
+#ifdef MNN_PIPELINE_DEBUG
+    if (iter.info != nullptr) {
+        MNN_PRINT("before Resize 2, calling: %s\n", iter.info->name().c_str());
+    }
+#endif
+    if (iter.group == index) {
+        auto code = iter.execution->onResize(iter.workInputs, iter.workOutputs);
+        if (NO_ERROR != code) {
+#ifdef MNN_PIPELINE_DEBUG
+            MNN_ERROR("Pipeline Resize error: %d\n", code);
+#endif
+            if (iter.info.get()) {
+                MNN_ERROR("Resize error for type = %s, name = %s \n", iter.info->type().c_str(), iter.info->name().c_str());
+            }
+            return code;
+        }
+    }
+    // Free mid tensor
+    for (auto t : iter.workInputs) {
+        _releaseTensor(t, allocInput, index);
+    }
+    return NO_ERROR;
+}
+
+// Tensors read by a command: the inputs and the origins of the virtual ones
+static void _collectReads(const Command& cmd, std::vector<Tensor*>& reads) {
+    reads.clear();
+    for (auto t : cmd.workInputs) {
+        reads.emplace_back(t);
+        auto des = TensorUtils::getDescribe(t);
+        if (des->memoryType == Tensor::InsideDescribe::MEMORY_VIRTUAL) {
+            for (auto& reg : des->regions) {
+                if (nullptr != reg.origin) {
+                    reads.emplace_back(reg.origin);
+                }
+            }
+        }
+    }
+}
+
+void Pipeline::_buildLevels() {
+    mLevels.clear();
+    auto isCPU = [](const Backend* bn) {
+        return bn->type() == MNN_FORWARD_CPU || bn->type() == MNN_FORWARD_CPU_EXTENSION;
+    };
+    auto& hint = mRuntime->hint();
+    auto bn = mInfo.first.cache.first.get();
+    auto backupBn = mInfo.first.cache.second.get();
+    if (hint.cpuInterOpParallel <= 0 || hint.weightPrefetchWindow > 0 || !isCPU(bn) || !isCPU(backupBn)) {
+        return;
+    }
+    if (static_cast<CPUBackend*>(bn)->threadNumber() <= 1) {
+        return;
+    }
+    // Ops with state or sub graphs run alone, in their original place
+    static const std::set<OpType> serialOps = {
+        OpType_Attention, OpType_While, OpType_If, OpType_Extra, OpType_Plugin, OpType_RandomUniform, OpType_RandomNormal,
+    };
+    // Level of the last command writing / reading the tensor
+    std::map<const Tensor*, int> writeLevel;
+    std::map<const Tensor*, int> readLevel;
+    auto levelOf = [](const std::map<const Tensor*, int>& levels, const Tensor* t) {
+        auto iter = levels.find(t);
+        return iter == levels.end() ? -1 : iter->second;
+    };
+    int floor = 0;
+    int top = -1;
+    std::vector<Tensor*> reads;
+    std::vector<std::pair<Command*, int>> commands;
+    for (auto& info : mInfo.second) {
+        if (info.type == Schedule::CONSTANT) {
+            continue;
+        }
+        for (auto& cmdP : info.executeBuffer.command) {
+            auto cmd = cmdP.get();
+            _collectReads(*cmd, reads);
+            int level = floor;
+            if (nullptr == cmd->op || serialOps.find(cmd->op->type()) != serialOps.end()) {
+                level = ALIMAX(top + 1, floor);
+                floor = level + 1;
+            } else {
+                for (auto t : reads) {
+                    level = ALIMAX(level, levelOf(writeLevel, t) + 1);
+                }
+                for (auto t : cmd->workOutputs) {
+                    level = ALIMAX(level, ALIMAX(levelOf(writeLevel, t), levelOf(readLevel, t)) + 1);
+                }
+            }
+            for (auto t : reads) {
+                readLevel[t] = ALIMAX(levelOf(readLevel, t), level);
+            }
+            for (auto t : cmd->workOutputs) {
+                writeLevel[t] = level;
+            }
+            top = ALIMAX(top, level);
+            commands.emplace_back(cmd, level);
+        }
+    }
+    if (top + 1 >= (int)commands.size()) {
+        // Nothing to run together
+        return;
+    }
+    mLevels.resize(top + 1);
+    for (auto& iter : commands) {
+        mLevels[iter.second].emplace_back(iter.first);
+    }
+}
+
+void Pipeline::_splitLevels() {
+    if (mLevels.empty()) {
+        return;
+    }
+    // Tensors may still share memory without a dependency (inplace ops, memory of the inputs / outputs),
+    // split a level before the command touching memory written by the previous ones of the level or
+    // writing memory they use. The memory is known after onResizeEnd
+    typedef std::pair<const uint8_t*, const uint8_t*> Range;
+    auto rangeOf = [](const Tensor* t, Range& range) {
+        auto bn = TensorUtils::getDescribeOrigin(t)->getBackend();
+        auto ptr = t->host<uint8_t>();
+        if (nullptr == ptr || nullptr == bn || TensorUtils::getDescribe(t)->memoryType == Tensor::InsideDescribe::MEMORY_VIRTUAL) {
+            return false;
+        }
+        range = std::make_pair(ptr, ptr + static_cast<CPUBackend*>(bn)->getTensorSize(t, true));
+        return true;
+    };
+    auto overlap = [](const std::vector<Range>& ranges, const Range& range) {
+        for (auto& r : ranges) {
+            if (r.first < range.second && range.first < r.second) {
+                return true;
+            }
+        }
+        return false;
+    };
+    std::vector<std::vector<Command*>> levels;
+    std::vector<Tensor*> reads;
+    std::vector<Range> levelReads, levelWrites, cmdReads, cmdWrites;
+    for (auto& level : mLevels) {
+        levels.emplace_back();
+        levelReads.clear();
+        levelWrites.clear();
+        for (auto cmd : level) {
+            _collectReads(*cmd, reads);
+            cmdReads.clear();
+            cmdWrites.clear();
+            Range range;
+            bool conflict = false;
+            for (auto t : reads) {
+                if (rangeOf(t, range)) {
+                    conflict = conflict || overlap(levelWrites, range);
+                    cmdReads.emplace_back(range);
+                }
+            }
+            for (auto t : cmd->workOutputs) {
+                if (rangeOf(t, range)) {
+                    conflict = conflict || overlap(levelWrites, range) || overlap(levelReads, range);
+                    cmdWrites.emplace_back(range);
+                }
+            }
+            if (conflict) {
+                levels.emplace_back();
+                levelReads.clear();
+                levelWrites.clear();
+            }
+            levels.back().emplace_back(cmd);
+            levelReads.insert(levelReads.end(), cmdReads.begin(), cmdReads.end());
+            levelWrites.insert(levelWrites.end(), cmdWrites.begin(), cmdWrites.end());
+        }
+    }
+    mLevels = std::move(levels);
+}
+
 ErrorCode Pipeline::_allocForTensor(int index, bool allocInput) {
 #ifdef MNN_PIPELINE_DEBUG
     int resizeNumber = 0;
@@ -961,61 +1155,76 @@ ErrorCode Pipeline::_allocForTensor(int index, bool allocInput) {
     auto& mBackupBackend = mInfo.first.cache.second;
     mBackend->onResizeBegin();
     mBackupBackend->onResizeBegin();
-    for (auto& info : mInfo.second) {
-        if (info.type == Schedule::CONSTANT) {
-            continue;
-        }
-        auto& buffer = info.executeBuffer;
-        for (int cmdIndex=0; cmdIndex < buffer.command.size(); ++cmdIndex) {
-            auto& iterP = buffer.command[cmdIndex];
-            auto& iter = *iterP;
-#ifdef MNN_PIPELINE_DEBUG
-            auto memory = const_cast<Runtime*>(mRuntime)->onGetMemoryInMB();
-            if (nullptr != info.op->name()) {
-                MNN_PRINT("%f, before Resize: %s - %d\n", memory, info.op->name()->c_str(), cmdIndex);
+    _buildLevels();
+    if (mLevels.empty()) {
+        for (auto& info : mInfo.second) {
+            if (info.type == Schedule::CONSTANT) {
+                continue;
             }
+            auto& buffer = info.executeBuffer;
+            for (int cmdIndex=0; cmdIndex < buffer.command.size(); ++cmdIndex) {
+                auto& iter = *buffer.command[cmdIndex];
+#ifdef MNN_PIPELINE_DEBUG
+                auto memory = const_cast<Runtime*>(mRuntime)->onGetMemoryInMB();
+                if (nullptr != info.op->name()) {
+                    MNN_PRINT("%f, before Resize: %s - %d\n", memory, info.op->name()->c_str(), cmdIndex);
+                }
+                if (iter.group == index) {
+                    resizeNumber++;
+                }
 #endif
-            // Alloc for Tensors
-            auto curBackend = iter.execution->backend();
-            if (allocInput && iter.execution->needAllocIO()) {
-                for (auto t : iter.workInputs) {
-                    auto allocRes = _allocTensor(t, curBackend, mOutputStatic, index);
-                    if (!allocRes) {
-                        return OUT_OF_MEMORY;
-                    }
+                auto code = _resizeCommand(iter, index, allocInput);
+                if (NO_ERROR != code) {
+                    return code;
                 }
             }
-            if (iter.execution->needAllocIO()) {
-                for (auto t : iter.workOutputs) {
-                    auto res = _allocTensor(t, curBackend, mOutputStatic, index);
-                    if (!res) {
-                        return OUT_OF_MEMORY;
-                    }
-                }
+        }
+    } else {
+        // The ops of a level run together: each one allocates in its own group, so that no op reuses the memory
+        // (tensors or scratch of onResize) freed by another op of the level
+        std::vector<BufferAllocator*> allocators;
+        for (auto bn : {mBackend.get(), mBackupBackend.get()}) {
+            auto allocator = static_cast<CPUBackend*>(bn)->getBufferAllocator();
+            if (std::find(allocators.begin(), allocators.end(), allocator) == allocators.end()) {
+                allocators.emplace_back(allocator);
             }
-#ifdef MNN_PIPELINE_DEBUG
-            if (iter.info != nullptr) {
-                MNN_PRINT("before Resize 2, calling: %s - %d \n", iter.info->name().c_str(), cmdIndex);
+        }
+        for (auto& level : mLevels) {
+            bool barrier = level.size() > 1;
+            if (barrier) {
+                for (auto allocator : allocators) {
+                    allocator->barrierBegin();
+                }
             }
-#endif
-            if (iter.group == index) {
-#ifdef MNN_PIPELINE_DEBUG
-                resizeNumber++;
-#endif
-                auto code = iter.execution->onResize(iter.workInputs, iter.workOutputs);
-                if (NO_ERROR != code) {
+            ErrorCode code = NO_ERROR;
+            for (auto cmd : level) {
 #ifdef MNN_PIPELINE_DEBUG
-                    MNN_ERROR("Pipeline Resize error: %d\n", code);
+                if (cmd->group == index) {
+                    resizeNumber++;
+                }
 #endif
-                    if (iter.info.get()) {
-                        MNN_ERROR("Resize error for type = %s, name = %s \n", iter.info->type().c_str(), iter.info->name().c_str());
+                if (barrier) {
+                    for (auto allocator : allocators) {
+                        allocator->beginGroup();
+                    }
+                }
+                code = _resizeCommand(*cmd, index, allocInput);
+                if (barrier) {
+                    for (auto allocator : allocators) {
+                        allocator->endGroup();
                     }
-                    return code;
+                }
+                if (NO_ERROR != code) {
+                    break;
                 }
             }
-            // Free mid tensor
-            for (auto t : iter.workInputs) {
-                _releaseTensor(t, allocInput, index);
+            if (barrier) {
+                for (auto allocator : allocators) {
+                    allocator->barrierEnd();
+                }
+            }
+            if (NO_ERROR != code) {
+                return code;
             }
         }
     }
@@ -1037,7 +1246,11 @@ ErrorCode Pipeline::_allocForTensor(int index, bool allocInput) {
     MNN_PRINT("Resize %d op for index: %d\n", resizeNumber, index);
 #endif
     code = mBackupBackend->onResizeEnd();
-    return code;
+    if (code != NO_ERROR) {
+        return code;
+    }
+    _splitLevels();
+    return NO_ERROR;
 }
 ErrorCode Pipeline::allocMemory(bool firstMalloc, bool forbidReplace) {
     // MNN_PRINT("allocMemory mtype:%d, cpubackendType:%d, cpuBackend runtime:%p\n", mBackend->type(), mBackupBackend->type(), mBackupBackend->getRuntime());
@@ -1050,6 +1263,7 @@ ErrorCode Pipeline::allocMemory(bool firstMalloc, bool forbidReplace) {
     /* Create Execution Begin */
     auto& mBackend = mInfo.first.cache.first;
     auto& mBackupBackend = mInfo.first.cache.second;
+    mTraceInfos.clear();
     // Check If we need a lone time for init
     if (mBackend->type() != MNN_FORWARD_CPU && mBackend->type() != MNN_FORWARD_CPU_EXTENSION && mTuneAttr.autoSetOpType) {
         Runtime::OpInfo dstInfo;
@@ -1127,6 +1341,38 @@ void Pipeline::_copyInputs() {
         std::get<3>(tensorCache) = false;
     }
 }
+const OperatorInfo* Pipeline::_traceInfo(Command* command) {
+    if (nullptr != command->info.get()) {
+        return command->info.get();
+    }
+    auto iter = mTraceInfos.find(command);
+    if (iter != mTraceInfos.end()) {
+        return iter->second.get();
+    }
+    std::shared_ptr<UnitInfo> info(new UnitInfo);
+    info->setUp(*command, 0, nullptr, (int)mTraceInfos.size());
+    mTraceInfos.insert(std::make_pair(command, info));
+    return info.get();
+}
+
+static ErrorCode _executeCommand(const Command& cmd, TraceRecorder::Ring* ring, const OperatorInfo* info) {
+    if (nullptr == ring) {
+        return cmd.execution->onExecute(cmd.workInputs, cmd.workOutputs);
+    }
+    auto beginNs = TraceRecorder::now();
+    auto code = cmd.execution->onExecute(cmd.workInputs, cmd.workOutputs);
+    auto endNs = TraceRecorder::now();
+    uint64_t bytes = 0;
+    for (auto t : cmd.workInputs) {
+        bytes += nullptr != t ? (uint64_t)TensorUtils::getRawSize(t) * t->getType().bytes() : 0;
+    }
+    for (auto t : cmd.workOutputs) {
+        bytes += nullptr != t ? (uint64_t)TensorUtils::getRawSize(t) * t->getType().bytes() : 0;
+    }
+    TraceRecorder::record(ring, TraceRecorder::COMMAND, beginNs, endNs, bytes, info->flops(), EnumNameOpType(cmd.op->type()), info->name().c_str());
+    return code;
+}
+
 ErrorCode Pipeline::execute() {
     _copyInputs();
     auto enterCode = _enterExecute();
@@ -1135,6 +1381,59 @@ ErrorCode Pipeline::execute() {
     }
     auto& mBackend = mInfo.first.cache.first;
     auto& mBackupBackend = mInfo.first.cache.second;
+    auto ring = TraceRecorder::sample();
+    TraceRecorder::Scope _traceScope(ring);
+    if (!mLevels.empty()) {
+        auto cpuBn = static_cast<CPUBackend*>(mBackend.get());
+        std::vector<ErrorCode> codes;
+        std::vector<const OperatorInfo*> infos;
+        for (auto& level : mLevels) {
+            if (level.size() == 1) {
+                auto& cmd = *level[0];
+                auto code = _executeCommand(cmd, ring, nullptr != ring ? _traceInfo(level[0]) : nullptr);
+                if (NO_ERROR != code) {
+                    _exitExecute();
+                    return code;
+                }
+                continue;
+            }
+            codes.assign(level.size(), NO_ERROR);
+            infos.assign(level.size(), nullptr);
+            for (int i = 0; nullptr != ring && i < level.size(); ++i) {
+                infos[i] = _traceInfo(level[i]);
+            }
+            cpuBn->runConcurrently([&](int i) {
+                TraceRecorder::Scope _laneScope(ring);
+                auto& cmd = *level[i];
+                codes[i] = _executeCommand(cmd, ring, infos[i]);
+            }, (int)level.size());
+            for (auto code : codes) {
+                if (NO_ERROR != code) {
+                    _exitExecute();
+                    return code;
+                }
+            }
+        }
+        _exitExecute();
+        return NO_ERROR;
+    }
+    // Streaming weights: keep the next window executions prefetched and release each one after it runs
+    int prefetchWindow = mRuntime->hint().weightPrefetchWindow;
+    std::vector<std::pair<const Op*, Backend*>> streams;
+    if (prefetchWindow > 0) {
+        for (auto& info : mInfo.second) {
+            if (info.type == Schedule::CONSTANT) {
+                continue;
+            }
+            for (auto& cmd : info.executeBuffer.command) {
+                streams.emplace_back(cmd->op, cmd->execution->backend());
+            }
+        }
+        for (int i=0; i<prefetchWindow && i<streams.size(); ++i) {
+            streams[i].second->onPrefetch(streams[i].first, false);
+        }
+    }
+    int streamIndex = 0;
     for (auto& info : mInfo.second) {
         if (info.type == Schedule::CONSTANT) {
             continue;
@@ -1142,6 +1441,13 @@ ErrorCode Pipeline::execute() {
         auto& buffer = info.executeBuffer;
         for (int cmdIndex=0; cmdIndex<buffer.command.size(); ++cmdIndex) {
             auto& cmd = *buffer.command[cmdIndex];
+            if (prefetchWindow > 0) {
+                auto next = streamIndex + prefetchWindow;
+                if (next < streams.size()) {
+                    streams[next].second->onPrefetch(streams[next].first, false);
+                }
+                streamIndex++;
+            }
 #ifdef MNN_PIPELINE_DEBUG
             if (info.op->name() != nullptr) {
                 std::string groupOfInput = "input group: [";
@@ -1162,11 +1468,14 @@ ErrorCode Pipeline::execute() {
                 MNN_PRINT("Group: %d, %s - %d, type=%s, inputs: %s, devices: %s - %s\n", info.group, info.op->name()->c_str(), cmdIndex, EnumNameOpType(cmd.op->type()), groupOfInput.c_str(), deviceOfInput.c_str(), deviceOfOutput.c_str());
             }
 #endif
-            auto code = cmd.execution->onExecute(cmd.workInputs, cmd.workOutputs);
+            auto code = _executeCommand(cmd, ring, nullptr != ring ? _traceInfo(buffer.command[cmdIndex].get()) : nullptr);
             if (NO_ERROR != code) {
                 _exitExecute();
                 return code;
             }
+            if (prefetchWindow > 0) {
+                cmd.execution->backend()->onPrefetch(cmd.op, true);
+            }
         }
     }
     _exitExecute();
@@ -1200,36 +1509,45 @@ ErrorCode Pipeline::executeCallBack(const TensorCallBackWithInfo& before, const
     }
     auto& mBackend = mInfo.first.cache.first;
     auto& mBackupBackend = mInfo.first.cache.second;
-    for (auto& info : mInfo.second) {
-        if (info.type == Schedule::CONSTANT) {
-            continue;
-        }
-        auto& buffer = info.executeBuffer;
-        for (int cmdIndex=0; cmdIndex < buffer.command.size(); ++cmdIndex) {
-            auto cmdP = buffer.command[cmdIndex];
-            auto& cmd = *cmdP;
-            if (nullptr == cmd.info.get()) {
-                auto code = cmd.execution->onExecute(cmd.workInputs, cmd.workOutputs);
-                if (NO_ERROR != code) {
-                    _exitExecute();
-                    return code;
-                }
+    // The memory is planned in the order of the levels if they are built, run one by one in that order
+    std::vector<Command*> commands;
+    if (mLevels.empty()) {
+        for (auto& info : mInfo.second) {
+            if (info.type == Schedule::CONSTANT) {
                 continue;
             }
-            auto run = before(cmd.workInputs, cmd.info.get());
-            if (run) {
-                auto code = cmd.execution->onExecute(cmd.workInputs, cmd.workOutputs);
-                if (NO_ERROR != code) {
-                    _exitExecute();
-                    return code;
-                }
+            for (auto& cmdP : info.executeBuffer.command) {
+                commands.emplace_back(cmdP.get());
+            }
+        }
+    } else {
+        for (auto& level : mLevels) {
+            commands.insert(commands.end(), level.begin(), level.end());
+        }
+    }
+    for (auto cmdP : commands) {
+        auto& cmd = *cmdP;
+        if (nullptr == cmd.info.get()) {
+            auto code = cmd.execution->onExecute(cmd.workInputs, cmd.workOutputs);
+            if (NO_ERROR != code) {
+                _exitExecute();
+                return code;
             }
-            auto stop = !(after(cmd.workOutputs, cmd.info.get()));
-            if (stop) {
+            continue;
+        }
+        auto run = before(cmd.workInputs, cmd.info.get());
+        if (run) {
+            auto code = cmd.execution->onExecute(cmd.workInputs, cmd.workOutputs);
+            if (NO_ERROR != code) {
                 _exitExecute();
-                return CALL_BACK_STOP;
+                return code;
             }
         }
+        auto stop = !(after(cmd.workOutputs, cmd.info.get()));
+        if (stop) {
+            _exitExecute();
+            return CALL_BACK_STOP;
+        }
     }
     _exitExecute();
     return NO_ERROR;
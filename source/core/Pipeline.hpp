@@ -65,11 +65,15 @@ public:
     typedef std::map<std::pair<Tensor::InsideDescribe::NativeInsideDescribe*, Backend*>, std::pair<std::weak_ptr<Tensor::InsideDescribe::NativeInsideDescribe>, std::shared_ptr<Tensor>>> WrapTensorCache;
 private:
     ErrorCode _allocForTensor(int index, bool allocInput);
+    ErrorCode _resizeCommand(Command& iter, int index, bool allocInput);
+    void _buildLevels();
+    void _splitLevels();
     ErrorCode _enterExecute();
     void _exitExecute();
     void _copyInputs();
     void _pushTuningTask(std::vector<Schedule::OpCacheInfo>&& initInfos);
     void _recycleDynamicMemory(Command* command);
+    const OperatorInfo* _traceInfo(Command* command);
     Schedule::PipelineInfo mInfo;
     bool mAllocInput;
     bool mOutputStatic;
@@ -87,6 +91,11 @@ private:
 #endif
     const Runtime* mRuntime;
     const Runtime* mCpuRuntime;
+    // Runtime hint cpuInterOpParallel: commands in dependency levels, the commands of a level don't depend on each
+    // other and run concurrently, levels run in order. Memory is planned in this order. Empty means in mInfo order
+    std::vector<std::vector<Command*>> mLevels;
+    // Name and flops of the commands recorded by the tracer without debug info, cleared when commands change
+    std::map<const Command*, std::shared_ptr<UnitInfo>> mTraceInfos;
     std::string mExternalFile;
     std::vector<std::shared_ptr<BufferStorage>> mExternalStorage;
 };
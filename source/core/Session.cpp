@@ -97,6 +97,9 @@ void Session::ModeGroup::setHint(Interpreter::HintMode hint, int value) {
         case Interpreter::HintMode::KVCACHE_SIZE_LIMIT:
             runtimeHint.kvcacheSizeLimit = value;
             break;
+        case Interpreter::HintMode::KVCACHE_PAGED:
+            runtimeHint.kvcachePaged = value;
+            break;
         case Interpreter::HintMode::OP_ENCODER_NUMBER_FOR_COMMIT:
             runtimeHint.encorderNumForCommit = value;
             break;
@@ -121,6 +124,30 @@ void Session::ModeGroup::setHint(Interpreter::HintMode hint, int value) {
         case Interpreter::CPU_SME_CORES:
             runtimeHint.smeCores = value;
             break;
+        case Interpreter::HintMode::CPU_TASK_PRIORITY:
+            runtimeHint.cpuTaskPriority = value;
+            break;
+        case Interpreter::HintMode::CPU_CORE_BUDGET:
+            runtimeHint.cpuCoreBudget = value;
+            break;
+        case Interpreter::HintMode::MAP_MODEL_FILE:
+            runtimeHint.mapModelFile = value;
+            break;
+        case Interpreter::HintMode::WEIGHT_PREFETCH_WINDOW:
+            runtimeHint.weightPrefetchWindow = value;
+            break;
+        case Interpreter::HintMode::STATIC_MODULE_PLAN_CACHE:
+            runtimeHint.staticModulePlanCache = value;
+            break;
+        case Interpreter::HintMode::CPU_INTER_OP_PARALLEL:
+            runtimeHint.cpuInterOpParallel = value;
+            break;
+        case Interpreter::HintMode::CPU_NUMA_NODE:
+            runtimeHint.numaNode = value;
+            break;
+        case Interpreter::HintMode::CPU_NUMA_REPLICATE_WEIGHT:
+            runtimeHint.numaReplicateWeight = value;
+            break;
         default:
             break;
     }
@@ -396,6 +423,30 @@ bool Session::getInfo(Interpreter::SessionInfoCode code, void* ptr) const {
             *dst = mPipelines[0]->getPipelineInfo().first.info.numThread;
             return true;
         }
+        case Interpreter::THREAD_POOL_QUEUE_DELAY: {
+            for (auto& r : mRuntime.first) {
+                if (r.second->onGetQueueDelay((float*)ptr)) {
+                    return true;
+                }
+            }
+            break;
+        }
+        case Interpreter::HUGE_PAGES: {
+            for (auto& r : mRuntime.first) {
+                if (r.second->onGetHugePages((int*)ptr)) {
+                    return true;
+                }
+            }
+            break;
+        }
+        case Interpreter::WEIGHT_PREFETCH: {
+            for (auto& r : mRuntime.first) {
+                if (r.second->onGetWeightPrefetch((int*)ptr)) {
+                    return true;
+                }
+            }
+            break;
+        }
         // TODO: Support other debug info
         default:
             break;
@@ -523,6 +574,13 @@ Session* Session::clone(RuntimeInfo&& runtime, std::shared_ptr<Schedule::Schedul
     createPipelineBackend(pipelineInfo, runtime);
     auto first  = pipelineInfo.first.cache.first;
     auto second = pipelineInfo.first.cache.second;
+    // Executions recreated from the ops instead of cloned own a copy of the weights on the new NUMA node
+    bool replicateWeight = false;
+    auto dstRuntime = first->getRuntime();
+    auto srcRuntime = mPipelines[0]->getPipelineInfo().first.cache.first->getRuntime();
+    if (nullptr != dstRuntime && nullptr != srcRuntime) {
+        replicateWeight = dstRuntime->hint().numaReplicateWeight > 0 && dstRuntime->hint().numaNode != srcRuntime->hint().numaNode;
+    }
     for (int i = 0; i < opCaches.size(); ++i) {
         auto& srcOpInfo = opCaches[i];
         auto& opInfo    = oplists[i];
@@ -552,17 +610,19 @@ Session* Session::clone(RuntimeInfo&& runtime, std::shared_ptr<Schedule::Schedul
             TensorUtils::getDescribe(opInfo.outputs[j])->usage = TensorUtils::getDescribe(srcOpInfo.outputs[j])->usage;
         }
         // Clone cache
-        for (auto& iter : srcOpInfo.executionCache) {
-            Execution* copyExecution = nullptr;
-            bool valid               = false;
-            if (first->type() == iter.second->backend()->type()) {
-                valid = iter.second->onClone(first.get(), iter.first, &copyExecution);
-            } else {
-                valid = iter.second->onClone(second.get(), iter.first, &copyExecution);
-            }
-            if (valid) {
-                std::shared_ptr<Execution> copyExeWrap(copyExecution);
-                opInfo.executionCache.insert(std::make_pair(iter.first, copyExeWrap));
+        if (!replicateWeight) {
+            for (auto& iter : srcOpInfo.executionCache) {
+                Execution* copyExecution = nullptr;
+                bool valid               = false;
+                if (first->type() == iter.second->backend()->type()) {
+                    valid = iter.second->onClone(first.get(), iter.first, &copyExecution);
+                } else {
+                    valid = iter.second->onClone(second.get(), iter.first, &copyExecution);
+                }
+                if (valid) {
+                    std::shared_ptr<Execution> copyExeWrap(copyExecution);
+                    opInfo.executionCache.insert(std::make_pair(iter.first, copyExeWrap));
+                }
             }
         }
     }
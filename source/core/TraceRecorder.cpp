@@ -0,0 +1,187 @@
+//
+//  TraceRecorder.cpp
+//  MNN
+//
+//  Created by MNN on 2026/10/16.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <MNN/AutoTime.hpp>
+#include "core/TraceRecorder.hpp"
+#include "core/Macro.h"
+
+namespace MNN {
+std::atomic<bool> TraceRecorder::gStarted(false);
+std::atomic<TraceRecorder::Ring*> TraceRecorder::gRing(nullptr);
+static std::atomic<int> gSampleInterval(1);
+static std::atomic<uint64_t> gSampleCount(0);
+static std::atomic<int> gThreadCount(0);
+static thread_local TraceRecorder::Ring* gCurrentRing = nullptr;
+static thread_local int gThreadId = -1;
+static std::mutex gTracerLock;
+
+uint64_t TraceRecorder::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TraceRecorder::Ring* TraceRecorder::sample() {
+    auto ring = get();
+    if (nullptr == ring) {
+        return nullptr;
+    }
+    auto interval = gSampleInterval.load(std::memory_order_relaxed);
+    if (interval <= 1 || 0 == gSampleCount.fetch_add(1, std::memory_order_relaxed) % interval) {
+        return ring;
+    }
+    return nullptr;
+}
+
+TraceRecorder::Ring* TraceRecorder::current() {
+    if (!gStarted.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return gCurrentRing;
+}
+
+void TraceRecorder::record(Ring* ring, Kind kind, uint64_t beginNs, uint64_t endNs, uint64_t value, float number,
+                           const char* type, const char* name) {
+    if (gThreadId < 0) {
+        gThreadId = gThreadCount.fetch_add(1);
+    }
+    auto index = ring->head.fetch_add(1, std::memory_order_relaxed);
+    auto& event = ring->events[index & ring->mask];
+    // Odd while writing, the reader takes the event only if the sequence is 2 * index + 2 before and after copying
+    event.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.kind = kind;
+    event.tid = gThreadId;
+    event.beginNs = beginNs;
+    event.endNs = endNs;
+    event.value = value;
+    event.number = number;
+    event.type = type;
+    if (nullptr != name) {
+        strncpy(event.name, name, sizeof(event.name) - 1);
+        event.name[sizeof(event.name) - 1] = 0;
+    } else {
+        event.name[0] = 0;
+    }
+    event.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+TraceRecorder::Scope::Scope(Ring* ring) {
+    mPrevious = gCurrentRing;
+    gCurrentRing = ring;
+}
+
+TraceRecorder::Scope::~Scope() {
+    gCurrentRing = mPrevious;
+}
+
+void Tracer::start(int capacity, int sampleInterval) {
+    std::lock_guard<std::mutex> _l(gTracerLock);
+    uint64_t size = 16;
+    while (size < (uint64_t)capacity) {
+        size *= 2;
+    }
+    auto ring = TraceRecorder::gRing.load();
+    if (nullptr == ring || ring->mask + 1 != size) {
+        // Writers that saw the previous ring may still write to it, so it is never freed
+        ring = new TraceRecorder::Ring;
+        ring->events = new TraceRecorder::Event[size]();
+        ring->mask = size - 1;
+    }
+    ring->head.store(0);
+    ring->startNs = TraceRecorder::now();
+    gSampleInterval = ALIMAX(sampleInterval, 1);
+    gSampleCount = 0;
+    TraceRecorder::gRing.store(ring, std::memory_order_release);
+    TraceRecorder::gStarted = true;
+}
+
+void Tracer::stop() {
+    TraceRecorder::gStarted = false;
+}
+
+bool Tracer::isStarted() {
+    return TraceRecorder::gStarted;
+}
+
+static void _writeName(FILE* f, const char* name) {
+    for (auto c = name; *c != 0; ++c) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', f);
+            fputc(*c, f);
+        } else if ((unsigned char)*c >= 0x20) {
+            fputc(*c, f);
+        }
+    }
+}
+
+bool Tracer::dump(const char* path) {
+    std::lock_guard<std::mutex> _l(gTracerLock);
+    auto f = fopen(path, "w");
+    if (nullptr == f) {
+        MNN_ERROR("Can't open %s to dump trace\n", path);
+        return false;
+    }
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    auto ring = TraceRecorder::gRing.load();
+    bool first = true;
+    if (nullptr != ring) {
+        auto head = ring->head.load();
+        auto size = ring->mask + 1;
+        for (uint64_t index = head > size ? head - size : 0; index < head; ++index) {
+            auto& slot = ring->events[index & ring->mask];
+            auto sequence = slot.sequence.load(std::memory_order_acquire);
+            TraceRecorder::Event event;
+            event.kind = slot.kind;
+            event.tid = slot.tid;
+            event.beginNs = slot.beginNs;
+            event.endNs = slot.endNs;
+            event.value = slot.value;
+            event.number = slot.number;
+            event.type = slot.type;
+            ::memcpy(event.name, slot.name, sizeof(event.name));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence != 2 * index + 2 || slot.sequence.load(std::memory_order_relaxed) != sequence || event.beginNs < ring->startNs) {
+                continue;
+            }
+            event.name[sizeof(event.name) - 1] = 0;
+            double ts = (double)(event.beginNs - ring->startNs) / 1000.0;
+            double dur = (double)(event.endNs - event.beginNs) / 1000.0;
+            fprintf(f, "%s\n", first ? "" : ",");
+            first = false;
+            switch (event.kind) {
+                case TraceRecorder::COMMAND:
+                    fprintf(f, "{\"name\":\"");
+                    _writeName(f, event.name);
+                    fprintf(f, "\",\"cat\":\"op\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                            "\"args\":{\"type\":\"%s\",\"mflops\":%f,\"bytes\":%llu}}",
+                            event.tid, ts, dur, nullptr != event.type ? event.type : "", event.number, (unsigned long long)event.value);
+                    break;
+                case TraceRecorder::ALLOC:
+                case TraceRecorder::FREE:
+                    fprintf(f, "{\"name\":\"%s\",\"cat\":\"memory\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,"
+                            "\"args\":{\"bytes\":%llu}}",
+                            event.kind == TraceRecorder::ALLOC ? "alloc" : "free", event.tid, ts, (unsigned long long)event.value);
+                    break;
+                default:
+                    fprintf(f, "{\"name\":\"parallel\",\"cat\":\"thread_pool\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                            "\"args\":{\"threads\":%d,\"wait_us\":%.3f}}",
+                            event.tid, ts, dur, (int)event.number, (double)event.value / 1000.0);
+                    break;
+            }
+        }
+    }
+    fprintf(f, "\n]}\n");
+    bool res = 0 == ferror(f);
+    fclose(f);
+    return res;
+}
+} // namespace MNN
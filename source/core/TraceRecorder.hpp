@@ -0,0 +1,88 @@
+//
+//  TraceRecorder.hpp
+//  MNN
+//
+//  Created by MNN on 2026/10/16.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#ifndef TraceRecorder_hpp
+#define TraceRecorder_hpp
+
+#include <stdint.h>
+#include <atomic>
+
+namespace MNN {
+/**
+ Backend of MNN::Tracer. Keeps the latest events in a ring, writers never lock: each takes a slot by an atomic
+ counter and publishes it by the slot's sequence number, so that dumping skips the slots being overwritten.
+ */
+class TraceRecorder {
+public:
+    enum Kind {
+        // A command run by a pipeline
+        COMMAND = 0,
+        // Memory taken from / returned to a root allocator
+        ALLOC = 1,
+        FREE = 2,
+        // A parallel region of the thread pool
+        PARALLEL = 3,
+    };
+    struct Event {
+        std::atomic<uint64_t> sequence;
+        int kind;
+        int tid;
+        uint64_t beginNs;
+        uint64_t endNs;
+        // COMMAND: bytes of inputs and outputs, ALLOC / FREE: size, PARALLEL: ns before another thread joined
+        uint64_t value;
+        // COMMAND: flops in M, PARALLEL: number of threads
+        float number;
+        // Static string, the op type of COMMAND
+        const char* type;
+        char name[48];
+    };
+    struct Ring {
+        Event* events;
+        uint64_t mask;
+        uint64_t startNs;
+        std::atomic<uint64_t> head;
+    };
+
+    // The ring if the tracer is started, for the events not bound to an execution
+    static Ring* get() {
+        return gStarted.load(std::memory_order_relaxed) ? gRing.load(std::memory_order_acquire) : nullptr;
+    }
+    // The ring if the tracer is started and the execution is sampled, called once per execution
+    static Ring* sample();
+    // The ring of the execution run by the calling thread, set by Scope
+    static Ring* current();
+    static uint64_t now();
+
+    static void record(Ring* ring, Kind kind, uint64_t beginNs, uint64_t endNs, uint64_t value, float number,
+                       const char* type, const char* name);
+    static void recordMemory(Kind kind, uint64_t size) {
+        auto ring = get();
+        if (nullptr != ring) {
+            auto t = now();
+            record(ring, kind, t, t, size, 0.0f, nullptr, nullptr);
+        }
+    }
+
+    // Marks the calling thread as running a sampled execution, so that the thread pool records its regions
+    class Scope {
+    public:
+        Scope(Ring* ring);
+        ~Scope();
+    private:
+        Ring* mPrevious;
+    };
+
+private:
+    friend class Tracer;
+    static std::atomic<bool> gStarted;
+    static std::atomic<Ring*> gRing;
+};
+} // namespace MNN
+
+#endif /* TraceRecorder_hpp */
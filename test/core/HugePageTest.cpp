@@ -0,0 +1,125 @@
+//
+//  HugePageTest.cpp
+//  MNNTests
+//
+//  Created by MNN on 2026/10/16.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#ifdef __linux__
+#include <math.h>
+#include <string.h>
+#include <MNN/expr/Module.hpp>
+#include <MNN/expr/ExprCreator.hpp>
+#include <MNN/expr/ExecutorScope.hpp>
+#include "MNNTestSuite.h"
+#include "core/BufferAllocator.hpp"
+
+using namespace MNN;
+using namespace MNN::Express;
+
+class HugePageTest : public MNNTestCase {
+public:
+    virtual ~HugePageTest() = default;
+    bool testAllocator() {
+        const size_t hugePage = 2 * 1024 * 1024;
+        auto allocator = BufferAllocator::Allocator::createHugePage();
+        std::vector<MemChunk> chunks;
+        // 5MB takes 3 huge pages, 1KB takes 1
+        for (size_t size : {(size_t)5 * 1024 * 1024, (size_t)1024}) {
+            auto chunk = allocator->onAlloc(size, 64);
+            if (nullptr == chunk.first) {
+                MNN_ERROR("HugePageTest alloc %lu failed\n", size);
+                return false;
+            }
+            if ((size_t)chunk.first % hugePage != 0) {
+                MNN_ERROR("HugePageTest chunk %p is not 2MB aligned\n", chunk.first);
+                return false;
+            }
+            ::memset(chunk.first, 1, size);
+            chunks.emplace_back(chunk);
+        }
+        size_t pages[2];
+        if (!allocator->onGetHugePages(pages)) {
+            MNN_ERROR("HugePageTest can't report huge pages\n");
+            return false;
+        }
+        // madvise fails if the kernel is built without transparent huge pages
+        if (pages[0] != 4 && pages[0] != 0) {
+            MNN_ERROR("HugePageTest advised %lu pages\n", pages[0]);
+            return false;
+        }
+        if (pages[1] > pages[0]) {
+            MNN_ERROR("HugePageTest got %lu pages of %lu\n", pages[1], pages[0]);
+            return false;
+        }
+        MNN_PRINT("HugePageTest: %lu huge pages advised, %lu backed\n", pages[0], pages[1]);
+        for (auto& chunk : chunks) {
+            allocator->onRelease(chunk);
+        }
+        allocator->onGetHugePages(pages);
+        if (pages[0] != 0 || pages[1] != 0) {
+            MNN_ERROR("HugePageTest keeps %lu / %lu pages after release\n", pages[0], pages[1]);
+            return false;
+        }
+        return !BufferAllocator::Allocator::createDefault()->onGetHugePages(pages);
+    }
+    // Weights and feature maps in huge pages, the results don't change
+    bool testRuntime() {
+        auto x = _Input({1, 16, 32, 32}, NC4HW4);
+        x->setName("x");
+        std::vector<float> weight(16 * 32 * 3 * 3), bias(32, 0.1f);
+        for (int i = 0; i < weight.size(); ++i) {
+            weight[i] = (float)(i % 17 - 8) / 17.0f;
+        }
+        auto y = _Conv(std::move(weight), std::move(bias), x, {16, 32}, {3, 3}, SAME);
+        y = _Convert(_Relu(y), NCHW);
+        y->setName("y");
+        auto buffer = Variable::save({y});
+        std::shared_ptr<Module> modules[2];
+        std::shared_ptr<Executor::RuntimeManager> rtMgrs[2];
+        for (int i = 0; i < 2; ++i) {
+            // Runtime managers of one executor share the cpu runtime, use one executor each
+            BackendConfig bnConfig;
+            std::shared_ptr<Executor> executor(Executor::newExecutor(MNN_FORWARD_CPU, bnConfig, 2));
+            ExecutorScope scope(executor);
+            ScheduleConfig config;
+            config.numThread = 2;
+            rtMgrs[i].reset(Executor::RuntimeManager::createRuntimeManager(config), Executor::RuntimeManager::destroy);
+            rtMgrs[i]->setHint(Interpreter::MEM_ALLOCATOR_TYPE, i * 2);
+            modules[i].reset(Module::load({"x"}, {"y"}, (const uint8_t*)buffer.data(), buffer.size(), rtMgrs[i]), Module::destroy);
+        }
+        auto input = _Input({1, 16, 32, 32}, NCHW);
+        auto ptr = input->writeMap<float>();
+        for (int i = 0; i < 16 * 32 * 32; ++i) {
+            ptr[i] = (float)(i % 13) / 13.0f;
+        }
+        input = _Convert(input, NC4HW4);
+        auto expect = modules[0]->onForward({input})[0];
+        auto got = modules[1]->onForward({input})[0];
+        auto e = expect->readMap<float>();
+        auto g = got->readMap<float>();
+        auto size = expect->getInfo()->size;
+        for (int i = 0; i < size; ++i) {
+            if (fabsf(e[i] - g[i]) > 1e-5f) {
+                MNN_ERROR("HugePageTest index %d: expect %f, got %f\n", i, e[i], g[i]);
+                return false;
+            }
+        }
+        int pages[2] = {0, 0};
+        if (rtMgrs[0]->getInfo(Interpreter::HUGE_PAGES, pages)) {
+            MNN_ERROR("HugePageTest reports huge pages for the default allocator\n");
+            return false;
+        }
+        if (!rtMgrs[1]->getInfo(Interpreter::HUGE_PAGES, pages) || pages[1] > pages[0]) {
+            MNN_ERROR("HugePageTest runtime reports %d / %d huge pages\n", pages[1], pages[0]);
+            return false;
+        }
+        return true;
+    }
+    virtual bool run(int precision) {
+        return testAllocator() && testRuntime();
+    }
+};
+MNNTestSuiteRegister(HugePageTest, "core/huge_page");
+#endif
@@ -0,0 +1,142 @@
+//
+//  NumaTest.cpp
+//  MNNTests
+//
+//  Created by MNN on 2026/10/16.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#ifdef __linux__
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <MNN/expr/Module.hpp>
+#include <MNN/expr/ExprCreator.hpp>
+#include "MNNTestSuite.h"
+#include "backend/cpu/CPURuntime.hpp"
+#include "core/BufferAllocator.hpp"
+
+using namespace MNN;
+using namespace MNN::Express;
+
+class NumaTest : public MNNTestCase {
+public:
+    virtual ~NumaTest() = default;
+    static bool _writeFile(const std::string& name, const char* content) {
+        auto f = fopen(name.c_str(), "w");
+        if (nullptr == f) {
+            return false;
+        }
+        fwrite(content, 1, strlen(content), f);
+        fclose(f);
+        return true;
+    }
+    // A dual socket machine with a memory only node, in a fake sysfs tree
+    bool testTopology() {
+        std::string root = "/tmp/mnn_numa_test_" + std::to_string(getpid());
+        std::string nodeDir = root + "/devices/system/node";
+        std::vector<std::string> dirs = {root, root + "/devices", root + "/devices/system", nodeDir,
+                                         nodeDir + "/node0", nodeDir + "/node1", nodeDir + "/node3", nodeDir + "/power"};
+        for (auto& dir : dirs) {
+            mkdir(dir.c_str(), 0755);
+        }
+        std::vector<std::pair<std::string, const char*>> files = {
+            {nodeDir + "/possible", "0-3\n"},
+            {nodeDir + "/node0/cpulist", "0-3,8-11\n"},
+            {nodeDir + "/node1/cpulist", "4-7,12,14-15\n"},
+            {nodeDir + "/node3/cpulist", "\n"},
+        };
+        bool res = true;
+        for (auto& file : files) {
+            res = res && _writeFile(file.first, file.second);
+        }
+        auto nodes = MNNReadNumaNodes(root.c_str());
+        for (auto& file : files) {
+            unlink(file.first.c_str());
+        }
+        for (auto iter = dirs.rbegin(); iter != dirs.rend(); ++iter) {
+            rmdir(iter->c_str());
+        }
+        if (!res) {
+            MNN_ERROR("Can't create the fake sysfs tree\n");
+            return false;
+        }
+        if (nodes.size() != 3 || nodes[0].id != 0 || nodes[1].id != 1 || nodes[2].id != 3) {
+            MNN_ERROR("NumaTest read %d nodes\n", (int)nodes.size());
+            return false;
+        }
+        if (nodes[0].cpus != std::vector<int>({0, 1, 2, 3, 8, 9, 10, 11}) ||
+            nodes[1].cpus != std::vector<int>({4, 5, 6, 7, 12, 14, 15}) || !nodes[2].cpus.empty()) {
+            MNN_ERROR("NumaTest read wrong cpus\n");
+            return false;
+        }
+        return MNNReadNumaNodes((root + "_not_exist").c_str()).empty();
+    }
+    bool testAllocator() {
+        // Binding fails silently for a node that doesn't exist
+        for (int node : {0, 1000}) {
+            auto allocator = BufferAllocator::Allocator::createNuma(node);
+            auto chunk = allocator->onAlloc(1 << 20, 64);
+            if (nullptr == chunk.first) {
+                MNN_ERROR("NumaTest alloc on node %d failed\n", node);
+                return false;
+            }
+            ::memset(chunk.first, 1, 1 << 20);
+            allocator->onRelease(chunk);
+        }
+        return true;
+    }
+    // Bound and replicated by clone, the results don't change
+    bool testRuntime() {
+        auto& nodes = MNNGetNumaNodes();
+        if (nodes.empty()) {
+            return true;
+        }
+        auto x = _Input({1, 8, 16, 16}, NC4HW4);
+        x->setName("x");
+        std::vector<float> weight(8 * 16 * 3 * 3), bias(16, 0.1f);
+        for (int i = 0; i < weight.size(); ++i) {
+            weight[i] = (float)(i % 17 - 8) / 17.0f;
+        }
+        auto y = _Conv(std::move(weight), std::move(bias), x, {8, 16}, {3, 3}, SAME);
+        y = _Convert(y, NCHW);
+        y->setName("y");
+        auto buffer = Variable::save({y});
+        ScheduleConfig config;
+        config.numThread = 2;
+        std::shared_ptr<Executor::RuntimeManager> origin(Executor::RuntimeManager::createRuntimeManager(config), Executor::RuntimeManager::destroy);
+        std::shared_ptr<Executor::RuntimeManager> bound(Executor::RuntimeManager::createRuntimeManager(config), Executor::RuntimeManager::destroy);
+        bound->setHint(Interpreter::CPU_NUMA_NODE, nodes[0].id);
+        bound->setHint(Interpreter::CPU_NUMA_REPLICATE_WEIGHT, 1);
+        std::shared_ptr<Module> net(Module::load({"x"}, {"y"}, (const uint8_t*)buffer.data(), buffer.size(), origin), Module::destroy);
+        std::shared_ptr<Module> loaded(Module::load({"x"}, {"y"}, (const uint8_t*)buffer.data(), buffer.size(), bound), Module::destroy);
+        std::shared_ptr<Module> cloned(Module::clone(net.get(), bound), Module::destroy);
+        auto input = _Input({1, 8, 16, 16}, NCHW);
+        auto ptr = input->writeMap<float>();
+        for (int i = 0; i < 8 * 16 * 16; ++i) {
+            ptr[i] = (float)(i % 13) / 13.0f;
+        }
+        input = _Convert(input, NC4HW4);
+        auto expect = net->onForward({input})[0];
+        auto e = expect->readMap<float>();
+        auto size = expect->getInfo()->size;
+        for (auto module : {loaded, cloned}) {
+            auto got = module->onForward({input})[0];
+            auto g = got->readMap<float>();
+            for (int i = 0; i < size; ++i) {
+                if (fabsf(e[i] - g[i]) > 1e-5f) {
+                    MNN_ERROR("NumaTest index %d: expect %f, got %f\n", i, e[i], g[i]);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    virtual bool run(int precision) {
+        return testTopology() && testAllocator() && testRuntime();
+    }
+};
+MNNTestSuiteRegister(NumaTest, "core/numa");
+#endif
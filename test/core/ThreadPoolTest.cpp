@@ -8,6 +8,8 @@
 
 #ifdef MNN_USE_THREAD_POOL
 #include <MNN/MNNDefine.h>
+#include <atomic>
+#include <chrono>
 #include "MNNTestSuite.h"
 #include "backend/cpu/ThreadPool.hpp"
 
@@ -44,4 +46,134 @@ public:
 };
 
 MNNTestSuiteRegister(ThreadPoolTest, "core/threadpool");
+
+class ThreadPoolStealTest : public MNNTestCase {
+public:
+    virtual ~ThreadPoolStealTest() = default;
+    virtual bool run(int precision) {
+        MNN::ThreadPool* threadPool = nullptr;
+        int threadNumber = MNN::ThreadPool::init(4, 0, threadPool);
+        auto workIndex = threadPool->acquireWorkIndex();
+        threadPool->active();
+        bool pass = true;
+        // Uneven work: the first indices are much slower, each index must still run exactly once
+        for (int workSize : {2, 4, 7, 64, 1000}) {
+            for (int round = 0; round < 20 && pass; ++round) {
+                std::vector<std::atomic_int> counts(workSize);
+                for (auto& c : counts) {
+                    c = 0;
+                }
+                ThreadPool::TASK task = std::make_pair([&](int index) {
+                    if (index < threadNumber) {
+                        std::this_thread::sleep_for(std::chrono::microseconds(200));
+                    }
+                    counts[index]++;
+                }, workSize);
+                threadPool->enqueue(&task, workIndex);
+                for (int i = 0; i < workSize; ++i) {
+                    if (counts[i] != 1) {
+                        MNN_ERROR("Index %d of %d runs %d times\n", i, workSize, (int)counts[i]);
+                        pass = false;
+                        break;
+                    }
+                }
+            }
+        }
+        threadPool->deactive();
+        threadPool->releaseWorkIndex(workIndex);
+        // Fewer parts than threads: the idle threads outnumber the ranges and may only steal
+        MNN::ThreadPool* widePool = nullptr;
+        MNN::ThreadPool::init(8, 1UL << 31, widePool);
+        workIndex = widePool->acquireWorkIndex();
+        widePool->active();
+        for (int workSize : {2, 3, 5}) {
+            for (int round = 0; round < 2000 && pass; ++round) {
+                std::vector<std::atomic_int> counts(workSize);
+                for (auto& c : counts) {
+                    c = 0;
+                }
+                ThreadPool::TASK task = std::make_pair([&](int index) {
+                    if (0 == index % 2) {
+                        std::this_thread::yield();
+                    }
+                    counts[index]++;
+                }, workSize);
+                widePool->enqueue(&task, workIndex);
+                for (int i = 0; i < workSize; ++i) {
+                    if (counts[i] != 1) {
+                        MNN_ERROR("Index %d of %d runs %d times with %d threads\n", i, workSize, (int)counts[i], widePool->numberThread());
+                        pass = false;
+                        break;
+                    }
+                }
+            }
+        }
+        widePool->deactive();
+        widePool->releaseWorkIndex(workIndex);
+        return pass;
+    }
+};
+
+MNNTestSuiteRegister(ThreadPoolStealTest, "core/threadpool_steal");
+
+class ThreadPoolTenantTest : public MNNTestCase {
+public:
+    virtual ~ThreadPoolTenantTest() = default;
+    virtual bool run(int precision) {
+        MNN::ThreadPool* threadPool = nullptr;
+        MNN::ThreadPool::init(4, 0, threadPool);
+        // More sessions than threads hold their work index at the same time
+        const int sessionNumber = 16;
+        const int rounds = 20;
+        std::atomic_int acquired(0);
+        std::atomic_bool pass(true);
+        std::vector<std::thread> threads;
+        for (int s = 0; s < sessionNumber; ++s) {
+            threads.emplace_back([&, s]() {
+                auto workIndex = threadPool->acquireWorkIndex();
+                if (workIndex < 0) {
+                    MNN_ERROR("Session %d can't acquire work index\n", s);
+                    pass = false;
+                    return;
+                }
+                threadPool->setWorkConfig(workIndex, s % 3, (s % 3) * 2);
+                acquired++;
+                while (acquired < sessionNumber && pass) {
+                    std::this_thread::yield();
+                }
+                threadPool->active();
+                for (int round = 0; round < rounds; ++round) {
+                    int workSize = 2 + (s * 7 + round * 13) % 50;
+                    std::vector<std::atomic_int> counts(workSize);
+                    for (auto& c : counts) {
+                        c = 0;
+                    }
+                    ThreadPool::TASK task = std::make_pair([&](int index) {
+                        counts[index]++;
+                    }, workSize);
+                    threadPool->enqueue(&task, workIndex);
+                    for (int i = 0; i < workSize; ++i) {
+                        if (counts[i] != 1) {
+                            MNN_ERROR("Session %d: index %d of %d runs %d times\n", s, i, workSize, (int)counts[i]);
+                            pass = false;
+                        }
+                    }
+                }
+                auto stats = threadPool->getWorkStats(workIndex);
+                if (stats.regions != rounds || stats.unhelped > stats.regions || stats.maxQueueDelayUs < 0) {
+                    MNN_ERROR("Session %d: invalid stats, regions %d\n", s, (int)stats.regions);
+                    pass = false;
+                }
+                threadPool->deactive();
+                threadPool->releaseWorkIndex(workIndex);
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        return pass;
+    }
+};
+
+MNNTestSuiteRegister(ThreadPoolTenantTest, "core/threadpool_tenant");
 #endif
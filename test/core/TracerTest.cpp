@@ -0,0 +1,127 @@
+//
+//  TracerTest.cpp
+//  MNNTests
+//
+//  Created by MNN on 2026/10/16.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <MNN/AutoTime.hpp>
+#include <MNN/expr/Module.hpp>
+#include <MNN/expr/ExprCreator.hpp>
+#include "MNNTestSuite.h"
+
+using namespace MNN;
+using namespace MNN::Express;
+
+class TracerTest : public MNNTestCase {
+public:
+    virtual ~TracerTest() = default;
+    static std::string _readFile(const std::string& name) {
+        std::string res;
+        auto f = fopen(name.c_str(), "r");
+        if (nullptr == f) {
+            return res;
+        }
+        char buffer[4096];
+        size_t size;
+        while ((size = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+            res.append(buffer, size);
+        }
+        fclose(f);
+        return res;
+    }
+    static int _count(const std::string& content, const std::string& key) {
+        int res = 0;
+        for (auto pos = content.find(key); pos != std::string::npos; pos = content.find(key, pos + 1)) {
+            res++;
+        }
+        return res;
+    }
+    virtual bool run(int precision) {
+        auto x = _Input({1, 8, 16, 16}, NC4HW4);
+        x->setName("x");
+        std::vector<float> weight(8 * 16 * 3 * 3, 0.01f), bias(16, 0.1f);
+        auto y = _Conv(std::move(weight), std::move(bias), x, {8, 16}, {3, 3}, SAME);
+        y = _Convert(_Relu6(y), NCHW);
+        y->setName("y");
+        auto buffer = Variable::save({y});
+        ScheduleConfig config;
+        config.numThread = 2;
+        std::shared_ptr<Executor::RuntimeManager> rtMgr(Executor::RuntimeManager::createRuntimeManager(config), Executor::RuntimeManager::destroy);
+        auto input = _Input({1, 8, 16, 16}, NC4HW4);
+        ::memset(input->writeMap<float>(), 0, input->getInfo()->size * sizeof(float));
+        std::string path = "mnn_tracer_test.json";
+
+        // Load is traced for allocations, every forward for commands
+        Tracer::start();
+        std::shared_ptr<Module> net(Module::load({"x"}, {"y"}, (const uint8_t*)buffer.data(), buffer.size(), rtMgr), Module::destroy);
+        for (int i = 0; i < 4; ++i) {
+            net->onForward({input})[0]->readMap<float>();
+        }
+        Tracer::stop();
+        net->onForward({input})[0]->readMap<float>();
+        if (!Tracer::dump(path.c_str())) {
+            return false;
+        }
+        auto content = _readFile(path);
+        int commands = _count(content, "\"cat\":\"op\"");
+        if (content.find("{\"displayTimeUnit\"") != 0 || content.find("]}") == std::string::npos) {
+            MNN_ERROR("TracerTest writes a broken trace\n");
+            return false;
+        }
+        std::string convKey = "\"type\":\"Convolution\",\"mflops\":";
+        auto convPos = content.find(convKey);
+        if (commands == 0 || commands % 4 != 0 || _count(content, convKey) != 4 || _count(content, "\"name\":\"alloc\"") == 0 ||
+            atof(content.c_str() + convPos + convKey.size()) <= 0.0) {
+            MNN_ERROR("TracerTest records %d commands\n", commands);
+            return false;
+        }
+        // One execution of every 2 is recorded
+        Tracer::start(65536, 2);
+        for (int i = 0; i < 4; ++i) {
+            net->onForward({input})[0]->readMap<float>();
+        }
+        Tracer::dump(path.c_str());
+        content = _readFile(path);
+        if (_count(content, "\"cat\":\"op\"") != commands / 2) {
+            MNN_ERROR("TracerTest sampled %d commands, expect %d\n", _count(content, "\"cat\":\"op\""), commands / 2);
+            return false;
+        }
+        // The ring keeps the latest events, dump while other threads record
+        Tracer::start(16);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 2; ++t) {
+            threads.emplace_back([&]() {
+                std::shared_ptr<Module> local(Module::clone(net.get()), Module::destroy);
+                auto localInput = _Input({1, 8, 16, 16}, NC4HW4);
+                ::memset(localInput->writeMap<float>(), 0, localInput->getInfo()->size * sizeof(float));
+                for (int i = 0; i < 20; ++i) {
+                    local->onForward({localInput})[0]->readMap<float>();
+                }
+            });
+        }
+        bool res = true;
+        for (int i = 0; i < 10; ++i) {
+            res = res && Tracer::dump(path.c_str());
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        Tracer::stop();
+        res = res && Tracer::dump(path.c_str());
+        content = _readFile(path);
+        remove(path.c_str());
+        int events = _count(content, "\"ph\":");
+        if (!res || events == 0 || events > 16) {
+            MNN_ERROR("TracerTest keeps %d events in a ring of 16\n", events);
+            return false;
+        }
+        return !Tracer::isStarted() && !Tracer::dump("/not_exist_dir/trace.json");
+    }
+};
+MNNTestSuiteRegister(TracerTest, "core/tracer");
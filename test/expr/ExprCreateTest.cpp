@@ -0,0 +1,103 @@
+//
+//  ExprCreateTest.cpp
+//  MNNTests
+//
+//  Created by MNN on 2026/10/16.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#include <math.h>
+#include <thread>
+#include <MNN/AutoTime.hpp>
+#include <MNN/expr/ExprCreator.hpp>
+#include "MNNTestSuite.h"
+using namespace MNN::Express;
+
+// The small ops built again for every step of pre / post processing, eg: Llm::gen_attention_mask
+static VARP _buildStep(VARP x, int step) {
+    auto y = _Cast<float>(x);
+    y = _Unsqueeze(y, {0});
+    y = _Softmax(y, -1);
+    y = _Transpose(y, {0, 2, 1});
+    y = y * _Scalar<float>(0.5f) + _Scalar<float>((float)step);
+    return _ReduceSum(y, {1}, true);
+}
+
+class ExprInternTest : public MNNTestCase {
+public:
+    static bool _sameOp(VARP a, VARP b) {
+        return a->expr().first->extra().get() == b->expr().first->extra().get();
+    }
+    virtual bool run(int precision) {
+        auto x = _Input({4, 8}, NCHW);
+        auto xPtr = x->writeMap<float>();
+        for (int i = 0; i < 32; ++i) {
+            xPtr[i] = (float)(i % 7) / 7.0f;
+        }
+        // Same parameters share the op buffer, others don't
+        auto a = _Softmax(x, -1);
+        auto b = _Softmax(x, -1);
+        auto c = _Softmax(x, 0);
+        if (!_sameOp(a, b) || _sameOp(a, c)) {
+            MNN_ERROR("ExprInternTest softmax ops are not interned\n");
+            return false;
+        }
+        // Names are set on the expr, not the op buffer
+        a->setName("a");
+        if (!_sameOp(a, _Softmax(x, -1))) {
+            MNN_ERROR("ExprInternTest named op is not shared\n");
+            return false;
+        }
+        // A buffer freed by all its exprs is rebuilt
+        auto t = _Transpose(x, {1, 0});
+        auto storage = t->expr().first->extra();
+        t = nullptr;
+        storage = nullptr;
+        t = _Transpose(x, {1, 0});
+        if (nullptr == t->expr().first->extra() || nullptr == t->expr().first->get()) {
+            MNN_ERROR("ExprInternTest transpose op is lost\n");
+            return false;
+        }
+        // Ops interned by other threads compute the same
+        VARP fromThread;
+        std::thread worker([&]() {
+            fromThread = _buildStep(x, 3);
+        });
+        worker.join();
+        auto expect = _buildStep(x, 3);
+        auto e = expect->readMap<float>();
+        auto g = fromThread->readMap<float>();
+        for (int i = 0; i < expect->getInfo()->size; ++i) {
+            if (fabsf(e[i] - g[i]) > 1e-6f) {
+                MNN_ERROR("ExprInternTest index %d: expect %f, got %f\n", i, e[i], g[i]);
+                return false;
+            }
+        }
+        auto aPtr = a->readMap<float>();
+        auto cPtr = c->readMap<float>();
+        return nullptr != aPtr && nullptr != cPtr && fabsf(aPtr[0] - cPtr[0]) > 1e-6f;
+    }
+};
+MNNTestSuiteRegister(ExprInternTest, "expr/ExprIntern");
+
+class ExprCreateSpeed : public MNNTestCase {
+public:
+    virtual bool run(int precision) {
+        auto x = _Input({1, 16}, NCHW, halide_type_of<int>());
+        ::memset(x->writeMap<int>(), 0, 16 * sizeof(int));
+        const int steps = 20000;
+        // Warm up the allocators
+        for (int i = 0; i < 100; ++i) {
+            _buildStep(x, i);
+        }
+        MNN::Timer _t;
+        for (int i = 0; i < steps; ++i) {
+            _buildStep(x, i);
+        }
+        // Each step creates 9 exprs, two of them consts
+        float cost = (float)_t.durationInUs() / (float)(steps * 9);
+        MNN_PRINT("Expr create: %d steps, avg cost per expr: %f us\n", steps, cost);
+        return true;
+    }
+};
+MNNTestSuiteRegister(ExprCreateSpeed, "expr/ExprCreateSpeed");
@@ -0,0 +1,92 @@
+//
+//  InterOpParallelTest.cpp
+//  MNNTests
+//
+//  Created by MNN on 2026/10/16.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#include <math.h>
+#include <random>
+#include <MNN/expr/Module.hpp>
+#include <MNN/expr/ExprCreator.hpp>
+#include <MNN/expr/Executor.hpp>
+#include <MNN/expr/ExecutorScope.hpp>
+#include "MNNTestSuite.h"
+#include "TestUtils.h"
+using namespace MNN::Express;
+using namespace MNN;
+
+// Independent branches of matmul, conv, raster and unary / binary ops joined at the end
+static std::vector<int8_t> _buildBranches() {
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> dist(-0.1f, 0.1f);
+    auto x = _Input({64, 128}, NCHW);
+    x->setName("x");
+    std::vector<float> weight(128 * 128);
+    for (auto& v : weight) {
+        v = dist(rng);
+    }
+    auto w = _Const(weight.data(), {128, 128}, NCHW);
+    auto a = _MatMul(x, w);
+    auto b = _Sigmoid(x) * x;
+    auto c = _Transpose(x, {1, 0});
+    auto d = _Softmax(x, -1);
+    std::vector<float> convWeight(64 * 64), convBias(64, 0.01f);
+    for (auto& v : convWeight) {
+        v = dist(rng);
+    }
+    auto e = _Convert(_Reshape(x, {1, 64, 8, 16}), NC4HW4);
+    e = _Conv(std::move(convWeight), std::move(convBias), e, {64, 64}, {1, 1}, VALID, {1, 1}, {1, 1}, 1, {0, 0}, true);
+    e = _Reshape(_Convert(e, NCHW), {64, 128});
+    auto y0 = a + b * e;
+    y0->setName("y0");
+    auto y1 = _MatMul(c, d) + _Transpose(_MatMul(_Transpose(d, {1, 0}), _Transpose(c, {1, 0})), {1, 0});
+    y1->setName("y1");
+    return Variable::save({y0, y1});
+}
+
+class InterOpParallelTest : public MNNTestCase {
+public:
+    virtual bool run(int precision) {
+        auto buffer = _buildBranches();
+        std::shared_ptr<Module> modules[2];
+        for (int i = 0; i < 2; ++i) {
+            ScheduleConfig config;
+            config.numThread = 4;
+            std::vector<ScheduleConfig> configs = {config};
+            std::shared_ptr<Executor::RuntimeManager> rtMgr(Executor::RuntimeManager::createRuntimeManager(configs), Executor::RuntimeManager::destroy);
+            rtMgr->setHint(Interpreter::CPU_INTER_OP_PARALLEL, i);
+            modules[i].reset(Module::load({"x"}, {"y0", "y1"}, (const uint8_t*)buffer.data(), buffer.size(), rtMgr), Module::destroy);
+        }
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        // Run several times so that ops running together would show races on shared memory
+        for (int t = 0; t < 10; ++t) {
+            auto x = _Input({64, 128}, NCHW);
+            auto xPtr = x->writeMap<float>();
+            for (int i = 0; i < 64 * 128; ++i) {
+                xPtr[i] = dist(rng);
+            }
+            auto expect = modules[0]->onForward({x});
+            auto got    = modules[1]->onForward({x});
+            if (expect.size() != 2 || got.size() != 2) {
+                MNN_ERROR("InterOpParallelTest forward failed\n");
+                return false;
+            }
+            for (int o = 0; o < 2; ++o) {
+                auto size = expect[o]->getInfo()->size;
+                auto e = expect[o]->readMap<float>();
+                auto g = got[o]->readMap<float>();
+                for (int i = 0; i < size; ++i) {
+                    if (fabsf(e[i] - g[i]) > 1e-4f * (1.0f + fabsf(e[i]))) {
+                        MNN_ERROR("InterOpParallelTest output %d, index %d: expect %f, got %f\n", o, i, e[i], g[i]);
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+};
+MNNTestSuiteRegister(InterOpParallelTest, "expr/InterOpParallel");
@@ -8,10 +8,15 @@
 
 #include <MNN/expr/ExprCreator.hpp>
 #include <MNN/expr/Module.hpp>
+#include <MNN/Interpreter.hpp>
 #include "core/MNNFileUtils.h"
 #include "MNNTestSuite.h"
 #include "TestUtils.h"
 #include "MNN_generated.h"
+#ifndef _MSC_VER
+#include <dirent.h>
+#include <unistd.h>
+#endif
 
 using namespace MNN::Express;
 
@@ -58,3 +63,235 @@ public:
     }
 };
 MNNTestSuiteRegister(MMapTest, "expr/mmaptest");
+
+class MapModelFileTest : public MNNTestCase {
+public:
+    virtual bool run(int precision) {
+        auto executor = cloneCurrentExecutor();
+        ExecutorScope scope(executor);
+        auto x = _Input({1, 3, 16, 16}, NCHW, halide_type_of<float>());
+        x->setName("x");
+        auto y = _Conv(0.1f, 0.01f, x, {3, 8}, {3, 3});
+        y = _Convert(_Relu(y), NCHW);
+        y->setName("y");
+        const char* fileName = "mapmodel.mnn";
+        MNN::Express::Variable::save({y}, fileName);
+
+        ScheduleConfig config;
+        config.type = getCurrentType();
+        std::shared_ptr<Executor::RuntimeManager> rtm(Executor::RuntimeManager::createRuntimeManager(config));
+        std::shared_ptr<Module> readModule(Module::load({"x"}, {"y"}, fileName, rtm), Module::destroy);
+        std::shared_ptr<Executor::RuntimeManager> mapRtm(Executor::RuntimeManager::createRuntimeManager(config));
+        mapRtm->setHint(MNN::Interpreter::MAP_MODEL_FILE, 1);
+        std::shared_ptr<Module> mapModule(Module::load({"x"}, {"y"}, fileName, mapRtm), Module::destroy);
+        std::shared_ptr<MNN::Interpreter> net(MNN::Interpreter::createFromFile(fileName, true), MNN::Interpreter::destroy);
+        MNNRemoveFile(fileName);
+        if (nullptr == readModule || nullptr == mapModule || nullptr == net) {
+            MNN_ERROR("Load mapped model failed\n");
+            return false;
+        }
+        auto input = _Input({1, 3, 16, 16}, NCHW, halide_type_of<float>());
+        auto inputPtr = input->writeMap<float>();
+        for (int i = 0; i < 3 * 16 * 16; ++i) {
+            inputPtr[i] = (float)(i % 17) * 0.1f - 0.8f;
+        }
+        auto expect = readModule->onForward({input})[0];
+        auto result = mapModule->onForward({input})[0];
+        auto size = expect->getInfo()->size;
+        if (!checkVector<float>(result->readMap<float>(), expect->readMap<float>(), size, 0.01f)) {
+            MNN_ERROR("Mapped module result is wrong\n");
+            return false;
+        }
+        MNN::ScheduleConfig sconfig;
+        sconfig.type = getCurrentType();
+        auto session = net->createSession(sconfig);
+        auto sessionInput = net->getSessionInput(session, "x");
+        std::shared_ptr<MNN::Tensor> hostInput(MNN::Tensor::createHostTensorFromDevice(sessionInput, false));
+        ::memcpy(hostInput->host<float>(), input->readMap<float>(), hostInput->size());
+        sessionInput->copyFromHostTensor(hostInput.get());
+        net->runSession(session);
+        auto sessionOutput = net->getSessionOutput(session, "y");
+        std::shared_ptr<MNN::Tensor> hostOutput(MNN::Tensor::createHostTensorFromDevice(sessionOutput, true));
+        if (!checkVector<float>(hostOutput->host<float>(), expect->readMap<float>(), size, 0.01f)) {
+            MNN_ERROR("Mapped interpreter result is wrong\n");
+            return false;
+        }
+        net->releaseModel();
+        return true;
+    }
+};
+MNNTestSuiteRegister(MapModelFileTest, "expr/mmapmodel");
+
+class PackedWeightCacheTest : public MNNTestCase {
+public:
+    // The cache is kept after exit, remove it so that every run starts without it
+    static void _removeCache(const std::string& dir) {
+#ifndef _MSC_VER
+        auto dirPtr = opendir(dir.c_str());
+        if (nullptr == dirPtr) {
+            return;
+        }
+        struct dirent* ent;
+        while ((ent = readdir(dirPtr)) != nullptr) {
+            std::string name = ent->d_name;
+            if (name != "." && name != "..") {
+                MNNRemoveFile(MNNFilePathConcat(dir, name).c_str());
+            }
+        }
+        closedir(dirPtr);
+        rmdir(dir.c_str());
+#endif
+    }
+    static bool _hasCache(const std::string& dir) {
+#ifndef _MSC_VER
+        auto dirPtr = opendir(dir.c_str());
+        if (nullptr == dirPtr) {
+            return false;
+        }
+        bool res = false;
+        struct dirent* ent;
+        while ((ent = readdir(dirPtr)) != nullptr) {
+            std::string name = ent->d_name;
+            res = res || (name.size() > 11 && name.compare(name.size() - 11, 11, "sync.static") == 0);
+        }
+        closedir(dirPtr);
+        return res;
+#else
+        return true;
+#endif
+    }
+    virtual bool run(int precision) {
+        if (MNN_FORWARD_CPU != getCurrentType()) {
+            return true;
+        }
+        auto x = _Input({1, 8, 12, 12}, NC4HW4, halide_type_of<float>());
+        x->setName("x");
+        auto y = _Conv(0.02f, 0.01f, x, {8, 16}, {3, 3}, SAME);
+        y = _Conv(0.03f, 0.01f, y, {16, 8}, {1, 1});
+        y = _Convert(y, NCHW);
+        y->setName("y");
+        auto buffer = MNN::Express::Variable::save({y});
+        std::vector<float> inputData(8 * 12 * 12);
+        for (int i = 0; i < inputData.size(); ++i) {
+            inputData[i] = (float)(i % 13) * 0.1f - 0.6f;
+        }
+        // The static mmap is set once per runtime, so every load uses its own executor
+        auto forward = [&](bool cached) {
+            MNN::BackendConfig bnConfig;
+            auto executor = Executor::newExecutor(getCurrentType(), bnConfig, 1);
+            ExecutorScope scope(executor);
+            ScheduleConfig config;
+            config.type = getCurrentType();
+            std::shared_ptr<Executor::RuntimeManager> rtm(Executor::RuntimeManager::createRuntimeManager(config));
+            if (cached) {
+                rtm->setExternalPath("tmp_packed", MNN::Interpreter::EXTERNAL_WEIGHT_DIR);
+                rtm->setHint(MNN::Interpreter::USE_CACHED_MMAP, 1);
+            }
+            Module::Config mconfig;
+            mconfig.rearrange = true;
+            std::shared_ptr<Module> module(Module::load({"x"}, {"y"}, (const uint8_t*)buffer.data(), buffer.size(), rtm, &mconfig), Module::destroy);
+            auto input = _Input({1, 8, 12, 12}, NCHW, halide_type_of<float>());
+            ::memcpy(input->writeMap<float>(), inputData.data(), inputData.size() * sizeof(float));
+            auto output = module->onForward({_Convert(input, NC4HW4)})[0];
+            auto ptr = output->readMap<float>();
+            return std::vector<float>(ptr, ptr + output->getInfo()->size);
+        };
+        auto expect = forward(false);
+        _removeCache("tmp_packed");
+        // The first load packs the weights into the cache, the second one only maps them
+        bool res = true;
+        for (int i = 0; i < 2 && res; ++i) {
+            auto result = forward(true);
+            if (!checkVector<float>(result.data(), expect.data(), expect.size(), 0.01f)) {
+                MNN_ERROR("Packed weight cache result is wrong in load %d\n", i);
+                res = false;
+            }
+            if (res && !_hasCache("tmp_packed")) {
+                MNN_ERROR("Packed weight cache is not written in load %d\n", i);
+                res = false;
+            }
+        }
+        _removeCache("tmp_packed");
+        return res;
+    }
+};
+MNNTestSuiteRegister(PackedWeightCacheTest, "expr/packedweightcache");
+
+class WeightPrefetchTest : public MNNTestCase {
+public:
+    virtual bool run(int precision) {
+        if (MNN_FORWARD_CPU != getCurrentType()) {
+            return true;
+        }
+        auto x = _Input({1, 32, 8, 8}, NC4HW4, halide_type_of<float>());
+        x->setName("x");
+        auto y = x;
+        for (int i = 0; i < 4; ++i) {
+            y = _Conv(0.01f * (i + 1), 0.01f, y, {32, 32}, {3, 3}, SAME);
+        }
+        y = _Convert(y, NCHW);
+        y->setName("y");
+        auto buffer = MNN::Express::Variable::save({y});
+        std::vector<float> inputData(32 * 8 * 8);
+        for (int i = 0; i < inputData.size(); ++i) {
+            inputData[i] = (float)(i % 11) * 0.1f - 0.5f;
+        }
+        auto forward = [&](int window, std::vector<float>* expect) {
+            MNN::BackendConfig bnConfig;
+            auto executor = Executor::newExecutor(getCurrentType(), bnConfig, 1);
+            ExecutorScope scope(executor);
+            ScheduleConfig config;
+            config.type = getCurrentType();
+            std::shared_ptr<Executor::RuntimeManager> rtm(Executor::RuntimeManager::createRuntimeManager(config));
+            if (window > 0) {
+                rtm->setExternalPath("tmp_prefetch", MNN::Interpreter::EXTERNAL_WEIGHT_DIR);
+                rtm->setHint(MNN::Interpreter::WEIGHT_PREFETCH_WINDOW, window);
+            }
+            // Weights are put into the static mmap when the module is rearranged
+            Module::Config mconfig;
+            mconfig.rearrange = true;
+            std::shared_ptr<Module> module(Module::load({"x"}, {"y"}, (const uint8_t*)buffer.data(), buffer.size(), rtm, &mconfig), Module::destroy);
+            auto input = _Input({1, 32, 8, 8}, NCHW, halide_type_of<float>());
+            ::memcpy(input->writeMap<float>(), inputData.data(), inputData.size() * sizeof(float));
+            input = _Convert(input, NC4HW4);
+            // Advices issued by the runtime so far, -1 if the weights are not streamed
+            auto advices = [&]() {
+                int info[2] = {0, 0};
+                if (!rtm->getInfo(MNN::Interpreter::WEIGHT_PREFETCH, info) || info[0] <= 0) {
+                    return -1;
+                }
+                return info[1];
+            };
+            // Released weights are read back from the file on the next run, the clone shares the streamed weights
+            std::shared_ptr<Module> cloneModule(Module::clone(module.get()), Module::destroy);
+            for (int i = 0; i < 6; ++i) {
+                auto current = i < 3 ? module : cloneModule;
+                int before = advices();
+                auto output = current->onForward({input})[0];
+                auto ptr = output->readMap<float>();
+                auto size = output->getInfo()->size;
+                if (window > 0 && (before < 0 || advices() <= before)) {
+                    MNN_ERROR("Weight prefetch issues no advice for window %d, run %d\n", window, i);
+                    return false;
+                }
+                if (expect->empty()) {
+                    expect->assign(ptr, ptr + size);
+                    continue;
+                }
+                if (!checkVector<float>(ptr, expect->data(), size, 0.01f)) {
+                    MNN_ERROR("Weight prefetch result is wrong for window %d, run %d\n", window, i);
+                    return false;
+                }
+            }
+            return true;
+        };
+        std::vector<float> expect;
+        bool res = true;
+        for (int window = 0; window <= 2 && res; ++window) {
+            res = forward(window, &expect);
+        }
+        PackedWeightCacheTest::_removeCache("tmp_prefetch");
+        return res;
+    }
+};
+MNNTestSuiteRegister(WeightPrefetchTest, "expr/weightprefetch");
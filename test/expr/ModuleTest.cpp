@@ -18,6 +18,11 @@
 #include <MNN/AutoTime.hpp>
 #include <MNN/expr/ExecutorScope.hpp>
 #include "MNN_generated.h"
+#include "core/MNNFileUtils.h"
+#ifndef _MSC_VER
+#include <dirent.h>
+#include <unistd.h>
+#endif
 using namespace MNN::Express;
 using namespace MNN;
 
@@ -1687,3 +1692,147 @@ public:
     };
 };
 MNNTestSuiteRegister(InputModuleTest, "expr/InputModuleTest");
+
+class ShapePlanCacheTest : public MNNTestCase {
+public:
+    virtual bool run(int precision) {
+        auto executor = cloneCurrentExecutor();
+        ExecutorScope scope(executor);
+        auto x = _Input({1, 3, -1, -1}, NCHW, halide_type_of<float>());
+        x->setName("x");
+        auto y = _Conv(0.01f, 0.02f, _Convert(x, NC4HW4), {3, 8}, {3, 3}, SAME);
+        y = _Convert(_Relu(y), NCHW);
+        y->setName("y");
+        auto buffer = Variable::save({y});
+        ScheduleConfig config;
+        config.type = getCurrentType();
+        std::shared_ptr<Executor::RuntimeManager> rtm(Executor::RuntimeManager::createRuntimeManager(config));
+        rtm->setHint(MNN::Interpreter::STATIC_MODULE_PLAN_CACHE, 2);
+        std::shared_ptr<Executor::RuntimeManager> rtmRef(Executor::RuntimeManager::createRuntimeManager(config));
+        Module::Config mconfig;
+        mconfig.rearrange = true;
+        std::shared_ptr<Module> m(Module::load({"x"}, {"y"}, (const uint8_t*)buffer.data(), buffer.size(), rtm, &mconfig), Module::destroy);
+        std::shared_ptr<Module> mRef(Module::load({"x"}, {"y"}, (const uint8_t*)buffer.data(), buffer.size(), rtmRef, &mconfig), Module::destroy);
+        std::vector<int> sizes = {16, 24, 16, 24, 32, 16};
+        // Plans of 16 and 24 are hit once each, 32 evicts 16 and 16 evicts 24
+        std::vector<bool> hits = {false, false, true, true, false, false};
+        for (int i = 0; i < sizes.size(); ++i) {
+            auto input = _Input({1, 3, sizes[i], sizes[i]}, NCHW, halide_type_of<float>());
+            auto ptr = input->writeMap<float>();
+            for (int j = 0; j < input->getInfo()->size; ++j) {
+                ptr[j] = (float)((j + i) % 7) * 0.1f;
+            }
+            auto output = m->onForward({input})[0];
+            int status = 0;
+            rtm->getInfo(MNN::Interpreter::RESIZE_STATUS, &status);
+            if (hits[i] && status == 2) {
+                MNN_ERROR("Cached plan of %d is resized again\n", sizes[i]);
+                return false;
+            }
+            auto expect = mRef->onForward({input})[0];
+            auto size = expect->getInfo()->size;
+            if (output->getInfo()->size != size || !checkVector<float>(output->readMap<float>(), expect->readMap<float>(), size, 0.01f)) {
+                MNN_ERROR("Shape plan cache result is wrong for %d\n", sizes[i]);
+                return false;
+            }
+        }
+        int counts[2] = {0, 0};
+        if (!rtm->getInfo(MNN::Interpreter::MODULE_PLAN_CACHE, counts) || counts[0] != 2 || counts[1] != 4) {
+            MNN_ERROR("Shape plan cache hit %d, miss %d\n", counts[0], counts[1]);
+            return false;
+        }
+        return true;
+    }
+};
+MNNTestSuiteRegister(ShapePlanCacheTest, "expr/ShapePlanCacheTest");
+
+class SharedCachedMmapTest : public MNNTestCase {
+public:
+    static void _removeDir(const std::string& dir) {
+#ifndef _MSC_VER
+        auto dirPtr = opendir(dir.c_str());
+        if (nullptr == dirPtr) {
+            return;
+        }
+        struct dirent* ent;
+        while ((ent = readdir(dirPtr)) != nullptr) {
+            std::string name = ent->d_name;
+            if (name != "." && name != "..") {
+                MNNRemoveFile(MNNFilePathConcat(dir, name).c_str());
+            }
+        }
+        closedir(dirPtr);
+        rmdir(dir.c_str());
+#endif
+    }
+    virtual bool run(int precision) {
+        if (MNN_FORWARD_CPU != getCurrentType()) {
+            return true;
+        }
+        // Models without uuid, with the same shapes and different weights. 1x1 convolutions skip packing on a cache hit
+        std::vector<std::vector<int8_t>> buffers;
+        for (int i = 0; i < 3; ++i) {
+            auto x = _Input({1, 16, 10, 10}, NC4HW4, halide_type_of<float>());
+            x->setName("x");
+            auto y = _Conv(0.02f * (i + 1), 0.01f * (i + 1), x, {16, 16}, {1, 1});
+            y = _Convert(y, NCHW);
+            y->setName("y");
+            buffers.emplace_back(Variable::save({y}));
+        }
+        std::vector<float> inputData(16 * 10 * 10);
+        for (int i = 0; i < inputData.size(); ++i) {
+            inputData[i] = (float)(i % 9) * 0.1f - 0.4f;
+        }
+        // The models are loaded through one runtime manager in the given order, results are in model order
+        auto forward = [&](bool cached, const std::vector<int>& order, std::vector<std::vector<float>>& results) {
+            MNN::BackendConfig bnConfig;
+            auto executor = Executor::newExecutor(getCurrentType(), bnConfig, 1);
+            ExecutorScope scope(executor);
+            ScheduleConfig config;
+            config.type = getCurrentType();
+            std::shared_ptr<Executor::RuntimeManager> rtm(Executor::RuntimeManager::createRuntimeManager(config));
+            if (cached) {
+                rtm->setExternalPath("tmp_shared_key", MNN::Interpreter::EXTERNAL_WEIGHT_DIR);
+                rtm->setHint(MNN::Interpreter::USE_CACHED_MMAP, 1);
+            }
+            Module::Config mconfig;
+            mconfig.rearrange = true;
+            std::vector<std::shared_ptr<Module>> modules(buffers.size());
+            for (auto index : order) {
+                auto& buffer = buffers[index];
+                modules[index].reset(Module::load({"x"}, {"y"}, (const uint8_t*)buffer.data(), buffer.size(), rtm, &mconfig), Module::destroy);
+            }
+            results.clear();
+            results.resize(buffers.size());
+            for (auto index : order) {
+                auto& module = modules[index];
+                auto input = _Input({1, 16, 10, 10}, NCHW, halide_type_of<float>());
+                ::memcpy(input->writeMap<float>(), inputData.data(), inputData.size() * sizeof(float));
+                auto output = module->onForward({_Convert(input, NC4HW4)})[0];
+                auto ptr = output->readMap<float>();
+                results[index].assign(ptr, ptr + output->getInfo()->size);
+            }
+        };
+        std::vector<std::vector<float>> expect;
+        forward(false, {0, 1, 2}, expect);
+        _removeDir("tmp_shared_key");
+        // The first pass writes the cache of model 0 and the second reads it back, model 2 must not read the weights
+        // of model 1 at its place. The third pass writes the cache of model 1, then both caches exist but only the
+        // model loaded first reads its own
+        std::vector<std::vector<int>> orders = {{0, 1}, {0, 2}, {1, 0}, {0, 1}};
+        bool res = true;
+        for (int pass = 0; pass < orders.size() && res; ++pass) {
+            std::vector<std::vector<float>> results;
+            forward(true, orders[pass], results);
+            for (auto i : orders[pass]) {
+                if (results[i].size() != expect[i].size() || !checkVector<float>(results[i].data(), expect[i].data(), expect[i].size(), 0.01f)) {
+                    MNN_ERROR("Model %d loaded with cached mmap is wrong in pass %d\n", i, pass);
+                    res = false;
+                }
+            }
+        }
+        _removeDir("tmp_shared_key");
+        return res;
+    }
+};
+MNNTestSuiteRegister(SharedCachedMmapTest, "expr/SharedCachedMmapTest");
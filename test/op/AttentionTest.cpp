@@ -31,6 +31,13 @@ struct KVMeta {
         PendingWrite,
         PendingRead
     } file_operation;
+    enum {
+        MaskInput,
+        MaskCausal,
+        MaskSliding,
+        MaskPrefixLM,
+        MaskSegments
+    };
     size_t block = 4096;
     size_t previous = 0;
     size_t remove = 0;
@@ -43,6 +50,16 @@ struct KVMeta {
     int layer_index = 0;
     int layer_nums = 0;
     std::vector<int> reserveHost;
+    int prefix_block = 0;
+    int prefix_read = 0;
+    int prefix_write_begin = 0;
+    int prefix_write_end = 0;
+    std::vector<std::shared_ptr<void>>* prefix_blocks = nullptr;
+    int mask_mode = 0;
+    int sliding_window = 0;
+    int sink_tokens = 0;
+    int prefix_len = 0;
+    std::vector<int> segments;
     void sync() {
         int revertNumber = 0;
         for (int i=0; i<n_reserve; ++i) {
@@ -53,11 +70,16 @@ struct KVMeta {
         reserve = nullptr;
         remove = 0;
         add = 0;
+        if (prefix_block > 0) {
+            previous += prefix_read * prefix_block;
+            prefix_read = 0;
+            layer_index = 0;
+        }
     }
 };
 
 static KVMeta gMeta;
-static std::shared_ptr<Module> _makeAttentionModule(int attentionMode = 8) {
+static std::shared_ptr<Module> _makeAttentionModule(int attentionMode = 8, bool paged = false) {
     auto Q = _Input();
     auto K = _Input();
     auto V = _Input();
@@ -80,6 +102,9 @@ static std::shared_ptr<Module> _makeAttentionModule(int attentionMode = 8) {
     std::shared_ptr<Executor::RuntimeManager> rtmgr(Executor::RuntimeManager::createRuntimeManager(config));
     rtmgr->setHintPtr(MNN::Interpreter::KVCACHE_INFO, &gMeta);
     rtmgr->setHint(MNN::Interpreter::ATTENTION_OPTION, attentionMode);
+    if (paged) {
+        rtmgr->setHint(MNN::Interpreter::KVCACHE_PAGED, 1);
+    }
     std::shared_ptr<Module> m(Module::load({}, {}, (uint8_t*)buffer.data(), buffer.size(), rtmgr));
     return m;
 }
@@ -508,6 +533,258 @@ SpeedAttentionTest() = default;
     }
 };
 
+class PagedAttentionTest : public AttentionTest {
+public:
+    PagedAttentionTest() = default;
+    virtual ~PagedAttentionTest() = default;
+
+    // Prefill, decode across the block boundary, remove the tail and decode again
+    std::vector<std::vector<float>> runSequence(bool paged, const std::vector<VARP>& decodeQ, const std::vector<VARP>& decodeK, const std::vector<VARP>& decodeV) {
+        std::vector<std::vector<float>> results;
+        auto record = [&](VARP output) {
+            auto size = output->getInfo()->size;
+            auto ptr = output->readMap<float>();
+            results.emplace_back(ptr, ptr + size);
+        };
+        gMeta.previous = 0;
+        gMeta.remove = 0;
+        auto attn = _makeAttentionModule(8, paged);
+        gMeta.add = Query->getInfo()->dim[1];
+        record(attn->onForward({Query, Key, Value, Mask})[0]);
+        gMeta.sync();
+        for (int i = 0; i < decodeQ.size(); ++i) {
+            if (i == decodeQ.size() / 2) {
+                gMeta.remove = 50;
+            }
+            gMeta.add = 1;
+            record(attn->onForward({decodeQ[i], decodeK[i], decodeV[i], Mask1})[0]);
+            gMeta.sync();
+        }
+        return results;
+    }
+
+    virtual bool run(int precision) {
+        srand(2025);
+        int seq_len = 100;
+        int decode_len = 60;
+        generateInput(seq_len, precision, true);
+        generateMask(seq_len, seq_len, true);
+        std::vector<VARP> decodeQ, decodeK, decodeV;
+        for (int i = 0; i < decode_len; ++i) {
+            auto q = generateRandTensor(1, NumHead, HeadDim, precision);
+            auto k = generateRandTensor(1, KvNumHead, HeadDim, precision);
+            auto v = generateRandTensor(1, KvNumHead, HeadDim, precision);
+            decodeQ.emplace_back(vector_to_var(q));
+            decodeK.emplace_back(vector_to_var(k));
+            decodeV.emplace_back(vector_to_var(v));
+        }
+        auto expect = runSequence(false, decodeQ, decodeK, decodeV);
+        auto result = runSequence(true, decodeQ, decodeK, decodeV);
+        for (int i = 0; i < expect.size(); ++i) {
+            for (int j = 0; j < expect[i].size(); ++j) {
+                if (fabsf(expect[i][j] - result[i][j]) > 0.01f) {
+                    MNN_ERROR("Paged attention mismatch at step %d, index %d: %f vs %f\n", i, j, expect[i][j], result[i][j]);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+class PrefixBlockAttentionTest : public AttentionTest {
+public:
+    PrefixBlockAttentionTest() = default;
+    virtual ~PrefixBlockAttentionTest() = default;
+
+    virtual bool run(int precision) {
+        const int blockSize = 64;
+        const int prefixBlocks = 2;
+        int seq_len = 150;
+        generateInput(seq_len, precision, true);
+        generateMask(seq_len, seq_len, true);
+        std::vector<std::shared_ptr<void>> blocks(prefixBlocks);
+        auto resetMeta = [&]() {
+            gMeta.previous = 0;
+            gMeta.remove = 0;
+            gMeta.layer_index = 0;
+            gMeta.layer_nums = 1;
+            gMeta.prefix_block = blockSize;
+            gMeta.prefix_blocks = &blocks;
+        };
+        // Compute the whole prompt and save its first blocks
+        resetMeta();
+        gMeta.prefix_write_begin = 0;
+        gMeta.prefix_write_end = prefixBlocks;
+        auto attn = _makeAttentionModule();
+        gMeta.add = seq_len;
+        auto expectPrefill = attn->onForward({Query, Key, Value, Mask})[0];
+        gMeta.sync();
+        gMeta.add = 1;
+        auto expectDecode = attn->onForward({Query1, Key1, Value1, Mask1})[0];
+        gMeta.sync();
+        for (auto& block : blocks) {
+            if (nullptr == block) {
+                MNN_PRINT("Prefix blocks are not saved, skip\n");
+                gMeta.prefix_block = 0;
+                gMeta.prefix_blocks = nullptr;
+                return true;
+            }
+        }
+        // Load the saved blocks and only compute the remaining tokens
+        resetMeta();
+        gMeta.prefix_read = prefixBlocks;
+        gMeta.prefix_write_begin = prefixBlocks;
+        gMeta.prefix_write_end = prefixBlocks;
+        auto suffixLen = seq_len - prefixBlocks * blockSize;
+        auto suffixQ = _Slice(Query, _Const(std::vector<int>{0, prefixBlocks * blockSize, 0, 0}.data(), {4}, NCHW, halide_type_of<int>()), _Const(std::vector<int>{-1, suffixLen, -1, -1}.data(), {4}, NCHW, halide_type_of<int>()));
+        auto suffixK = _Slice(Key, _Const(std::vector<int>{0, prefixBlocks * blockSize, 0, 0}.data(), {4}, NCHW, halide_type_of<int>()), _Const(std::vector<int>{-1, suffixLen, -1, -1}.data(), {4}, NCHW, halide_type_of<int>()));
+        auto suffixV = _Slice(Value, _Const(std::vector<int>{0, prefixBlocks * blockSize, 0, 0}.data(), {4}, NCHW, halide_type_of<int>()), _Const(std::vector<int>{-1, suffixLen, -1, -1}.data(), {4}, NCHW, halide_type_of<int>()));
+        auto attn2 = _makeAttentionModule();
+        gMeta.add = suffixLen;
+        auto prefill = attn2->onForward({suffixQ, suffixK, suffixV, Mask})[0];
+        gMeta.sync();
+        if (gMeta.previous != seq_len) {
+            MNN_ERROR("Prefix block kvcache length error: %d\n", (int)gMeta.previous);
+            return false;
+        }
+        gMeta.add = 1;
+        auto decode = attn2->onForward({Query1, Key1, Value1, Mask1})[0];
+        gMeta.sync();
+        gMeta.prefix_block = 0;
+        gMeta.prefix_blocks = nullptr;
+        float prefillDiff = 0.0f;
+        auto expectPtr = expectPrefill->readMap<float>() + prefixBlocks * blockSize * NumHead * HeadDim;
+        auto prefillPtr = prefill->readMap<float>();
+        for (int i = 0; i < suffixLen * NumHead * HeadDim; ++i) {
+            prefillDiff = fmaxf(prefillDiff, fabsf(expectPtr[i] - prefillPtr[i]));
+        }
+        auto decodeDiff = _ReduceMax(_Abs(decode - expectDecode))->readMap<float>()[0];
+        if (prefillDiff > 0.01f || decodeDiff > 0.01f) {
+            MNN_ERROR("Prefix block attention mismatch: prefill diff %f, decode diff %f\n", prefillDiff, decodeDiff);
+            return false;
+        }
+        return true;
+    }
+};
+
+class ImplicitMaskAttentionTest : public AttentionTest {
+public:
+    ImplicitMaskAttentionTest() = default;
+    virtual ~ImplicitMaskAttentionTest() = default;
+
+    static std::vector< std::vector< std::vector<float> > > randTensor(int C, int H, int W) {
+        std::vector< std::vector< std::vector<float> > > a(C, std::vector< std::vector<float> >(H, std::vector<float>(W)));
+        for (auto& x : a) {
+            for (auto& y : x) {
+                for (auto& z : y) {
+                    z = (float)rand() / RAND_MAX - 0.5f;
+                }
+            }
+        }
+        return a;
+    }
+
+    // Prefill then a second chunk, against the naive attention with the dense mask of the same mode.
+    // For MaskSegments, chunks starting before prefixLen are causal and the others hold three sequences
+    bool runMode(int maskMode, int window, int sinkTokens, int prefixLen, int precision) {
+        const int chunks[2] = {200, 20};
+        gMeta.previous = 0;
+        gMeta.remove = 0;
+        gMeta.mask_mode = maskMode;
+        gMeta.sliding_window = window;
+        gMeta.sink_tokens = sinkTokens;
+        gMeta.prefix_len = prefixLen;
+        auto attn = _makeAttentionModule();
+        std::shared_ptr<NaiveAttention> naiveAttention(new NaiveAttention);
+        auto selector = _Input({1, 1, 1, 1}, NCHW, halide_type_of<float>());
+        selector->writeMap<float>()[0] = 1.0f;
+        int past = 0;
+        bool pass = true;
+        for (int seq_len : chunks) {
+            query = randTensor(seq_len, NumHead, HeadDim);
+            key   = randTensor(seq_len, KvNumHead, HeadDim);
+            value = randTensor(seq_len, KvNumHead, HeadDim);
+            Query = vector_to_var(query);
+            Key   = vector_to_var(key);
+            Value = vector_to_var(value);
+            int kv_seq_len = past + seq_len;
+            bool segmented = maskMode == KVMeta::MaskSegments && past >= prefixLen;
+            gMeta.mask_mode = (maskMode == KVMeta::MaskSegments && !segmented) ? KVMeta::MaskCausal : maskMode;
+            gMeta.segments.clear();
+            if (segmented) {
+                // interleaved bodies, then the last token of every sequence
+                for (int i = 0; i < seq_len; ++i) {
+                    gMeta.segments.emplace_back(i < seq_len - 3 ? i % 3 : i - (seq_len - 3));
+                }
+            }
+            mask.assign(seq_len, std::vector<int>(kv_seq_len, 0));
+            for (int i = 0; i < seq_len; ++i) {
+                int pos = past + i;
+                for (int j = 0; j < kv_seq_len; ++j) {
+                    bool visible = j <= pos;
+                    if (maskMode == KVMeta::MaskSliding) {
+                        visible = visible && (j > pos - window || j < sinkTokens);
+                    } else if (maskMode == KVMeta::MaskPrefixLM) {
+                        visible = j <= ALIMAX(pos, prefixLen - 1);
+                    } else if (segmented) {
+                        visible = visible && (j < past || gMeta.segments[j - past] == gMeta.segments[i]);
+                    }
+                    mask[i][j] = visible;
+                }
+            }
+            expected_result = naiveAttention->onExecute(query, key, value, mask, seq_len);
+            gMeta.add = seq_len;
+            Output = attn->onForward({Query, Key, Value, selector})[0];
+            gMeta.sync();
+            pass = pass && compareResult(seq_len);
+            past += seq_len;
+        }
+        gMeta.mask_mode = KVMeta::MaskInput;
+        gMeta.segments.clear();
+        return pass;
+    }
+
+    virtual bool run(int precision) {
+        auto rtInfo = ExecutorScope::Current()->getRuntime().first;
+        for (auto& rt : rtInfo) {
+            if (rt.first != MNN_FORWARD_CPU) {
+                // only the cpu attention computes implicit masks
+                return true;
+            }
+        }
+        srand(2025);
+        if (!runMode(KVMeta::MaskCausal, 0, 0, 0, precision)) {
+            MNN_ERROR("Implicit causal mask attention failed\n");
+            return false;
+        }
+        if (!runMode(KVMeta::MaskSliding, 40, 0, 0, precision)) {
+            MNN_ERROR("Implicit sliding window mask attention failed\n");
+            return false;
+        }
+        if (!runMode(KVMeta::MaskSliding, 40, 4, 0, precision)) {
+            MNN_ERROR("Implicit sliding window with sink mask attention failed\n");
+            return false;
+        }
+        if (!runMode(KVMeta::MaskPrefixLM, 0, 0, 70, precision)) {
+            MNN_ERROR("Implicit prefix-LM mask attention failed\n");
+            return false;
+        }
+        if (!runMode(KVMeta::MaskSegments, 0, 0, 200, precision)) {
+            MNN_ERROR("Implicit segments mask attention after a prefix failed\n");
+            return false;
+        }
+        if (!runMode(KVMeta::MaskSegments, 0, 0, 0, precision)) {
+            MNN_ERROR("Implicit segments mask attention failed\n");
+            return false;
+        }
+        return true;
+    }
+};
+
 MNNTestSuiteRegister(AttentionTest, "op/attention");
+MNNTestSuiteRegister(PrefixBlockAttentionTest, "op/attention_prefix_block");
+MNNTestSuiteRegister(PagedAttentionTest, "op/attention_paged");
+MNNTestSuiteRegister(ImplicitMaskAttentionTest, "op/attention_implicit_mask");
 MNNTestSuiteRegister(SpeedAttentionTest, "speed/attention");
 #endif
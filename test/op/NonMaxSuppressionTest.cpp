@@ -0,0 +1,232 @@
+//
+//  NonMaxSuppressionTest.cpp
+//  MNNTests
+//
+//  Created by MNN on 2026/10/16.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <MNN/expr/Executor.hpp>
+#include <MNN/expr/ExecutorScope.hpp>
+#include <MNN/expr/Expr.hpp>
+#include <MNN/expr/ExprCreator.hpp>
+#include "MNNTestSuite.h"
+#include "TestUtils.h"
+
+using namespace MNN::Express;
+
+// The previous single threaded scalar implementation, as the reference
+static float _referenceIOU(const float* boxes, int i, int j) {
+    const float yMinI = std::min<float>(boxes[i * 4 + 0], boxes[i * 4 + 2]);
+    const float xMinI = std::min<float>(boxes[i * 4 + 1], boxes[i * 4 + 3]);
+    const float yMaxI = std::max<float>(boxes[i * 4 + 0], boxes[i * 4 + 2]);
+    const float xMaxI = std::max<float>(boxes[i * 4 + 1], boxes[i * 4 + 3]);
+    const float yMinJ = std::min<float>(boxes[j * 4 + 0], boxes[j * 4 + 2]);
+    const float xMinJ = std::min<float>(boxes[j * 4 + 1], boxes[j * 4 + 3]);
+    const float yMaxJ = std::max<float>(boxes[j * 4 + 0], boxes[j * 4 + 2]);
+    const float xMaxJ = std::max<float>(boxes[j * 4 + 1], boxes[j * 4 + 3]);
+    const float areaI = (yMaxI - yMinI) * (xMaxI - xMinI);
+    const float areaJ = (yMaxJ - yMinJ) * (xMaxJ - xMinJ);
+    if (areaI <= 0 || areaJ <= 0)
+        return 0.0;
+    const float intersectionArea = std::max<float>(std::min(yMaxI, yMaxJ) - std::max(yMinI, yMinJ), 0.0) *
+                                   std::max<float>(std::min(xMaxI, xMaxJ) - std::max(xMinI, xMinJ), 0.0);
+    return intersectionArea / (areaI + areaJ - intersectionArea);
+}
+
+static std::vector<int> _referenceNMS(const float* boxes, const float* scores, int scoreStride, int numBoxes,
+                                      int maxDetections, float iouThreshold, float scoreThreshold) {
+    typedef std::pair<float, int> Candidate;
+    std::priority_queue<Candidate> queue;
+    for (int i = 0; i < numBoxes; ++i) {
+        if (scores[i * scoreStride] > scoreThreshold) {
+            queue.emplace(scores[i * scoreStride], i);
+        }
+    }
+    std::vector<int> selected;
+    while ((int)selected.size() < std::min(maxDetections, numBoxes) && !queue.empty()) {
+        auto index = queue.top().second;
+        queue.pop();
+        bool shouldSelect = true;
+        for (int j = (int)selected.size() - 1; j >= 0 && shouldSelect; --j) {
+            shouldSelect = _referenceIOU(boxes, index, selected[j]) <= iouThreshold;
+        }
+        if (shouldSelect) {
+            selected.push_back(index);
+        }
+    }
+    return selected;
+}
+
+// Clustered boxes so that many of them overlap, some with swapped corners or empty
+static void _randomBoxes(float* boxes, int numBoxes, std::mt19937& rng) {
+    std::uniform_real_distribution<float> center(0.0f, 1.0f), jitter(-0.02f, 0.02f), size(0.02f, 0.2f);
+    std::vector<std::pair<float, float>> clusters(64);
+    for (auto& c : clusters) {
+        c = std::make_pair(center(rng), center(rng));
+    }
+    for (int i = 0; i < numBoxes; ++i) {
+        auto& c = clusters[rng() % clusters.size()];
+        float y = c.first + jitter(rng), x = c.second + jitter(rng);
+        float h = size(rng), w = i % 97 == 0 ? 0.0f : size(rng);
+        if (i % 5 == 0) {
+            boxes[4 * i + 0] = y + h;
+            boxes[4 * i + 1] = x + w;
+            boxes[4 * i + 2] = y;
+            boxes[4 * i + 3] = x;
+        } else {
+            boxes[4 * i + 0] = y;
+            boxes[4 * i + 1] = x;
+            boxes[4 * i + 2] = y + h;
+            boxes[4 * i + 3] = x + w;
+        }
+    }
+}
+
+// Distinct scores, so that the order does not depend on ties
+static void _randomScores(float* scores, int number, std::mt19937& rng) {
+    std::vector<int> order(number);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+    for (int i = 0; i < number; ++i) {
+        scores[i] = (order[i] + 0.5f) / number;
+    }
+}
+
+class NonMaxSuppressionTest : public MNNTestCase {
+public:
+    virtual ~NonMaxSuppressionTest() = default;
+    bool testNms(int numBoxes, int maxDetections, float iouThreshold, float scoreThreshold) {
+        std::mt19937 rng(numBoxes + maxDetections);
+        auto boxes  = _Input({numBoxes, 4}, NCHW);
+        auto scores = _Input({numBoxes}, NCHW);
+        _randomBoxes(boxes->writeMap<float>(), numBoxes, rng);
+        _randomScores(scores->writeMap<float>(), numBoxes, rng);
+        auto expect = _referenceNMS(boxes->readMap<float>(), scores->readMap<float>(), 1, numBoxes, maxDetections,
+                                    iouThreshold, scoreThreshold < 0 ? std::numeric_limits<float>::lowest() : scoreThreshold);
+        auto output = _Nms(boxes, scores, maxDetections, iouThreshold, scoreThreshold);
+        auto size   = output->getInfo()->size;
+        auto got    = output->readMap<int>();
+        for (int i = 0; i < size; ++i) {
+            int e = i < (int)expect.size() ? expect[i] : -1;
+            if (got[i] != e) {
+                MNN_ERROR("NonMaxSuppressionTest boxes %d, max %d: index %d expect %d, got %d\n", numBoxes, maxDetections, i, e, got[i]);
+                return false;
+            }
+        }
+        return true;
+    }
+    bool testDetectionPostProcess(int numBoxes, int numClasses, bool regular) {
+        const int maxDetections = 100, detectionsPerClass = 20;
+        const float scoreThreshold = 0.3f, iouThreshold = 0.5f;
+        std::mt19937 rng(numBoxes + numClasses);
+        // zero encodings decode to the anchors
+        auto encodings   = _Input({1, numBoxes, 4}, NCHW);
+        auto predictions = _Input({1, numBoxes, numClasses + 1}, NCHW);
+        auto anchors     = _Input({numBoxes, 4}, NCHW);
+        ::memset(encodings->writeMap<float>(), 0, numBoxes * 4 * sizeof(float));
+        _randomScores(predictions->writeMap<float>(), numBoxes * (numClasses + 1), rng);
+        std::vector<float> boxes(numBoxes * 4);
+        _randomBoxes(boxes.data(), numBoxes, rng);
+        auto anchorPtr = anchors->writeMap<float>();
+        for (int i = 0; i < numBoxes; ++i) {
+            boxes[4 * i + 2] = std::max(boxes[4 * i + 0], boxes[4 * i + 2]);
+            boxes[4 * i + 3] = std::max(boxes[4 * i + 1], boxes[4 * i + 3]);
+            float h = std::max(boxes[4 * i + 2] - boxes[4 * i + 0], 0.01f), w = std::max(boxes[4 * i + 3] - boxes[4 * i + 1], 0.01f);
+            anchorPtr[4 * i + 0] = boxes[4 * i + 0] + 0.5f * h;
+            anchorPtr[4 * i + 1] = boxes[4 * i + 1] + 0.5f * w;
+            anchorPtr[4 * i + 2] = h;
+            anchorPtr[4 * i + 3] = w;
+        }
+        for (int i = 0; i < numBoxes; ++i) {
+            float halfh = 0.5f * anchorPtr[4 * i + 2], halfw = 0.5f * anchorPtr[4 * i + 3];
+            boxes[4 * i + 0] = anchorPtr[4 * i + 0] - halfh;
+            boxes[4 * i + 1] = anchorPtr[4 * i + 1] - halfw;
+            boxes[4 * i + 2] = anchorPtr[4 * i + 0] + halfh;
+            boxes[4 * i + 3] = anchorPtr[4 * i + 1] + halfw;
+        }
+        auto outputs = _DetectionPostProcess(encodings, predictions, anchors, numClasses, maxDetections, 1, detectionsPerClass,
+                                             scoreThreshold, iouThreshold, regular, {10.0f, 10.0f, 5.0f, 5.0f});
+        // score, box, class
+        std::vector<std::tuple<float, int, int>> expect;
+        auto scorePtr = predictions->readMap<float>() + 1;
+        if (regular) {
+            for (int c = 0; c < numClasses; ++c) {
+                auto selected = _referenceNMS(boxes.data(), scorePtr + c, numClasses + 1, numBoxes, detectionsPerClass,
+                                              iouThreshold, scoreThreshold);
+                for (auto index : selected) {
+                    expect.emplace_back(scorePtr[index * (numClasses + 1) + c], index, c);
+                }
+            }
+            std::sort(expect.begin(), expect.end(), [](const std::tuple<float, int, int>& a, const std::tuple<float, int, int>& b) {
+                return std::get<0>(a) > std::get<0>(b);
+            });
+            expect.resize(std::min((int)expect.size(), maxDetections));
+        } else {
+            std::vector<float> maxScores(numBoxes);
+            std::vector<int> maxClasses(numBoxes);
+            for (int i = 0; i < numBoxes; ++i) {
+                auto s        = scorePtr + i * (numClasses + 1);
+                maxClasses[i] = (int)(std::max_element(s, s + numClasses) - s);
+                maxScores[i]  = s[maxClasses[i]];
+            }
+            auto selected = _referenceNMS(boxes.data(), maxScores.data(), 1, numBoxes, maxDetections, iouThreshold, scoreThreshold);
+            for (auto index : selected) {
+                expect.emplace_back(maxScores[index], index, maxClasses[index]);
+            }
+        }
+        auto gotBoxes   = outputs[0]->readMap<float>();
+        auto gotClasses = outputs[1]->readMap<float>();
+        auto gotScores  = outputs[2]->readMap<float>();
+        auto gotNumber  = outputs[3]->readMap<float>()[0];
+        if ((int)gotNumber != (int)expect.size()) {
+            MNN_ERROR("DetectionPostProcess regular %d: expect %d detections, got %d\n", regular, (int)expect.size(), (int)gotNumber);
+            return false;
+        }
+        for (int i = 0; i < (int)expect.size(); ++i) {
+            int box = std::get<1>(expect[i]);
+            bool same = gotScores[i] == std::get<0>(expect[i]) && (int)gotClasses[i] == std::get<2>(expect[i]);
+            for (int j = 0; j < 4; ++j) {
+                same = same && gotBoxes[4 * i + j] == boxes[4 * box + j];
+            }
+            if (!same) {
+                MNN_ERROR("DetectionPostProcess regular %d: detection %d differs\n", regular, i);
+                return false;
+            }
+        }
+        return true;
+    }
+    bool testAll() {
+        // boxes, max detections, iou threshold, score threshold
+        std::vector<std::tuple<int, int, float, float>> cases = {
+            {3000, 100, 0.5f, 0.2f},
+            {3000, 3000, 0.3f, -1.0f},
+            {6000, 6000, 0.5f, -1.0f},
+            {1000, 1000, 0.0f, 0.5f},
+        };
+        for (auto& c : cases) {
+            if (!testNms(std::get<0>(c), std::get<1>(c), std::get<2>(c), std::get<3>(c))) {
+                return false;
+            }
+        }
+        return testDetectionPostProcess(2000, 20, true) && testDetectionPostProcess(2000, 20, false);
+    }
+    virtual bool run(int precision) {
+        // The bitmask is only used with several threads, it must select the same boxes as greedy
+        for (int thread : {1, 4}) {
+            MNN::BackendConfig config;
+            std::shared_ptr<Executor> executor(Executor::newExecutor(MNN_FORWARD_CPU, config, thread));
+            ExecutorScope scope(executor);
+            if (!testAll()) {
+                MNN_ERROR("NonMaxSuppressionTest failed with %d threads\n", thread);
+                return false;
+            }
+        }
+        return true;
+    }
+};
+MNNTestSuiteRegister(NonMaxSuppressionTest, "op/NonMaxSuppression");
@@ -6,17 +6,29 @@
 //  Copyright © 2018, Alibaba Group Holding Limited
 //
 
-#ifdef MNN_BUILD_AUDIO
+#include <math.h>
+#include <random>
 #include <MNN/expr/Expr.hpp>
 #include <MNN/expr/ExprCreator.hpp>
 #include "MNNTestSuite.h"
 #include "TestUtils.h"
 
 using namespace MNN::Express;
+// signal: [batch, length, components], output: [batch, frames, bins, 2]
+static VARP _Stft(VARP signal, VARP window, int hop, bool onesided) {
+    using namespace MNN;
+    std::unique_ptr<OpT> op(new OpT);
+    op->type       = OpType_Stft;
+    op->main.type  = OpParameter_StftParam;
+    op->main.value = new StftParamT;
+    op->main.AsStftParam()->abs = onesided;
+    return Variable::create(Expr::create(std::move(op), {signal, _Scalar<int>(hop), window}));
+}
+
 class StftTest : public MNNTestCase {
 public:
     virtual ~StftTest() = default;
-    virtual bool run(int precision) {
+    bool testMagnitude() {
         /*
         python:
             import torch
@@ -29,7 +41,7 @@ public:
                                      win_length=win_length, window=window, center=False)
             magnitude = torch.abs(stft_result).transpose(1, 0)
         */
-        auto signal = _Input({ 20 }, NCHW);
+        auto signal = _Input({ 1, 20, 1 }, NCHW);
         auto window = _Input({  8 }, NCHW);
         signal->setName("signal");
         window->setName("window");
@@ -42,7 +54,7 @@ public:
         auto windowPtr           = window->writeMap<float>();
         memcpy(signalPtr, signalData, 20 * sizeof(float));
         memcpy(windowPtr, windowData,  8 * sizeof(float));
-        auto output                  = _Stft(signal, window, 8, 4);
+        auto output                  = _Sqrt(_ReduceSum(_Square(_Stft(signal, window, 4, true)), {-1}));
         const float expectedOutput[] = {
             3.428, 1.958, 0.203, 0.029, 0.013, 2.119, 1.501, 0.261, 0.041, 0.008,
             2.119, 1.501, 0.261, 0.041, 0.008, 3.428, 1.958, 0.203, 0.029, 0.013
@@ -57,6 +69,73 @@ public:
         }
         return true;
     }
+    // Compares with a direct dft for the lengths taking each path of the planned fft
+    bool testLength(int batch, int length, int components, int nfft, int hop, bool onesided) {
+        auto signal = _Input({batch, length, components}, NCHW);
+        auto window = _Input({nfft}, NCHW);
+        std::mt19937 rng(nfft);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        auto signalPtr = signal->writeMap<float>();
+        for (int i = 0; i < batch * length * components; ++i) {
+            signalPtr[i] = dist(rng);
+        }
+        auto windowPtr = window->writeMap<float>();
+        for (int i = 0; i < nfft; ++i) {
+            windowPtr[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / nfft);
+        }
+        auto output = _Stft(signal, window, hop, onesided);
+        auto info   = output->getInfo();
+        int frames  = (length - nfft) / hop + 1;
+        int bins    = onesided ? nfft / 2 + 1 : nfft;
+        if (nullptr == info || info->dim != std::vector<int>({batch, frames, bins, 2})) {
+            MNN_ERROR("StftTest shape error for nfft %d\n", nfft);
+            return false;
+        }
+        auto gotOutput = output->readMap<float>();
+        for (int b = 0; b < batch; ++b) {
+            for (int f = 0; f < frames; ++f) {
+                auto src = signalPtr + (b * length + f * hop) * components;
+                auto dst = gotOutput + ((b * frames + f) * bins) * 2;
+                for (int k = 0; k < bins; ++k) {
+                    double re = 0.0, im = 0.0, scale = 0.0;
+                    for (int n = 0; n < nfft; ++n) {
+                        double angle = -2.0 * M_PI * (double)((long long)k * n % nfft) / nfft;
+                        double xr    = src[n * components] * windowPtr[n];
+                        double xi    = components == 2 ? src[n * 2 + 1] * windowPtr[n] : 0.0;
+                        re += xr * cos(angle) - xi * sin(angle);
+                        im += xr * sin(angle) + xi * cos(angle);
+                        scale += fabs(xr) + fabs(xi);
+                    }
+                    if (fabs(dst[2 * k] - re) > 1e-4 * scale + 1e-4 || fabs(dst[2 * k + 1] - im) > 1e-4 * scale + 1e-4) {
+                        MNN_ERROR("StftTest nfft %d, frame %d, bin %d: expect (%f, %f), got (%f, %f)\n", nfft, f, k, re, im,
+                                  dst[2 * k], dst[2 * k + 1]);
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+    virtual bool run(int precision) {
+        if (!testMagnitude()) {
+            return false;
+        }
+        // batch, length, components, nfft, hop, onesided
+        std::vector<std::vector<int>> cases = {
+            {1, 4000, 1, 400, 160, 1}, // whisper frontend, radix 4/2/5
+            {2, 1024, 1, 256, 128, 0}, // power of two, both halves
+            {1, 600, 1, 15, 7, 1},     // odd real length, radix 3/5
+            {1, 600, 1, 98, 50, 1},    // direct radix 7
+            {1, 1000, 1, 97, 64, 1},   // prime length, bluestein
+            {1, 1000, 1, 202, 64, 0},  // half length is a large prime
+            {2, 300, 2, 60, 30, 0},    // complex input
+        };
+        for (auto& c : cases) {
+            if (!testLength(c[0], c[1], c[2], c[3], c[4], c[5] != 0)) {
+                return false;
+            }
+        }
+        return true;
+    }
 };
 MNNTestSuiteRegister(StftTest, "op/stft");
-#endif // MNN_BUILD_AUDIO
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include <MNN/expr/ExprCreator.hpp>
 #include "MNNTestSuite.h"
 #include "TestUtils.h"
+#include <math.h>
 #include <random>
 #include <vector>
 
@@ -167,17 +168,18 @@ class TopKV2Test : public MNNTestCase {
 public:
     virtual ~TopKV2Test() = default;
 
-    virtual bool run(int precision) {
-        // set params
-        const int K = 10;
-        const int numRow = 180;
-        
-        const int lengthRow = 21491;
-
+    bool test(int precision, const int numRow, const int lengthRow, const int K, bool ties) {
         // set input
         VARP input0 = _Input({numRow, lengthRow}, NCHW, halide_type_of<float>());
         VARP input1 = _Input({1}, NCHW, halide_type_of<int>());
         RandomInitFloat(input0->writeMap<float>(), numRow * lengthRow);
+        if (ties) {
+            // Only 64 distinct values, many equal ones reach the threshold
+            auto ptr = input0->writeMap<float>();
+            for (int i = 0; i < numRow * lengthRow; i++) {
+                ptr[i] = floorf(ptr[i] * 64.0f) / 64.0f;
+            }
+        }
         SetK(input1->writeMap<int>(), K);
         MNN::Timer _t;
 
@@ -199,23 +201,38 @@ public:
         // check values
         float errorScale = precision <= MNN::BackendConfig::Precision_High ? 1 : 20;
         if (!checkVectorByRelativeError<float>(gotOutput0, expectedOutput0.data(), numRow * K, 0.001 * errorScale)) {
-            MNN_ERROR("TopKV2 test failed!\n");
+            MNN_ERROR("TopKV2 test failed for %d x %d, k = %d!\n", numRow, lengthRow, K);
             return false;
         }
 
         // check indices
         if (precision <= 1) {
             if (!checkIndicesFloat(input0->readMap<float>(), expectedOutput0.data(), gotOutput1, K, numRow, lengthRow)) {
-                MNN_ERROR("TopKV2 test failed!\n");
+                MNN_ERROR("TopKV2 test failed for %d x %d, k = %d!\n", numRow, lengthRow, K);
                 return false;
             }
         } else if (precision == 2) {
             if (!checkIndicesHalf(input0->readMap<float>(), expectedOutput0.data(), gotOutput1, K, numRow, lengthRow)) {
-                MNN_ERROR("TopKV2 test failed!\n");
+                MNN_ERROR("TopKV2 test failed for %d x %d, k = %d!\n", numRow, lengthRow, K);
                 return false;
             }
         }
+        return true;
+    }
 
+    virtual bool run(int precision) {
+        // numRow, lengthRow, K, ties
+        std::vector<std::tuple<int, int, int, bool>> cases = {
+            {180, 21491, 10, false},
+            {1, 300000, 64, false},
+            {3, 100000, 500, true},
+            {32, 1000, 100, true},
+        };
+        for (auto& c : cases) {
+            if (!test(precision, std::get<0>(c), std::get<1>(c), std::get<2>(c), std::get<3>(c))) {
+                return false;
+            }
+        }
         return true;
     }
 
@@ -5,7 +5,6 @@
 //  Created by MNN on 2024/11/27.
 //  Copyright © 2018, Alibaba Group Holding Limited
 //
-#ifdef MNN_BUILD_AUDIO
 
 #include <math.h>
 #include <MNN/expr/Expr.hpp>
@@ -13,28 +12,54 @@
 #include <random>
 #define MNN_OPEN_TIME_TRACE
 #include <MNN/AutoTime.hpp>
+#include "MNN_generated.h"
 #include "MNNTestSuite.h"
 using namespace MNN::Express;
-#define SAMPLE 10240
-#define NFFT 256
-#define HOP 128
 #define TIME 100
 class StftSpeed : public MNNTestCase {
 public:
+    static VARP _Stft(VARP signal, VARP window, int hop) {
+        using namespace MNN;
+        std::unique_ptr<OpT> op(new OpT);
+        op->type       = OpType_Stft;
+        op->main.type  = OpParameter_StftParam;
+        op->main.value = new StftParamT;
+        op->main.AsStftParam()->abs = true;
+        return Variable::create(Expr::create(std::move(op), {signal, _Scalar<int>(hop), window}));
+    }
     virtual bool run(int precision) {
-        auto x = _Input({SAMPLE}, NHWC);
-        auto w = _Input({NFFT}, NHWC);
-        auto y = _Stft(x, w, NFFT, HOP);
-        {
-            AUTOTIME;
-            for (int i = 0; i < TIME; ++i) {
+        // samples, n_fft, hop: 400 / 160 is the whisper frontend on 30s of 16kHz audio
+        std::vector<std::tuple<int, int, int>> cases = {
+            {10240, 256, 128},
+            {480000, 400, 160},
+        };
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        for (auto& iter : cases) {
+            auto sample = std::get<0>(iter);
+            auto nfft   = std::get<1>(iter);
+            auto hop    = std::get<2>(iter);
+            auto x      = _Input({1, sample, 1}, NHWC);
+            auto w      = _Input({nfft}, NHWC);
+            auto xPtr   = x->writeMap<float>();
+            for (int i = 0; i < sample; ++i) {
+                xPtr[i] = dist(rng);
+            }
+            auto wPtr = w->writeMap<float>();
+            for (int i = 0; i < nfft; ++i) {
+                wPtr[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / nfft);
+            }
+            auto y = _Stft(x, w, hop);
+            int time = sample > 100000 ? TIME / 10 : TIME;
+            MNN::Timer _t;
+            for (int i = 0; i < time; ++i) {
                 x->writeMap<float>();
-                w->writeMap<float>();
                 y->readMap<float>();
             }
+            float cost = (float)_t.durationInUs() / 1000.0f / (float)time;
+            MNN_PRINT("Test Speed for stft samples:%d, n_fft:%d, hop:%d, run %d, avgtime: %f ms\n", sample, nfft, hop, time, cost);
         }
         return true;
     }
 };
 MNNTestSuiteRegister(StftSpeed, "speed/stft");
-#endif // MNN_BUILD_AUDIO
\ No newline at end of file
@@ -0,0 +1,54 @@
+//
+//  TopKV2Speed.cpp
+//  MNNTests
+//
+//  Created by MNN on 2026/10/16.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#include <MNN/expr/Expr.hpp>
+#include <MNN/expr/ExprCreator.hpp>
+#include <random>
+#define MNN_OPEN_TIME_TRACE
+#include <MNN/AutoTime.hpp>
+#include "MNNTestSuite.h"
+using namespace MNN::Express;
+#define TIME 10
+class TopKV2Speed : public MNNTestCase {
+public:
+    void TopKV2Test() {
+        // rows, row size, k
+        std::vector<std::tuple<int, int, int>> rsk = {
+            {1, 1000000, 100},
+            {1, 100000, 1000},
+            {16, 100000, 100},
+            {1024, 1000, 10},
+        };
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        for (auto& iter : rsk) {
+            auto rows    = std::get<0>(iter);
+            auto rowSize = std::get<1>(iter);
+            auto k       = std::get<2>(iter);
+            auto x       = _Input({rows, rowSize}, NCHW);
+            auto ptr     = x->writeMap<float>();
+            for (int i = 0; i < rows * rowSize; ++i) {
+                ptr[i] = dist(rng);
+            }
+            auto kVar = _Scalar<int>(k);
+            auto outputs = _TopKV2(x, kVar);
+            MNN::Timer _t;
+            for (int i = 0; i < TIME; ++i) {
+                x->writeMap<float>();
+                outputs[0]->readMap<float>();
+            }
+            float cost = (float)_t.durationInUs() / 1000.0f / (float)TIME;
+            MNN_PRINT("Test Speed for topkv2 rows:%d, row size:%d, k:%d, run %d, avgtime: %f ms\n", rows, rowSize, k, TIME, cost);
+        }
+    }
+    virtual bool run(int precision) {
+        TopKV2Test();
+        return true;
+    }
+};
+MNNTestSuiteRegister(TopKV2Speed, "speed/TopKV2");
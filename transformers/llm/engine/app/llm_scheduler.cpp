@@ -0,0 +1,314 @@
+//
+// llm_scheduler.cpp
+//
+// Created by MNN on 2026/10/15.
+// Copyright (c) 2026 Alibaba Group Holding Limited All rights reserved.
+//
+
+#include "llm_scheduler.hpp"
+#include <algorithm>
+#include <iostream>
+#include <MNN/expr/ExecutorScope.hpp>
+#include "jsonhpp/json.hpp"
+
+using MNN::Transformer::Llm;
+using MNN::Transformer::LlmStatus;
+
+namespace mls {
+
+LlmScheduler::LlmScheduler(Llm* llm, int max_batch, int step_tokens) : step_tokens_(std::max(step_tokens, 0)) {
+  auto config = nlohmann::json::parse(llm->dump_config(), nullptr, false);
+  int thread_num = 4;
+  if (config.is_object()) {
+    thread_num = config.value("thread_num", 4);
+  }
+  // the slots run concurrently, split the threads between them instead of oversubscribing the cores
+  max_batch = std::max(max_batch, 1);
+  int slot_thread_num = std::max(1, thread_num / max_batch);
+  // a single slot reuses the given llm, otherwise every slot shares its weights but owns its context, kv cache
+  // and a runtime of slot_thread_num threads
+  for (int i = 0; i < max_batch; ++i) {
+    std::unique_ptr<Slot> slot(new Slot);
+    if (max_batch == 1) {
+      slot->llm = llm;
+    } else {
+      MNN::BackendConfig backend_config;
+      slot->executor = MNN::Express::Executor::newExecutor(MNN_FORWARD_CPU, backend_config, slot_thread_num);
+      MNN::Express::ExecutorScope scope(slot->executor);
+      slot->owned_llm.reset(llm->create_instance("{\"thread_num\": " + std::to_string(slot_thread_num) + "}"));
+      if (nullptr == slot->owned_llm) {
+        std::cerr << "LlmScheduler: create slot " << i << " failed, max batch is " << std::max(i, 1) << std::endl;
+        if (i == 0) {
+          // fall back to the given llm alone
+          slot->executor.reset();
+          slot->llm = llm;
+          slots_.emplace_back(std::move(slot));
+        }
+        break;
+      }
+      slot->llm = slot->owned_llm.get();
+    }
+    slots_.emplace_back(std::move(slot));
+  }
+  for (auto& slot : slots_) {
+    auto ptr = slot.get();
+    slot->worker = std::thread([this, ptr]() { WorkerLoop(ptr); });
+  }
+  loop_ = std::thread([this]() { Loop(); });
+}
+
+LlmScheduler::~LlmScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  loop_.join();
+  for (auto& slot : slots_) {
+    {
+      std::lock_guard<std::mutex> lock(slot->mutex);
+      slot->exit = true;
+    }
+    slot->cv.notify_one();
+    slot->worker.join();
+  }
+  // Make sure the owned llm is released in its own executor
+  for (auto& slot : slots_) {
+    if (nullptr != slot->executor) {
+      MNN::Express::ExecutorScope scope(slot->executor);
+      slot->owned_llm.reset();
+    }
+  }
+}
+
+std::future<void> LlmScheduler::Submit(std::shared_ptr<LlmRequest> request) {
+  Pending pending;
+  pending.request = std::move(request);
+  auto future = pending.promise.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_ || pending.request->messages.empty()) {
+      if (pending.request->on_finish) {
+        pending.request->on_finish(LlmStatus::USER_CANCEL);
+      }
+      pending.promise.set_value();
+      return future;
+    }
+    pending_.emplace_back(std::move(pending));
+  }
+  cv_.notify_one();
+  return future;
+}
+
+void LlmScheduler::Reset() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reset_ = true;
+  }
+  cv_.notify_one();
+}
+
+LlmSchedulerStats LlmScheduler::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+bool LlmScheduler::Finished(Slot* slot) {
+  auto context = slot->llm->getContext();
+  if (context->status == LlmStatus::INTERNAL_ERROR || context->status == LlmStatus::USER_CANCEL) {
+    return true;
+  }
+  if (slot->llm->stoped()) {
+    return true;
+  }
+  return slot->started && 0 == slot->prefill_remain && context->gen_seq_len >= slot->request->max_new_tokens;
+}
+
+void LlmScheduler::RunStep(Slot* slot) {
+  auto& request = *slot->request;
+  slot->prefill_step = 0;
+  if (!slot->started) {
+    slot->llm->setTokenCallback(request.on_token);
+    slot->llm->generate_init(request.os, request.end_with.c_str());
+    auto input_ids = slot->llm->tokenizer_encode(slot->llm->apply_chat_template(request.messages));
+    slot->prefill_remain = slot->llm->prefill_init(input_ids);
+    slot->started = true;
+  }
+  if (slot->prefill_remain > 0) {
+    // prefill only, the first token is sampled by the next decode step
+    auto remain = slot->llm->prefill_step(slot->prefill_budget);
+    slot->prefill_step = slot->prefill_remain - remain;
+    slot->prefill_remain = remain;
+    return;
+  }
+  slot->llm->generate(1);
+}
+
+void LlmScheduler::WorkerLoop(Slot* slot) {
+  std::unique_ptr<MNN::Express::ExecutorScope> scope;
+  if (nullptr != slot->executor) {
+    scope.reset(new MNN::Express::ExecutorScope(slot->executor));
+  }
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(slot->mutex);
+      slot->cv.wait(lock, [slot]() { return slot->has_work || slot->exit; });
+      if (slot->exit) {
+        break;
+      }
+      slot->has_work = false;
+    }
+    RunStep(slot);
+    std::lock_guard<std::mutex> lock(step_mutex_);
+    if (--step_remain_ == 0) {
+      step_cv_.notify_one();
+    }
+  }
+}
+
+void LlmScheduler::Loop() {
+  auto config = nlohmann::json::parse(slots_[0]->llm->dump_config(), nullptr, false);
+  int default_max_new_tokens = 512;
+  if (config.is_object()) {
+    default_max_new_tokens = config.value("max_new_tokens", 512);
+  }
+  std::vector<Slot*> active;
+  std::vector<int> gen_len;
+  while (true) {
+    active.clear();
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() {
+        if (stop_ || reset_ || !pending_.empty()) {
+          return true;
+        }
+        for (auto& slot : slots_) {
+          if (nullptr != slot->request) {
+            return true;
+          }
+        }
+        return false;
+      });
+      if (stop_) {
+        break;
+      }
+      if (reset_) {
+        for (auto& slot : slots_) {
+          if (nullptr == slot->request) {
+            std::unique_ptr<MNN::Express::ExecutorScope> scope;
+            if (nullptr != slot->executor) {
+              scope.reset(new MNN::Express::ExecutorScope(slot->executor));
+            }
+            slot->llm->reset();
+          }
+        }
+        reset_ = false;
+      }
+      // merge queued requests into free slots
+      for (auto& slot : slots_) {
+        if (pending_.empty()) {
+          break;
+        }
+        if (nullptr != slot->request) {
+          continue;
+        }
+        auto& front = pending_.front();
+        slot->request = std::move(front.request);
+        slot->promise = std::move(front.promise);
+        slot->started = false;
+        slot->prefill_remain = 0;
+        if (slot->request->max_new_tokens < 0) {
+          slot->request->max_new_tokens = default_max_new_tokens;
+        }
+        pending_.pop_front();
+      }
+      int decoding = 0;
+      for (auto& slot : slots_) {
+        if (nullptr != slot->request && slot->started && 0 == slot->prefill_remain) {
+          decoding++;
+        }
+      }
+      // a slot not started yet doesn't know its prompt length, it takes all that is left
+      int budget = std::max(step_tokens_ - decoding, 1);
+      for (auto& slot : slots_) {
+        if (nullptr == slot->request) {
+          continue;
+        }
+        bool prefilling = !slot->started || slot->prefill_remain > 0;
+        if (prefilling && step_tokens_ > 0) {
+          if (budget <= 0) {
+            continue;
+          }
+          slot->prefill_budget = slot->started ? std::min(budget, slot->prefill_remain) : budget;
+          budget = slot->started ? budget - slot->prefill_budget : 0;
+        } else if (prefilling) {
+          slot->prefill_budget = 0;
+        }
+        active.emplace_back(slot.get());
+      }
+    }
+    if (active.empty()) {
+      continue;
+    }
+    gen_len.resize(active.size());
+    for (int i = 0; i < active.size(); ++i) {
+      gen_len[i] = active[i]->llm->getContext()->gen_seq_len;
+    }
+    {
+      std::lock_guard<std::mutex> lock(step_mutex_);
+      step_remain_ = static_cast<int>(active.size());
+    }
+    for (auto slot : active) {
+      {
+        std::lock_guard<std::mutex> lock(slot->mutex);
+        slot->has_work = true;
+      }
+      slot->cv.notify_one();
+    }
+    {
+      std::unique_lock<std::mutex> lock(step_mutex_);
+      step_cv_.wait(lock, [this]() { return step_remain_ == 0; });
+    }
+    // split finished requests out of the batch
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.steps++;
+    stats_.batched_sequences += active.size();
+    for (int i = 0; i < active.size(); ++i) {
+      auto slot = active[i];
+      auto context = slot->llm->getContext();
+      stats_.prefill_tokens += slot->prefill_step;
+      stats_.decode_tokens += context->gen_seq_len - gen_len[i];
+      if (!Finished(slot)) {
+        continue;
+      }
+      stats_.finished_requests++;
+      // on_token may capture the stack of the waiting caller, never call it once the promise is fulfilled
+      slot->llm->setTokenCallback(nullptr);
+      if (slot->request->on_finish) {
+        slot->request->on_finish(context->status);
+      }
+      slot->promise.set_value();
+      slot->request.reset();
+    }
+  }
+  // cancel everything still in flight
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& slot : slots_) {
+    if (nullptr != slot->request) {
+      slot->llm->setTokenCallback(nullptr);
+      if (slot->request->on_finish) {
+        slot->request->on_finish(LlmStatus::USER_CANCEL);
+      }
+      slot->promise.set_value();
+      slot->request.reset();
+    }
+  }
+  for (auto& pending : pending_) {
+    if (pending.request->on_finish) {
+      pending.request->on_finish(LlmStatus::USER_CANCEL);
+    }
+    pending.promise.set_value();
+  }
+  pending_.clear();
+}
+}
@@ -0,0 +1,104 @@
+//
+// llm_scheduler.hpp
+//
+// Created by MNN on 2026/10/15.
+// Copyright (c) 2026 Alibaba Group Holding Limited All rights reserved.
+//
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <MNN/expr/Executor.hpp>
+#include "llm/llm.hpp"
+
+namespace mls {
+
+struct LlmRequest {
+  MNN::Transformer::ChatMessages messages;
+  // -1 means using max_new_tokens of llm config
+  int max_new_tokens{-1};
+  // decoded text is written here while the request is running
+  std::ostream* os{nullptr};
+  // appended to os when a stop token is sampled
+  std::string end_with;
+  // called for every sampled token from the slot worker, see Llm::setTokenCallback; returning false cancels
+  std::function<bool(int token, const char* text, size_t size, bool last)> on_token{};
+  // called once from the scheduler thread when the request leaves the batch
+  std::function<void(MNN::Transformer::LlmStatus status)> on_finish{};
+};
+
+struct LlmSchedulerStats {
+  int64_t steps{0};
+  int64_t prefill_tokens{0};
+  int64_t decode_tokens{0};
+  int64_t finished_requests{0};
+  // sum of active sequences over all steps, divide by steps for the mean batch size
+  int64_t batched_sequences{0};
+};
+
+// Continuous batching scheduler: keeps up to max_batch conversations in flight, each
+// one in its own slot with a private LlmContext and kv cache. Every step runs one
+// prefill chunk or one decode token for all active slots concurrently; finished
+// requests are split out and queued ones are merged in between two steps.
+// step_tokens bounds the tokens of a step: prompts are prefilled in chunks of what
+// the decoding requests leave, first admitted first, so a long prompt doesn't stall
+// their inter-token latency. 0 prefills a whole prompt in one step.
+class LlmScheduler {
+ public:
+  LlmScheduler(MNN::Transformer::Llm* llm, int max_batch, int step_tokens = 0);
+  ~LlmScheduler();
+  std::future<void> Submit(std::shared_ptr<LlmRequest> request);
+  // reset the idle slots before the next step
+  void Reset();
+  LlmSchedulerStats GetStats();
+  int MaxBatch() const { return static_cast<int>(slots_.size()); }
+
+ private:
+  struct Slot {
+    std::shared_ptr<MNN::Express::Executor> executor;
+    std::unique_ptr<MNN::Transformer::Llm> owned_llm;
+    MNN::Transformer::Llm* llm{nullptr};
+    std::shared_ptr<LlmRequest> request;
+    std::promise<void> promise;
+    bool started{false};
+    // prompt tokens left to prefill, the most to forward in this step and the number forwarded
+    int prefill_remain{0};
+    int prefill_budget{0};
+    int prefill_step{0};
+    // worker handshake
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool has_work{false};
+    bool exit{false};
+  };
+  struct Pending {
+    std::shared_ptr<LlmRequest> request;
+    std::promise<void> promise;
+  };
+  void Loop();
+  void WorkerLoop(Slot* slot);
+  void RunStep(Slot* slot);
+  bool Finished(Slot* slot);
+
+  std::vector<std::unique_ptr<Slot>> slots_;
+  std::deque<Pending> pending_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_{false};
+  bool reset_{false};
+  int step_tokens_{0};
+  int step_remain_{0};
+  std::mutex step_mutex_;
+  std::condition_variable step_cv_;
+  LlmSchedulerStats stats_;
+  std::thread loop_;
+};
+}
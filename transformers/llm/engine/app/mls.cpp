@@ -136,7 +136,7 @@ static int print_usage() {
     std::cout << "  mls download model_name : download the model" << std::endl;
     std::cout << "  mls run  model_name : download the model" << std::endl;
     std::cout << "  mls benchmark:  model_name test benchmark of a model" << std::endl;
-    std::cout << "  mls serve: serve with openai compatible api" << std::endl;
+    std::cout << "  mls serve: serve with openai compatible api, -b max_batch to decode several requests together (thread_num is split between them), -s step_tokens to prefill long prompts in chunks between decode steps" << std::endl;
     std::cout << "  mls delete model_name: remove the download model" << std::endl;
     return 0;
 }
@@ -164,6 +164,8 @@ static bool IsR1(const std::string& path) {
 
 static int serve(int argc, const char *argv[]) {
     bool invalid_param{false};
+    int max_batch = 1;
+    int step_tokens = 0;
     std::string config_path{};
     std::string arg{};
     if (argc < 3) {
@@ -182,12 +184,24 @@ static int serve(int argc, const char *argv[]) {
                 break;
             }
             config_path = mls::FileUtils::ExpandTilde(argv[i]);
+        } else if (arg == "-b") {
+            if (++i >= argc) {
+                invalid_param = true;
+                break;
+            }
+            max_batch = std::atoi(argv[i]);
+        } else if (arg == "-s") {
+            if (++i >= argc) {
+                invalid_param = true;
+                break;
+            }
+            step_tokens = std::atoi(argv[i]);
         }
     }
     mls::MlsServer server;
     bool is_r1 = IsR1(config_path);
     auto llm = create_and_prepare_llm(config_path.c_str(), !is_r1);
-    server.Start(llm.get(), is_r1);
+    server.Start(llm.get(), is_r1, max_batch, step_tokens);
     return 0;
 }
 
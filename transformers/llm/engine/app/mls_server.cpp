@@ -90,27 +90,20 @@ void MlsServer::Answer(MNN::Transformer::Llm* llm, const json &messages, std::fu
       prompts.push_back(item);
     }
   }
-  std::stringstream response_buffer;
-  Utf8StreamProcessor processor([&response_buffer, on_result](const std::string& utf8Char) {
-    bool is_eop = utf8Char.find("<eop>") != std::string::npos;
-    if (!is_eop) {
-        response_buffer << utf8Char;
-    } else {
-        std::string response_result =  response_buffer.str();
-        on_result(response_result);
-    }
-    }
-  );
-  LlmStreamBuffer stream_buffer{[&processor](const char* str, size_t len){
-    processor.processStream(str, len);
-  }};
-  std::ostream output_ostream(&stream_buffer);std::lock_guard<std::mutex> lock(llm_mutex_);
-  llm->response(this->is_r1_ ? ConvertToR1(prompts) : prompts, &output_ostream, "<eop>");
+  std::string answer;
+  auto request = std::make_shared<LlmRequest>();
+  request->messages = this->is_r1_ ? ConvertToR1(prompts) : prompts;
+  request->on_token = [&answer](int token, const char* text, size_t size, bool last) {
+    answer.append(text, size);
+    return true;
+  };
+  scheduler_->Submit(request).wait();
+  on_result(answer);
 }
 
 void MlsServer::AnswerStreaming(MNN::Transformer::Llm* llm,
                      const json& messages,
-                     std::function<void(const std::string&, bool end)> on_partial) {
+                     std::function<bool(const std::string&, bool end)> on_partial) {
     std::vector<PromptItem> prompts;
     if (messages.is_array()) {
         for (const auto& item_json : messages) {
@@ -123,25 +116,20 @@ void MlsServer::AnswerStreaming(MNN::Transformer::Llm* llm,
         }
     }
     std::string answer = "";
-    Utf8StreamProcessor processor([&on_partial, &answer](const std::string &utf8Char) {
-        bool is_eop = (utf8Char.find("<eop>") != std::string::npos);
-        if (is_eop) {
-            std::string response_result = answer;
-            std::cout<<"response result: "<<response_result<<std::endl;
-            on_partial("", true);
-        } else {
-            answer += utf8Char;
-            on_partial(utf8Char, false);
+    auto request = std::make_shared<LlmRequest>();
+    request->messages = this->is_r1_ ? ConvertToR1(prompts) : prompts;
+    // text arrives in complete utf-8 characters, stop generating once the client is gone
+    request->on_token = [&on_partial, &answer](int token, const char* text, size_t size, bool last) {
+        if (0 == size) {
+            return true;
         }
-    });
-
-    // LlmStreamBuffer calls our lambda as new bytes arrive from the LLM
-    LlmStreamBuffer stream_buffer([&processor](const char* str, size_t len) {
-        processor.processStream(str, len);
-    });
-    std::ostream output_ostream(&stream_buffer);
-    std::lock_guard<std::mutex> lock(llm_mutex_);
-    llm->response(this->is_r1_ ? ConvertToR1(prompts) : prompts, &output_ostream, "<eop>");
+        std::string partial(text, size);
+        answer += partial;
+        return on_partial(partial, false);
+    };
+    scheduler_->Submit(request).wait();
+    std::cout<<"response result: "<<answer<<std::endl;
+    on_partial("", true);
 }
 
 
@@ -152,8 +140,10 @@ void AllowCors(httplib::Response& res) {
     res.set_header("Access-Control-Allow-Headers",  "Content-Type, Authorization");
 }
 
-void MlsServer::Start(MNN::Transformer::Llm* llm, bool is_r1) {
+void MlsServer::Start(MNN::Transformer::Llm* llm, bool is_r1, int max_batch, int step_tokens) {
     this->is_r1_ = is_r1;
+    scheduler_.reset(new LlmScheduler(llm, max_batch, step_tokens));
+    std::cout << "Scheduler max batch: " << scheduler_->MaxBatch() << ", step tokens: " << step_tokens << "\n";
     // Create a server instance
     httplib::Server server;
 
@@ -165,7 +155,7 @@ void MlsServer::Start(MNN::Transformer::Llm* llm, bool is_r1) {
     server.Post("/reset", [&](const httplib::Request &req, httplib::Response &res) {
       printf("POST /reset\n");
       AllowCors(res);
-      llm->reset();
+      scheduler_->Reset();
       res.set_content("{\"status\": \"ok\"}", "application/json");
     });
     server.Options("/chat/completions", [](const httplib::Request& /*req*/, httplib::Response& res) {
@@ -243,8 +233,7 @@ void MlsServer::Start(MNN::Transformer::Llm* llm, bool is_r1) {
                         })}
                     };
                     std::string chunk_str = "data: " + sse_json.dump() + "\n\n";
-                    sink.os.write(chunk_str.c_str(), chunk_str.size());
-                    sink.os.flush();
+                    return sink.write(chunk_str.c_str(), chunk_str.size());
                 };
                 AnswerStreaming(llm, messages, sse_callback);
                 std::string done_str = "data: [DONE]\n\n";
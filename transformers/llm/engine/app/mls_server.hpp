@@ -7,60 +7,10 @@
 #include "llm/llm.hpp"
 #include "httplib.h"
 #include "jsonhpp/json.hpp"
+#include "llm_scheduler.hpp"
 using nlohmann::json;
 using PromptItem = std::pair<std::string, std::string>;
 namespace mls {
-class LlmStreamBuffer : public std::streambuf {
-public:
-  using CallBack = std::function<void(const char* str, size_t len)>;
-  explicit LlmStreamBuffer(CallBack callback) : callback_(std::move(callback)) {}
-  ~LlmStreamBuffer() override = default;
-protected:
-  virtual std::streamsize xsputn(const char* s, std::streamsize n) override {
-    if (callback_) {
-      callback_(s, n);
-    }
-    return n;
-  }
-
-private:
-  CallBack callback_{};
-};
-
-class Utf8StreamProcessor {
-  public:
-    Utf8StreamProcessor(std::function<void(const std::string&)> callback)
-            : callback(callback) {}
-
-    void processStream(const char* str, size_t len) {
-      utf8Buffer.append(str, len);
-
-      size_t i = 0;
-      std::string completeChars;
-      while (i < utf8Buffer.size()) {
-        int length = utf8CharLength(static_cast<unsigned char>(utf8Buffer[i]));
-        if (length == 0 || i + length > utf8Buffer.size()) {
-          break;
-        }
-        completeChars.append(utf8Buffer, i, length);
-        i += length;
-      }
-      utf8Buffer = utf8Buffer.substr(i);
-      if (!completeChars.empty()) {
-        callback(completeChars);
-      }
-    }
-    int utf8CharLength(unsigned char byte) {
-      if ((byte & 0x80) == 0) return 1;     
-      if ((byte & 0xE0) == 0xC0) return 2;
-      if ((byte & 0xF0) == 0xE0) return 3;
-      if ((byte & 0xF8) == 0xF0) return 4;
-      return 0;
-    }
-  private:
-    std::string utf8Buffer;
-    std::function<void(const std::string&)> callback;
-  };
 class MlsServer {
   public:
     const char* html_content = R"""(
@@ -258,14 +208,16 @@ class MlsServer {
 </body>
 </html>
     )""";
-    void Start(MNN::Transformer::Llm* llm, bool is_r1);
+    // max_batch: number of conversations decoded together by the scheduler
+    // step_tokens: token budget of a scheduler step, long prompts are prefilled in chunks, 0 for no limit
+    void Start(MNN::Transformer::Llm* llm, bool is_r1, int max_batch = 1, int step_tokens = 0);
     bool is_r1_{false};
 private:
   void Answer(MNN::Transformer::Llm* llm, const json &messages, std::function<void(const std::string&)> on_result);
   void AnswerStreaming(MNN::Transformer::Llm* llm,
                      const json& messages,
-                     std::function<void(const std::string&, bool end)> on_partial);
-    std::mutex llm_mutex_;
+                     std::function<bool(const std::string&, bool end)> on_partial);
+    std::unique_ptr<LlmScheduler> scheduler_;
 
 };
 }
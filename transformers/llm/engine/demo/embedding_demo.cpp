@@ -6,6 +6,7 @@
 //
 
 #include "llm/llm.hpp"
+#include <MNN/AutoTime.hpp>
 #include <fstream>
 #include <stdlib.h>
 
@@ -48,17 +49,6 @@ static void dumpVARP(VARP var) {
     printf(" ]\n");
 }
 
-static void unittest(std::unique_ptr<Embedding> &embedding, std::string prompt) {
-    auto vec_0 = embedding->txt_embedding(prompt);
-    float sum = 0;
-    auto ptr = vec_0->readMap<float>();
-    for (int i = 0;i < vec_0->getInfo()->size; ++i) {
-        sum += ptr[i];
-    }
-    MNN_PRINT("%s\n", prompt.c_str());
-    MNN_PRINT("sum = %f\n", sum);
-    MNN_PRINT("\n");
-}
 static void benchmark(std::unique_ptr<Embedding> &embedding, std::string prompt_file) {
     std::ifstream prompt_fs(prompt_file);
     std::vector<std::string> prompts;
@@ -70,9 +60,23 @@ static void benchmark(std::unique_ptr<Embedding> &embedding, std::string prompt_
         prompts.push_back(prompt);
     }
     prompt_fs.close();
-    for (auto& p: prompts) {
-        unittest(embedding, p);
+    MNN::Timer _t;
+    auto vecs = embedding->txt_embeddings(prompts);
+    auto cost = _t.durationInUs() / 1000.0f;
+    for (int i = 0; i < vecs.size(); ++i) {
+        if (nullptr == vecs[i]) {
+            continue;
+        }
+        float sum = 0;
+        auto ptr = vecs[i]->readMap<float>();
+        for (int j = 0; j < vecs[i]->getInfo()->size; ++j) {
+            sum += ptr[j];
+        }
+        MNN_PRINT("%s\n", prompts[i].c_str());
+        MNN_PRINT("sum = %f\n", sum);
+        MNN_PRINT("\n");
     }
+    MNN_PRINT("embedding %d prompts cost %.2f ms\n", (int)prompts.size(), cost);
 }
 
 int main(int argc, const char* argv[]) {
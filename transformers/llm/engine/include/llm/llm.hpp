@@ -33,6 +33,7 @@ class Sampler;
 class Prompt;
 class Generation;
 class EagleGeneration;
+class PrefixCache;
 struct TimePerformance;
 
 using ChatMessage = std::pair<std::string, std::string>; // <role, content>
@@ -70,6 +71,15 @@ enum class MatchStrictLevel : int;
 enum class NgramSelectRule : int;
 
 struct KVMeta;
+struct PrefixCacheInfo {
+    // responses reusing / not reusing a cached prefix
+    int64_t hit = 0;
+    int64_t miss = 0;
+    // prefill tokens skipped by the cache
+    int64_t hit_tokens = 0;
+    int64_t blocks = 0;
+    int64_t evicted = 0;
+};
 struct LlmContext {
     // forward
     int prompt_len = 0;
@@ -117,11 +127,16 @@ public:
     virtual std::vector<Express::VARP> forwardRaw(Express::VARP hiddenState, Express::VARP mask, Express::VARP inputPos, Express::VARPS extraArgs = {});
     Express::VARP forward(const std::vector<int>& input_ids, bool is_prefill = true);
     Express::VARP forward(MNN::Express::VARP input_embeds);
+    // Forward independent sequences in one batch, each one continues the current history but can't see the others.
+    // The history is kept as is, returns the logits of the last token of every sequence, [1, sequences.size(), vocab]
+    Express::VARP forwardSequences(const std::vector<std::vector<int>>& sequences);
     void switchMode(Stage stage);
     void setKVCacheInfo(size_t add, size_t remove, int* reserve = nullptr, int n_reserve = 0);
     size_t getCurrentHistory() const;
     void eraseHistory(size_t begin, size_t end);
     bool setPrefixCacheFile(const std::string& filename, int flag = 0);
+    // statistics of the in-memory prefix cache enabled by config 'prefix_cache_blocks'
+    PrefixCacheInfo getPrefixCacheInfo() const;
     virtual void response(const std::vector<int>& input_ids, std::ostream* os = &std::cout, const char* end_with = nullptr, int max_new_tokens = -1);
     void response(const std::string& user_content, std::ostream* os = &std::cout, const char* end_with = nullptr, int max_new_tokens = -1);
     void response(const ChatMessages& chat_prompts, std::ostream* os = &std::cout, const char* end_with = nullptr, int max_new_tokens = -1);
@@ -130,12 +145,21 @@ public:
     void generate(int max_token);
     std::vector<int> generate(const std::vector<int>& input_ids, int max_new_tokens = -1);
     std::vector<int> generate(MNN::Express::VARP input_embeds, int max_tokens = -1);
+    // Prefill a prompt in pieces, so that a scheduler can interleave it with the decode of other sequences.
+    // prefill_init is called after generate_init and returns the number of tokens to forward (a prefix found
+    // in the prefix cache is skipped), each prefill_step forwards at most max_tokens (<= 0: all) of them and
+    // returns the number left. Once it is 0, generate(1) samples the first token.
+    int prefill_init(const std::vector<int>& input_ids);
+    int prefill_step(int max_tokens);
     bool stoped();
     bool reuse_kv();
     // config function
     std::string dump_config();
     bool set_config(const std::string& content);
     Llm* create_lora(const std::string& lora_path);
+    // create a text llm sharing weights with this one, but owning its own context and kv cache,
+    // config is merged into a copy of this llm's config before loading, eg: {"thread_num": 2}
+    Llm* create_instance(const std::string& config = "");
     // tokenier function
     bool is_stop(int token);
     std::string tokenizer_decode(int token);
@@ -153,6 +177,10 @@ public:
         return mContext.get();
     }
     virtual void setWavformCallback(std::function<bool(const float*, size_t, bool)> callback) {}
+    // Called from the generating thread for every sampled token, with the decoded bytes that complete
+    // utf-8 characters since the previous call (possibly none), valid only during the call. last is true
+    // for the stop token. Returning false cancels the response; empty callback to remove
+    void setTokenCallback(std::function<bool(int token, const char* text, size_t size, bool last)> callback);
     virtual void generateWavform() {}
 protected:
     void initRuntime();
@@ -175,20 +203,32 @@ protected:
     std::map<std::pair<int, bool>, std::shared_ptr<Express::Module>> mModulePool;
     const Express::Module* mBaseModule = nullptr;
     Express::VARP inputsEmbeds, attentionMask, positionIds;
+    // single element mask fed when the attention computes the mask itself, see KVMeta::mask_mode
+    Express::VARP mImplicitMask;
     std::vector<Express::VARP> mAttentionMaskVarVec, mPositionIdsVarVec;
     Express::VARP logitsAllIdx, logitsLastIdx;
     int mSeqLenIndex = 0;
 protected:
+    friend class Generation;
     friend class ArGeneration;
     friend class LookaheadGeneration;
     friend class MtpGeneration;
     friend class EagleGeneration;
+    friend class DraftModelGeneration;
     std::vector<Express::VARP> forwardVec(const std::vector<int>& input_ids);
     std::vector<Express::VARP> forwardVec(MNN::Express::VARP input_embeds);
+    // logitsIndex == nullptr: choose the last or all logits as forwardRaw does
+    std::vector<Express::VARP> forwardModule(Express::VARP hiddenState, Express::VARP mask, Express::VARP inputPos, Express::VARP logitsIndex, Express::VARPS extraArgs = {});
+    // decode an accepted token into generate_str, os and the token callback
+    void outputToken(int token);
+    // write end_with and flush the rest of generate_str when a stop token is sampled
+    void outputStop(int token);
 private:
     std::shared_ptr<Generation> mGenerationStrategy;
     void setSpeculativeConfig();
     void updateContext(int seq_len, int gen_len);
+    int beginPrefixCache(const std::vector<int>& input_ids);
+    void endPrefixCache();
 private:
     bool mInSpec = false;
     int mDraftLength = 4;
@@ -197,10 +237,19 @@ private:
     int mBlockSize = 0;
     std::vector<int> mValidBlockSize;
     bool mPrefixCacheMode = false;
+    std::shared_ptr<PrefixCache> mPrefixCache;
+    std::vector<std::shared_ptr<void>> mPrefixBlocks;
     std::string mPrefixCacheFileName;
     int mCallIndex;
     int mPrefixLength;
     bool mIsPrefixFileExist = false;
+    // prompt of prefill_init not forwarded yet from mPrefillOffset
+    std::vector<int> mPrefillIds;
+    int mPrefillOffset = 0;
+    int mPrefillLength = 0;
+    std::function<bool(int, const char*, size_t, bool)> mTokenCallback;
+    // bytes of generate_str already passed to mTokenCallback
+    size_t mTokenCallbackSize = 0;
 };
 
 // Embedding start
@@ -214,6 +263,10 @@ public:
 
     Express::VARP ids_embedding(const std::vector<int>& ids);
     Express::VARP txt_embedding(const std::string& txt);
+    // Batched embeddings: inputs of similar lengths are padded into batches of at most batch_size,
+    // results keep the order of the inputs
+    std::vector<Express::VARP> ids_embeddings(const std::vector<std::vector<int>>& ids);
+    std::vector<Express::VARP> txt_embeddings(const std::vector<std::string>& txts, int batch_size = 16);
     std::vector<Express::VARP> forwardRaw(Express::VARP hiddenState, Express::VARP mask, Express::VARP inputPos, Express::VARPS extraArgs = {}) override;
     int dim() const;
     virtual Express::VARP gen_attention_mask(int seq_len) override;
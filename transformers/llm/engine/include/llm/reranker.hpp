@@ -84,7 +84,6 @@ public:
      */
     void initialize(const std::string& config_path) override {
         mLlm.reset(Llm::createLLM(config_path));
-        mLlm->set_config("{\"all_logits\":true}");
     }
 
     /**
@@ -104,8 +103,18 @@ public:
         mInstruct = instruct;
     }
 
+    /**
+     * @brief Sets the token budget of one batch of documents.
+     * @param tokens Max number of document tokens forwarded together, a longer document is forwarded alone.
+     */
+    void setMaxBatchTokens(int tokens) {
+        mMaxBatchTokens = tokens;
+    }
+
     /**
      * @brief Computes scores for a list of documents using the Qwen3 model.
+     * The instruct and query prefix is computed once, then the documents are scored in batches, each one
+     * continuing the prefix in the kvcache without seeing the other documents.
      * @param query The input query.
      * @param documents A vector of document strings.
      * @return A vector of float scores, one for each document.
@@ -114,87 +123,54 @@ public:
         std::string prefix = "<|im_start|>system\nJudge whether the Document meets the requirements based on the Query and the Instruct provided. Note that the answer can only be \"yes\" or \"no\".<|im_end|>\n<|im_start|>user\n";
         prefix = prefix + "<Instruct>: " + mInstruct + "\n<Query>: " + query + "\n<Document>: ";
         auto suffix = "<|im_end|>\n<|im_start|>assistant\n<think>\n\n</think>\n\n";
-        auto input_ids = mLlm->tokenizer_encode(prefix);
-        auto suffix_ids = mLlm->tokenizer_encode(suffix);
-        std::vector<int> position_ids_;
-        std::vector<std::pair<int, int>> spans;
-        int prefix_len = input_ids.size();
-        int suffix_len = suffix_ids.size();
-        int current_len = prefix_len;
-        for (int i = 0; i < current_len; i++) {
-            position_ids_.push_back(i);
+        std::vector<float> scores(documents.size(), 0.0f);
+        if (documents.empty()) {
+            return scores;
         }
-        for (const auto& doc : documents) {
-            auto doc_ids = mLlm->tokenizer_encode(doc);
-            input_ids.insert(input_ids.end(), doc_ids.begin(), doc_ids.end());
-            input_ids.insert(input_ids.end(), suffix_ids.begin(), suffix_ids.end());
-            int doc_len = doc_ids.size() + suffix_len;
-            int start_idx = current_len;
-            int end_idx = current_len + doc_len;
-            spans.emplace_back(start_idx, end_idx);
-            current_len = end_idx;
-            for (int i = prefix_len; i < prefix_len + doc_len; i++) {
-                position_ids_.push_back(i);
-            }
+        auto prefix_ids = mLlm->tokenizer_encode(prefix);
+        auto suffix_ids = mLlm->tokenizer_encode(suffix);
+        std::vector<std::vector<int>> doc_ids(documents.size());
+        for (int i = 0; i < documents.size(); i++) {
+            doc_ids[i] = mLlm->tokenizer_encode(documents[i]);
+            doc_ids[i].insert(doc_ids[i].end(), suffix_ids.begin(), suffix_ids.end());
         }
-        int total_len = input_ids.size();
-        // printf("Total input length: %d\n", total_len);
-        // input_embeds
-        auto input_embeds = mLlm->embedding(input_ids);
-        // attention mask
-        auto attention_mask = _Input({1, 1, total_len, total_len}, NCHW, halide_type_of<float>());
-        auto ptr = attention_mask->writeMap<float>();
-        for (int i = 0; i < total_len; i++) {
-            for (int j = 0; j < total_len; j++) {
-                ptr[total_len * i + j] = (j > i) * std::numeric_limits<float>::lowest();
-            }
+        // clear history cache and compute the shared prefix
+        mLlm->reset();
+        if (nullptr == mLlm->forward(prefix_ids)) {
+            mLlm->reset();
+            return scores;
         }
-        for (int i = 0; i < spans.size(); i++) {
-            for (int j = 0; j < spans.size(); j++) {
-                if (i == j) {
-                    continue;
-                }
-                int start_i = spans[i].first;
-                int end_i = spans[i].second;
-                int start_j = spans[j].first;
-                int end_j = spans[j].second;
-                for (int k = start_i; k < end_i; k++) {
-                    for (int l = start_j; l < end_j; l++) {
-                        ptr[total_len * k + l] = std::numeric_limits<float>::lowest();
-                    }
+        int begin = 0;
+        while (begin < documents.size()) {
+            std::vector<std::vector<int>> batch;
+            int batch_tokens = 0;
+            int end = begin;
+            for (; end < documents.size(); end++) {
+                int tokens = doc_ids[end].size();
+                if (!batch.empty() && batch_tokens + tokens > mMaxBatchTokens) {
+                    break;
                 }
+                batch_tokens += tokens;
+                batch.emplace_back(std::move(doc_ids[end]));
             }
+            auto logits = mLlm->forwardSequences(batch);
+            if (nullptr == logits || nullptr == logits->readMap<float>()) {
+                break;
+            }
+            auto logits_dim = logits->getInfo()->dim[2];
+            auto logits_ptr = logits->readMap<float>();
+            for (int i = 0; i < batch.size(); i++) {
+                float true_logit = logits_ptr[i * logits_dim + mTokenTrueId];
+                float false_logit = logits_ptr[i * logits_dim + mTokenFalseId];
+                // logsoftmax
+                float max_logit = std::max(true_logit, false_logit);
+                float exp_true = std::exp(true_logit - max_logit);
+                float exp_false = std::exp(false_logit - max_logit);
+                scores[begin + i] = exp_true / (exp_true + exp_false);
+            }
+            begin = end;
         }
-        // position ids
-        auto position_ids = _Input({1, total_len}, NCHW, halide_type_of<int>());
-        auto pos_ptr = position_ids->writeMap<int>();
-        for (int i = 0; i < total_len; i++) {
-            pos_ptr[i] = position_ids_[i];
-        }
-
-        // clear history cache
-        mLlm->setKVCacheInfo(total_len, mLlm->getCurrentHistory());
-        // forward
-        auto logits = mLlm->forwardRaw(input_embeds, attention_mask, position_ids)[0];
-        auto logits_dim = logits->getInfo()->dim[2];
-        auto logits_ptr = logits->readMap<float>();
-
         mLlm->reset();
-        std::vector<float> scores;
-        for (int i = 0; i < spans.size(); i++) {
-            int logits_idx = spans[i].second - 1;
-            float true_logit = logits_ptr[logits_idx * logits_dim + mTokenTrueId];
-            float false_logit = logits_ptr[logits_idx * logits_dim + mTokenFalseId];
-            // logsoftmax
-            float max_logit = std::max(true_logit, false_logit);
-            float stable_true_logit = true_logit - max_logit;
-            float stable_false_logit = false_logit - max_logit;
-            float exp_true = std::exp(stable_true_logit);
-            float exp_false = std::exp(stable_false_logit);
-            float score = exp_true / (exp_true + exp_false);
-            scores.push_back(score);
-        }
-
         return scores;
     }
 
@@ -202,6 +178,7 @@ private:
     std::string mInstruct;
     int mTokenTrueId;
     int mTokenFalseId;
+    int mMaxBatchTokens = 1024;
 };
 
 template <typename T>
@@ -5,6 +5,9 @@
 //  Copyright © 2018, Alibaba Group Holding Limited
 //
 
+#include <algorithm>
+#include <future>
+#include <numeric>
 #include "llm/llm.hpp"
 #include "llmconfig.hpp"
 #include "prompt.hpp"
@@ -95,6 +98,100 @@ VARP Embedding::txt_embedding(const std::string& txt) {
     return ids_embedding(tokenizer_encode(prompt));
 }
 
+std::vector<VARP> Embedding::ids_embeddings(const std::vector<std::vector<int>>& ids) {
+    std::vector<VARP> results;
+    int batch = static_cast<int>(ids.size());
+    if (batch <= 1 || !mConfig->embedding_batch()) {
+        for (auto& input_ids : ids) {
+            results.push_back(ids_embedding(input_ids));
+        }
+        return results;
+    }
+    int seq_len = 0;
+    for (auto& input_ids : ids) {
+        seq_len = std::max(seq_len, static_cast<int>(input_ids.size()));
+    }
+    // right padding, the padded keys are masked out and the pooled first token is never a pad
+    std::vector<int> padded_ids(batch * seq_len, 0);
+    auto attention_mask = _Input({batch, 1, seq_len, seq_len}, NCHW, halide_type_of<float>());
+    auto mask_ptr = attention_mask->writeMap<float>();
+    for (int b = 0; b < batch; b++) {
+        int len = static_cast<int>(ids[b].size());
+        ::memcpy(padded_ids.data() + b * seq_len, ids[b].data(), len * sizeof(int));
+        for (int i = 0; i < seq_len; i++) {
+            for (int j = 0; j < seq_len; j++) {
+                mask_ptr[(b * seq_len + i) * seq_len + j] = j < len ? 1.0f : 0.0f;
+            }
+        }
+    }
+    auto inputs_ids   = _Reshape(embedding(padded_ids), {batch, seq_len, dim()});
+    auto position_ids = gen_position_ids(seq_len);
+    auto outputs      = forwardRaw(inputs_ids, attention_mask, position_ids);
+    if (outputs.empty() || nullptr == outputs[0]->readMap<float>()) {
+        MNN_ERROR("Embedding batch of %d x %d failed\n", batch, seq_len);
+        return results;
+    }
+    auto info = outputs[0]->getInfo();
+    int size  = static_cast<int>(info->size) / batch;
+    auto ptr  = outputs[0]->readMap<float>();
+    for (int b = 0; b < batch; b++) {
+        auto var = _Input({1, size}, info->order, halide_type_of<float>());
+        ::memcpy(var->writeMap<float>(), ptr + b * size, size * sizeof(float));
+        results.push_back(var);
+    }
+    return results;
+}
+
+std::vector<VARP> Embedding::txt_embeddings(const std::vector<std::string>& txts, int batch_size) {
+    int total = static_cast<int>(txts.size());
+    std::vector<VARP> results(total);
+    batch_size = std::max(batch_size, 1);
+    // The inputs are bucketed by length inside a window, the next window is tokenized on a worker
+    // thread while the buckets of the current one are forwarded
+    const int window = batch_size * 8;
+    auto tokenize = [this, &txts, total, window](int begin) {
+        std::vector<std::vector<int>> ids;
+        for (int i = begin; i < std::min(begin + window, total); i++) {
+            ids.emplace_back(tokenizer_encode(apply_chat_template(txts[i])));
+        }
+        return ids;
+    };
+    std::future<std::vector<std::vector<int>>> pending;
+    if (total > 0) {
+        pending = std::async(std::launch::async, tokenize, 0);
+    }
+    for (int begin = 0; begin < total; begin += window) {
+        auto ids = pending.get();
+        if (begin + window < total) {
+            pending = std::async(std::launch::async, tokenize, begin + window);
+        }
+        std::vector<int> order(ids.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&ids](int a, int b) {
+            return ids[a].size() < ids[b].size();
+        });
+        // a bucket is closed when it is full or the padding would more than double its first input
+        int first = 0;
+        while (first < order.size()) {
+            int last = first + 1;
+            while (last < order.size() && last - first < batch_size &&
+                   ids[order[last]].size() <= 2 * ids[order[first]].size()) {
+                last++;
+            }
+            std::vector<std::vector<int>> bucket;
+            for (int i = first; i < last; i++) {
+                bucket.emplace_back(std::move(ids[order[i]]));
+            }
+            auto vars = ids_embeddings(bucket);
+            for (int i = 0; i < vars.size(); i++) {
+                results[begin + order[first + i]] = vars[i];
+            }
+            first = last;
+        }
+    }
+    return results;
+}
+
 VARP Embedding::gen_attention_mask(int seq_len) {
     auto attention_mask = _Input({1, 1, seq_len, seq_len}, NCHW, halide_type_of<float>());
     auto ptr = attention_mask->writeMap<float>();
@@ -8,6 +8,7 @@
 #ifndef KVMETA_hpp
 #define KVMETA_hpp
 
+#include <memory>
 #include <vector>
 
 namespace MNN {
@@ -20,6 +21,13 @@ struct KVMeta {
         PendingWrite,
         PendingRead
     } file_operation;
+    enum {
+        MaskInput,
+        MaskCausal,
+        MaskSliding,
+        MaskPrefixLM,
+        MaskSegments
+    };
     size_t block = 4096;
     size_t previous = 0;
     size_t remove = 0;
@@ -32,6 +40,26 @@ struct KVMeta {
     int layer_index = 0;
     int layer_nums = 0;
     std::vector<int> reserveHost;
+    // in-memory prefix cache, the kv is exchanged in blocks of prefix_block tokens, 0 means off
+    int prefix_block = 0;
+    // number of blocks to load before the new tokens are added
+    int prefix_read = 0;
+    // blocks [prefix_write_begin, prefix_write_end) are saved once they are filled
+    int prefix_write_begin = 0;
+    int prefix_write_end = 0;
+    // [prefix_write_end, layer_nums], indexed by block * layer_nums + layer_index
+    std::vector<std::shared_ptr<void>>* prefix_blocks = nullptr;
+    // implicit attention mask, used instead of the mask input when that has a single element
+    // MaskInput: always use the mask input; MaskCausal; MaskSliding: sliding window with sink; MaskPrefixLM; MaskSegments
+    int mask_mode = MaskInput;
+    // mode 2: a token sees the last sliding_window tokens and the first sink_tokens tokens
+    int sliding_window = 0;
+    int sink_tokens = 0;
+    // mode 3: the first prefix_len tokens attend to each other bidirectionally
+    int prefix_len = 0;
+    // mode 4: the tokens added by a forward belong to independent sequences, segments[i] is the sequence of
+    // the i-th added token. A token sees the kv before the forward and the earlier tokens of its sequence
+    std::vector<int> segments;
     void sync();
 };
 
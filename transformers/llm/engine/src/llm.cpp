@@ -6,6 +6,7 @@
 //
 // #define MNN_OPEN_TIME_TRACE 1
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -22,6 +23,7 @@
 #include "tokenizer.hpp"
 #include "diskembedding.hpp"
 #include "sampler.hpp"
+#include "prefixcache.hpp"
 #include "omni.hpp"
 #include "speculative_decoding/generate.hpp"
 #include "core/MNNFileUtils.h"
@@ -44,6 +46,12 @@ void KVMeta::sync() {
     reserve = nullptr;
     remove = 0;
     add = 0;
+    if (prefix_block > 0) {
+        // the loaded prefix blocks are not counted by add
+        previous += prefix_read * prefix_block;
+        prefix_read = 0;
+        layer_index = 0;
+    }
 }
 
 static MNNForwardType backend_type_convert(const std::string& type_str) {
@@ -126,7 +134,7 @@ bool Llm::set_config(const std::string& content) {
 void Llm::setRuntimeHint(std::shared_ptr<Express::Executor::RuntimeManager> &rtg) {
     rtg->setHint(MNN::Interpreter::INIT_THREAD_NUMBER, 4);
 
-    rtg->setHint(MNN::Interpreter::MEM_ALLOCATOR_TYPE, 0);
+    rtg->setHint(MNN::Interpreter::MEM_ALLOCATOR_TYPE, mConfig->use_huge_page() ? 2 : 0);
 
     /* 'quant_qkv' is deprecated, use 'attention_mode '*/
     int legacyAttentionMode = mConfig->config_.value("quant_qkv", 8); // compatibility
@@ -144,6 +152,9 @@ void Llm::setRuntimeHint(std::shared_ptr<Express::Executor::RuntimeManager> &rtg
     if (mConfig->kvcache_mmap()) {
         rtg->setExternalPath(tmpPath, MNN::Interpreter::EXTERNAL_PATH_KVCACHE_DIR);
     }
+    if (mConfig->kvcache_paged()) {
+        rtg->setHint(MNN::Interpreter::KVCACHE_PAGED, 1);
+    }
     auto cachePath = mConfig->prefix_cache_path();
     rtg->setExternalPath(cachePath, MNN::Interpreter::EXTERNAL_PATH_PREFIXCACHE_DIR);
     if (mConfig->use_mmap()) {
@@ -264,6 +275,32 @@ bool Llm::load() {
     mDiskEmbedding.reset(new DiskEmbedding(mConfig));
     mPrompt.reset(Prompt::createPrompt(mContext, mConfig));
     mSampler.reset(Sampler::createSampler(mContext, mConfig));
+    if (mConfig->prefix_cache_blocks() > 0 && !mConfig->is_visual() && !mConfig->is_audio()) {
+        // the same block size as the flash attention of cpu backend, so that the kv is exchanged by whole blocks
+        mPrefixCache.reset(new PrefixCache(64, mConfig->prefix_cache_blocks()));
+    }
+    if (mConfig->attention_mask_implicit() && mConfig->attention_fused() && mConfig->backend_type() == "cpu" && mConfig->attention_mask() == "float") {
+        // cpu attention computes causal and sliding window masks from the token positions
+        auto attention_type = mConfig->attention_type();
+        if (attention_type == "full") {
+            mMeta->mask_mode = KVMeta::MaskCausal;
+            mImplicitMask = _Input({1, 1, 1, 1}, NCHW, halide_type_of<float>());
+            mImplicitMask->writeMap<float>()[0] = 0.0f;
+        } else if (attention_type == "sliding" || attention_type == "mix") {
+            mMeta->mask_mode = KVMeta::MaskSliding;
+            mMeta->sliding_window = mConfig->sliding_window();
+            mMeta->sink_tokens = mConfig->attention_sink_tokens();
+            // for mix, layers pick mask[0] (full) or mask[1] (sliding)
+            if (attention_type == "mix") {
+                mImplicitMask = _Input({2, 1, 1, 1, 1}, NCHW, halide_type_of<float>());
+                mImplicitMask->writeMap<float>()[0] = 0.0f;
+                mImplicitMask->writeMap<float>()[1] = 1.0f;
+            } else {
+                mImplicitMask = _Input({1, 1, 1, 1}, NCHW, halide_type_of<float>());
+                mImplicitMask->writeMap<float>()[0] = 1.0f;
+            }
+        }
+    }
     // 3. load model
     Module::Config module_config;
     if (mConfig->backend_type() == "opencl" || mConfig->backend_type() == "vulkan" || mConfig->backend_type() == "npu") {
@@ -372,6 +409,23 @@ Llm* Llm::create_lora(const std::string& lora_path) {
     return llm;
 }
 
+Llm* Llm::create_instance(const std::string& config) {
+    auto llm = new Llm(std::make_shared<LlmConfig>(*mConfig));
+    if (!config.empty()) {
+        llm->set_config(config);
+    }
+    llm->mBaseModule = mModule.get();
+    auto res = llm->load();
+    if (!res) {
+        MNN_ERROR("[MNN:LLM] Create instance error\n");
+        delete llm;
+        return nullptr;
+    }
+    // share the cached prefixes with the other conversations
+    llm->mPrefixCache = mPrefixCache;
+    return llm;
+}
+
 void Llm::tuning(TuneType type, std::vector<int> candidates) {
     if (type != OP_ENCODER_NUMBER) {
         MNN_ERROR("tuning type not supported\n");
@@ -439,7 +493,10 @@ void Llm::setKVCacheInfo(size_t add, size_t remove, int* reserve, int n_reserve)
 }
 
 std::vector<Express::VARP> Llm::forwardRaw(Express::VARP hiddenState, Express::VARP mask, Express::VARP inputPos, Express::VARPS extraArgs) {
-    Express::VARP logitsIndex;
+    return forwardModule(hiddenState, mask, inputPos, nullptr, extraArgs);
+}
+
+std::vector<Express::VARP> Llm::forwardModule(Express::VARP hiddenState, Express::VARP mask, Express::VARP inputPos, Express::VARP logitsIndex, Express::VARPS extraArgs) {
     bool inDecode = mContext->gen_seq_len > 0;
     bool isAllLogists = mConfig->all_logits() ? true : (inDecode ? mInSpec : false);
     auto seqLen = hiddenState->getInfo()->dim[mSeqLenIndex];
@@ -456,14 +513,16 @@ std::vector<Express::VARP> Llm::forwardRaw(Express::VARP hiddenState, Express::V
         selectModule = mModulePool[moduleKey];
     }
 
-    if (isAllLogists) {
-        logitsIndex = logitsAllIdx;
-    } else {
-        logitsIndex = logitsLastIdx;
-    }
-    if (mMeta->add != seqLen) {
-        // Has Pad, need all logits
-        logitsIndex = logitsAllIdx;
+    if (nullptr == logitsIndex) {
+        if (isAllLogists) {
+            logitsIndex = logitsAllIdx;
+        } else {
+            logitsIndex = logitsLastIdx;
+        }
+        if (mMeta->add != seqLen) {
+            // Has Pad, need all logits
+            logitsIndex = logitsAllIdx;
+        }
     }
 
     mGenerateParam->input_embeds = nullptr;
@@ -650,6 +709,71 @@ std::vector<VARP> Llm::forwardVec(MNN::Express::VARP input_embeds) {
     return logits;
 }
 
+VARP Llm::forwardSequences(const std::vector<std::vector<int>>& sequences) {
+    int number = static_cast<int>(sequences.size());
+    if (0 == number) {
+        return nullptr;
+    }
+    // Pack the sequences without their last tokens first, then all the last tokens, so that the logits
+    // are only computed for the last number positions. Positions and masks keep every sequence apart.
+    std::vector<int> ids, segments, positions;
+    int past = mContext->all_seq_len;
+    for (int s = 0; s < number; ++s) {
+        if (sequences[s].empty()) {
+            MNN_ERROR("forwardSequences: sequence %d is empty\n", s);
+            return nullptr;
+        }
+        for (int i = 0; i + 1 < sequences[s].size(); ++i) {
+            ids.push_back(sequences[s][i]);
+            segments.push_back(s);
+            positions.push_back(past + i);
+        }
+    }
+    for (int s = 0; s < number; ++s) {
+        ids.push_back(sequences[s].back());
+        segments.push_back(s);
+        positions.push_back(past + (int)sequences[s].size() - 1);
+    }
+    int seqLen = static_cast<int>(ids.size());
+    if (mConfig->attention_mask() != "float" || mConfig->attention_type() != "full") {
+        MNN_ERROR("forwardSequences: only support float mask with full attention\n");
+        return nullptr;
+    }
+    VARP mask;
+    int maskMode = mMeta->mask_mode;
+    if (nullptr != mImplicitMask) {
+        mMeta->mask_mode = KVMeta::MaskSegments;
+        mMeta->segments = segments;
+        mask = mImplicitMask;
+    } else {
+        int kvSeqLen = past + seqLen;
+        mask = _Input({1, 1, seqLen, kvSeqLen}, NCHW, halide_type_of<float>());
+        auto ptr = mask->writeMap<float>();
+        for (int i = 0; i < seqLen; i++) {
+            for (int j = 0; j < kvSeqLen; j++) {
+                bool visible = j < past || (j - past <= i && segments[j - past] == segments[i]);
+                ptr[kvSeqLen * i + j] = visible ? 0.0f : std::numeric_limits<float>::lowest();
+            }
+        }
+    }
+    auto positionIds = _Input({seqLen}, NCHW, halide_type_of<int>());
+    ::memcpy(positionIds->writeMap<int>(), positions.data(), seqLen * sizeof(int));
+    // All the lengths run on the prefill module
+    int genSeqLen = mContext->gen_seq_len;
+    mContext->gen_seq_len = 0;
+    mMeta->add = seqLen;
+    auto outputs = forwardModule(embedding(ids), mask, positionIds, _var<int>({-number}, {1}));
+    mContext->gen_seq_len = genSeqLen;
+    mMeta->mask_mode = maskMode;
+    mMeta->segments.clear();
+    // The sequences are dropped from the kvcache by the next forward
+    mMeta->remove = seqLen;
+    if (outputs.empty()) {
+        return nullptr;
+    }
+    return outputs[0];
+}
+
 void Llm::updateContext(int seq_len, int gen_len) {
     mContext->all_seq_len += seq_len;
     mContext->gen_seq_len += gen_len;
@@ -686,6 +810,7 @@ void Llm::generate_init(std::ostream* os, const char* end_with) {
     if (!mContext->generate_str.empty()) {
         mContext->generate_str.clear();
     }
+    mTokenCallbackSize = 0;
     mContext->gen_seq_len = 0;
     mContext->prefill_us  = 0;
     mContext->decode_us   = 0;
@@ -731,6 +856,59 @@ void Llm::eraseHistory(size_t begin, size_t end) {
     }
 }
 
+void Llm::setTokenCallback(std::function<bool(int, const char*, size_t, bool)> callback) {
+    mTokenCallback = callback;
+}
+
+// End of the longest prefix of str that doesn't cut an utf-8 character, searching back from the end
+static size_t _utf8CompleteEnd(const std::string& str, size_t begin) {
+    size_t end = str.size();
+    // an unfinished character has at most 3 bytes
+    size_t lowest = end - std::min<size_t>(end - begin, 3);
+    for (size_t i = end; i > lowest;) {
+        --i;
+        auto c = static_cast<unsigned char>(str[i]);
+        if ((c & 0xC0) == 0x80) {
+            continue;
+        }
+        size_t length = c >= 0xF0 ? 4 : (c >= 0xE0 ? 3 : (c >= 0xC0 ? 2 : 1));
+        return end - i >= length ? end : i;
+    }
+    return end;
+}
+
+void Llm::outputToken(int token) {
+    if (mContext->status == LlmStatus::USER_CANCEL) {
+        return;
+    }
+    auto& str = mContext->generate_str;
+    auto offset = str.size();
+    str += tokenizer_decode(token);
+    if (nullptr != mContext->os) {
+        mContext->os->write(str.data() + offset, str.size() - offset);
+        *mContext->os << std::flush;
+    }
+    if (mTokenCallback) {
+        auto end = _utf8CompleteEnd(str, mTokenCallbackSize);
+        bool keep = mTokenCallback(token, str.data() + mTokenCallbackSize, end - mTokenCallbackSize, false);
+        mTokenCallbackSize = end;
+        if (!keep) {
+            mContext->status = LlmStatus::USER_CANCEL;
+        }
+    }
+}
+
+void Llm::outputStop(int token) {
+    if (nullptr != mContext->os) {
+        *mContext->os << mContext->end_with << std::flush;
+    }
+    if (mTokenCallback) {
+        auto& str = mContext->generate_str;
+        mTokenCallback(token, str.data() + mTokenCallbackSize, str.size() - mTokenCallbackSize, true);
+        mTokenCallbackSize = str.size();
+    }
+}
+
 bool Llm::stoped() {
     return is_stop(mContext->current_token);
 }
@@ -778,11 +956,18 @@ std::vector<int> Llm::generate(const std::vector<int>& input_ids, int max_tokens
 
     mContext->history_tokens.insert(mContext->history_tokens.end(), input_ids.begin(), input_ids.end()); // push to history_ids_
     if(!passExecute) {
-        if (0 == mBlockSize || input_ids.size() <= mBlockSize) {
-            auto hidden_states = embedding(input_ids);
+        // skip the prefill of the longest prefix found in the prefix cache
+        std::vector<int> suffix_ids;
+        int cachedLength = beginPrefixCache(input_ids);
+        if (cachedLength > 0) {
+            suffix_ids.assign(input_ids.begin() + cachedLength, input_ids.end());
+        }
+        const auto& prefill_ids = cachedLength > 0 ? suffix_ids : input_ids;
+        if (0 == mBlockSize || prefill_ids.size() <= mBlockSize) {
+            auto hidden_states = embedding(prefill_ids);
             return generate(hidden_states, max_tokens);
         }
-        int total_size = (int)input_ids.size();
+        int total_size = (int)prefill_ids.size();
         int loop_size = UP_DIV(total_size, mBlockSize);
         for (int i = 0; i < loop_size; i++) {
             auto start = i * mBlockSize;
@@ -790,7 +975,7 @@ std::vector<int> Llm::generate(const std::vector<int>& input_ids, int max_tokens
             if (end >= total_size) {
                 end = total_size;
             }
-            std::vector<int> chunk_ids(input_ids.begin() + start, input_ids.begin() + end);
+            std::vector<int> chunk_ids(prefill_ids.begin() + start, prefill_ids.begin() + end);
             auto input_embeds = embedding(chunk_ids);
             generate(input_embeds, 0);
         }
@@ -804,6 +989,38 @@ std::vector<int> Llm::generate(const std::vector<int>& input_ids, int max_tokens
     return mContext->output_tokens;
 }
 
+int Llm::prefill_init(const std::vector<int>& input_ids) {
+    mContext->history_tokens.insert(mContext->history_tokens.end(), input_ids.begin(), input_ids.end());
+    int cachedLength = beginPrefixCache(input_ids);
+    mPrefillIds.assign(input_ids.begin() + cachedLength, input_ids.end());
+    mPrefillOffset = 0;
+    mPrefillLength = (int)input_ids.size();
+    mContext->prompt_len = mPrefillLength;
+    return (int)mPrefillIds.size();
+}
+
+int Llm::prefill_step(int max_tokens) {
+    int remain = (int)mPrefillIds.size() - mPrefillOffset;
+    if (remain <= 0) {
+        return 0;
+    }
+    int size = max_tokens > 0 ? std::min(max_tokens, remain) : remain;
+    std::vector<int> chunk_ids(mPrefillIds.begin() + mPrefillOffset, mPrefillIds.begin() + mPrefillOffset + size);
+    // the last chunk publishes the prompt to the prefix cache and leaves the logits for generate(1)
+    generate(embedding(chunk_ids), 0);
+    mPrefillOffset += size;
+    remain -= size;
+    if (mContext->status == LlmStatus::INTERNAL_ERROR) {
+        remain = 0;
+    }
+    if (0 == remain) {
+        mPrefillIds.clear();
+        mPrefillOffset = 0;
+    }
+    mContext->prompt_len = mPrefillLength;
+    return remain;
+}
+
 std::string Llm::apply_chat_template(const std::string& user_content) const {
     return mPrompt->applyTemplate(user_content, true);
 }
@@ -847,6 +1064,11 @@ std::vector<int> Llm::generate(MNN::Express::VARP input_embeds, int max_tokens)
     mContext->prefill_us += _t.durationInUs();
     MNN::Express::ExecutorScope::Current()->gc(); // after prefill
 
+    // the whole prompt is in the kvcache, publish its blocks to the prefix cache
+    if (mMeta->prefix_block > 0 && mContext->all_seq_len >= (int)mContext->history_tokens.size()) {
+        endPrefixCache();
+    }
+
     // prefix cache mode and response second time
     if(mPrefixCacheMode && mCallIndex == 2) {
         if(mIsPrefixFileExist) {
@@ -977,6 +1199,66 @@ bool Llm::setPrefixCacheFile(const std::string& filename, int flag) {
     return mIsPrefixFileExist;
 }
 
+int Llm::beginPrefixCache(const std::vector<int>& input_ids) {
+    mMeta->prefix_block = 0;
+    mMeta->prefix_read = 0;
+    mMeta->prefix_blocks = nullptr;
+    // only a conversation starting from an empty kvcache can reuse the cached prefix
+    if (nullptr == mPrefixCache || mPrefixCacheMode || mMeta->previous != mMeta->remove || mMeta->n_reserve > 0 || mContext->all_seq_len > 0) {
+        return 0;
+    }
+    int blockSize = mPrefixCache->blockSize();
+    int layers = mMeta->layer_nums;
+    // keep at least one token to prefill for the logits
+    auto blocks = mPrefixCache->match(input_ids, (int)input_ids.size() - 1);
+    int readNumber = (int)blocks.size();
+    int writeNumber = (int)input_ids.size() / blockSize;
+    mPrefixBlocks.assign(std::max(readNumber, writeNumber) * layers, nullptr);
+    for (int i = 0; i < readNumber; ++i) {
+        if (blocks[i]->size() != layers) {
+            readNumber = i;
+            break;
+        }
+        std::copy(blocks[i]->begin(), blocks[i]->end(), mPrefixBlocks.begin() + i * layers);
+    }
+    mMeta->prefix_block = blockSize;
+    mMeta->prefix_read = readNumber;
+    mMeta->prefix_write_begin = readNumber;
+    mMeta->prefix_write_end = writeNumber;
+    mMeta->prefix_blocks = &mPrefixBlocks;
+    mMeta->layer_index = 0;
+    mContext->all_seq_len += readNumber * blockSize;
+    return readNumber * blockSize;
+}
+
+void Llm::endPrefixCache() {
+    int layers = mMeta->layer_nums;
+    std::vector<std::shared_ptr<PrefixCache::Block>> blocks(mMeta->prefix_write_end);
+    for (int i = mMeta->prefix_write_begin; i < mMeta->prefix_write_end; ++i) {
+        std::shared_ptr<PrefixCache::Block> block(new PrefixCache::Block(mPrefixBlocks.begin() + i * layers, mPrefixBlocks.begin() + (i + 1) * layers));
+        // The backend doesn't export the kv of every layer, such as quantized kv or non-cpu backends
+        if (std::find(block->begin(), block->end(), nullptr) != block->end()) {
+            blocks.resize(i);
+            break;
+        }
+        blocks[i] = block;
+    }
+    mPrefixCache->insert(mContext->history_tokens, blocks);
+    mMeta->prefix_block = 0;
+    mMeta->prefix_write_begin = 0;
+    mMeta->prefix_write_end = 0;
+    mMeta->prefix_blocks = nullptr;
+    mMeta->layer_index = 0;
+    mPrefixBlocks.clear();
+}
+
+PrefixCacheInfo Llm::getPrefixCacheInfo() const {
+    if (nullptr == mPrefixCache) {
+        return PrefixCacheInfo();
+    }
+    return mPrefixCache->info();
+}
+
 bool Llm::reuse_kv() { return mConfig->reuse_kv(); }
 
 static inline bool needNewVar(VARP var, int axis, int seq_len, int kv_seq_len = 0) {
@@ -1015,6 +1297,9 @@ std::string Llm::tokenizer_decode(int id) {
 
 VARP Llm::gen_attention_mask(int seq_len) {
     int kv_seq_len = mContext->all_seq_len + seq_len;
+    if (nullptr != mImplicitMask) {
+        return mImplicitMask;
+    }
     if (mConfig->attention_mask() == "float") {
         // full and sliding mix, using normal mask
         if (mConfig->attention_type() == "mix") {
@@ -1056,7 +1341,7 @@ VARP Llm::gen_attention_mask(int seq_len) {
             if(seq_len == 1) {
                 return mAttentionMaskVarVec[0];
             }
-            if (mAttentionMaskVarVec.size() > 1 && seq_len == mDraftLength) {
+            if (mAttentionMaskVarVec.size() > 1 && seq_len == mDraftLength + 1) {
                 return mAttentionMaskVarVec[1];
             }
         }
@@ -1125,7 +1410,7 @@ VARP Llm::gen_position_ids(int seq_len) {
             ptr[0] = is_glm2 ? mContext->gen_seq_len : mContext->all_seq_len;
             return mPositionIdsVarVec[0];
         }
-        if(mPositionIdsVarVec.size() > 1 && seq_len == mDraftLength) {
+        if(mPositionIdsVarVec.size() > 1 && seq_len == mDraftLength + 1) {
             auto ptr = mPositionIdsVarVec[1]->writeMap<int>();
             for (int i = 0; i < seq_len; i++) {
                 ptr[i] = i + mContext->all_seq_len;
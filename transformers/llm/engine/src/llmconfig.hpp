@@ -450,6 +450,15 @@ public:
     bool kvcache_mmap() const {
         return config_.value("kvcache_mmap", false);
     }
+    bool kvcache_paged() const {
+        return config_.value("kvcache_paged", false);
+    }
+    bool use_huge_page() const {
+        return config_.value("use_huge_page", false);
+    }
+    int prefix_cache_blocks() const {
+        return config_.value("prefix_cache_blocks", 0);
+    }
     std::string tmp_path() const {
         return config_.value("tmp_path", "");
     }
@@ -482,6 +491,11 @@ public:
         return config_.value("attention_type", "full");
     }
 
+    // embedding models exported with a batch dimension and a padding mask
+    bool embedding_batch() const {
+        return config_.value("embedding_batch", false);
+    }
+
     int sliding_window() const {
         return config_.value("sliding_window", 0);
     }
@@ -490,6 +504,14 @@ public:
         return config_.value("attention_fused", true);
     }
 
+    bool attention_mask_implicit() const {
+        return config_.value("attention_mask_implicit", true);
+    }
+
+    int attention_sink_tokens() const {
+        return config_.value("attention_sink_tokens", 0);
+    }
+
     std::string bos() const {
         return config_.value("bos", "");
     }
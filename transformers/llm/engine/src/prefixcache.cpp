@@ -0,0 +1,96 @@
+//
+//  prefixcache.cpp
+//
+//  Created by MNN on 2026/10/15.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#include "prefixcache.hpp"
+
+namespace MNN {
+namespace Transformer {
+
+PrefixCache::PrefixCache(int blockSize, int capacity) : mBlockSize(blockSize), mCapacity(capacity) {
+    // nothing todo
+}
+
+void PrefixCache::touch(Node* node) {
+    for (; node != &mRoot; node = node->parent) {
+        mLRU.splice(mLRU.begin(), mLRU, node->lru);
+    }
+}
+
+void PrefixCache::evict() {
+    while (mLRU.size() > mCapacity) {
+        auto node = mLRU.back();
+        if (!node->children.empty()) {
+            // Should not happen, the back of the lru list is always a leaf
+            break;
+        }
+        mLRU.pop_back();
+        mInfo.evicted++;
+        auto key = node->tokens;
+        node->parent->children.erase(key);
+    }
+    mInfo.blocks = mLRU.size();
+}
+
+std::vector<std::shared_ptr<PrefixCache::Block>> PrefixCache::match(const std::vector<int>& tokens, int maxLength) {
+    std::lock_guard<std::mutex> _l(mLock);
+    std::vector<std::shared_ptr<Block>> result;
+    auto node = &mRoot;
+    std::vector<int> key(mBlockSize);
+    for (int pos = 0; pos + mBlockSize <= maxLength && pos + mBlockSize <= tokens.size(); pos += mBlockSize) {
+        key.assign(tokens.begin() + pos, tokens.begin() + pos + mBlockSize);
+        auto iter = node->children.find(key);
+        if (iter == node->children.end()) {
+            break;
+        }
+        node = iter->second.get();
+        result.emplace_back(node->block);
+    }
+    if (result.empty()) {
+        mInfo.miss++;
+    } else {
+        mInfo.hit++;
+        mInfo.hit_tokens += result.size() * mBlockSize;
+        touch(node);
+    }
+    return result;
+}
+
+void PrefixCache::insert(const std::vector<int>& tokens, const std::vector<std::shared_ptr<Block>>& blocks) {
+    std::lock_guard<std::mutex> _l(mLock);
+    auto node = &mRoot;
+    for (int i = 0; i < blocks.size() && (i + 1) * mBlockSize <= tokens.size(); ++i) {
+        std::vector<int> key(tokens.begin() + i * mBlockSize, tokens.begin() + (i + 1) * mBlockSize);
+        auto iter = node->children.find(key);
+        if (iter != node->children.end()) {
+            node = iter->second.get();
+            continue;
+        }
+        if (nullptr == blocks[i]) {
+            // The parent block has been evicted by another conversation
+            break;
+        }
+        std::unique_ptr<Node> child(new Node);
+        child->parent = node;
+        child->tokens = key;
+        child->block = blocks[i];
+        mLRU.emplace_front(child.get());
+        child->lru = mLRU.begin();
+        auto next = child.get();
+        node->children.emplace(std::move(key), std::move(child));
+        node = next;
+    }
+    touch(node);
+    evict();
+}
+
+PrefixCacheInfo PrefixCache::info() {
+    std::lock_guard<std::mutex> _l(mLock);
+    return mInfo;
+}
+
+} // namespace Transformer
+} // namespace MNN
@@ -0,0 +1,66 @@
+//
+//  prefixcache.hpp
+//
+//  Created by MNN on 2026/10/15.
+//  Copyright © 2018, Alibaba Group Holding Limited
+//
+
+#ifndef PREFIXCACHE_hpp
+#define PREFIXCACHE_hpp
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "llm/llm.hpp"
+
+namespace MNN {
+namespace Transformer {
+
+/**
+ In-memory prefix cache shared by the conversations of one model.
+ Prompts are split into blocks of blockSize tokens, every tree node owns the kv of one block
+ for all layers, so prompts sharing a system prompt / few-shot preamble share its blocks.
+ Leaves are evicted in LRU order once the cache holds more than capacity blocks.
+ */
+class PrefixCache {
+public:
+    // the kv of one block, indexed by layer, the content is owned by the backend
+    typedef std::vector<std::shared_ptr<void>> Block;
+    PrefixCache(int blockSize, int capacity);
+    int blockSize() const {
+        return mBlockSize;
+    }
+    // Return the blocks of the longest cached prefix of tokens[0, maxLength)
+    std::vector<std::shared_ptr<Block>> match(const std::vector<int>& tokens, int maxLength);
+    // blocks[i] holds tokens[i * blockSize, (i + 1) * blockSize), nullptr means the block should be cached already
+    void insert(const std::vector<int>& tokens, const std::vector<std::shared_ptr<Block>>& blocks);
+    PrefixCacheInfo info();
+
+private:
+    struct Node {
+        Node* parent = nullptr;
+        std::vector<int> tokens;
+        std::shared_ptr<Block> block;
+        std::map<std::vector<int>, std::unique_ptr<Node>> children;
+        std::list<Node*>::iterator lru;
+    };
+    // Move the path to the front of the lru list, parents stay in front of their children
+    void touch(Node* node);
+    void evict();
+
+    int mBlockSize;
+    int mCapacity;
+    std::mutex mLock;
+    Node mRoot;
+    // front is the most recently used, so the back is always a leaf
+    std::list<Node*> mLRU;
+    PrefixCacheInfo mInfo;
+};
+
+} // namespace Transformer
+} // namespace MNN
+
+#endif // PREFIXCACHE_hpp
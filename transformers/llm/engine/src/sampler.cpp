@@ -1,5 +1,4 @@
 #include <random>
-#include <queue>
 #include <algorithm>
 #include <cmath>
 #include <unordered_map>
@@ -40,10 +39,6 @@ struct SubsetLogits{
 // sampler compute struct end
 
 // sampler compute functions start
-Express::VARP _TempratureSoftmax(Express::VARP logits, float temperature, int axis = -1) {
-    return Express::_Softmax(logits * Express::_Scalar<float>(1.0f / temperature), axis);
-}
-
 SubsetLogits createSubsetLogits(Express::VARP logits) {
     struct SubsetLogits subset;
     subset.logits = logits;
@@ -113,8 +108,8 @@ int argmaxSelect(struct SubsetLogits superset) {
 }
 
 int randomSelect(float* probs, size_t size) {
-    std::random_device rd;
-    std::mt19937 generator(rd());
+    // seeding mt19937 is far more expensive than drawing from it, so keep one per thread
+    static thread_local std::mt19937 generator(std::random_device{}());
     std::uniform_real_distribution<float> distribution(0.0, 1.0);
     float target = distribution(generator);
     float cumulative = 0.0;
@@ -131,15 +126,43 @@ int randomSelect(Express::VARP probs) {
     return randomSelect((float*)(probs->readMap<float>()), probs->getInfo()->size);
 }
 
+// softmax(logits / temperature) computed in place of an Express graph: one pass for max,
+// one for exp and sum, one for scale. Building and running a Softmax op per token costs
+// more than the math itself for a vocab of ~150k.
+void temperatureSoftmax(const float* logits, int size, float temperature, float* probs) {
+    if (size <= 0) {
+        return;
+    }
+    float maxValue = logits[0];
+    for (int i = 1; i < size; ++i) {
+        maxValue = std::max(maxValue, logits[i]);
+    }
+    float scale = 1.0f / temperature;
+    float sum = 0.0f;
+    for (int i = 0; i < size; ++i) {
+        probs[i] = std::exp((logits[i] - maxValue) * scale);
+        sum += probs[i];
+    }
+    float sumRec = 1.0f / sum;
+    for (int i = 0; i < size; ++i) {
+        probs[i] *= sumRec;
+    }
+}
+
 int reSoftmaxSelect(struct SubsetLogits subset, float temperature) {
-    int token_index_id = randomSelect(_TempratureSoftmax(subset.logits, temperature));
+    auto scores = subset.logits->readMap<float>();
+    int size = subset.logits->getInfo()->size;
+    std::vector<float> probs(size);
+    temperatureSoftmax(scores, size, temperature, probs.data());
+    int token_index_id = randomSelect(probs.data(), size);
     return ((subset.is_subset) ? subset.index[token_index_id] : token_index_id);
 }
 
 int packSoftmax(Express::VARP logits, std::vector<IndexScore>& index_scores, float temperature) {
-    auto prob_varp = _TempratureSoftmax(logits, temperature);
-    auto probs = (float*)(prob_varp->readMap<float>());
-    auto size = prob_varp->getInfo()->size;
+    auto scores = logits->readMap<float>();
+    int size = logits->getInfo()->size;
+    std::vector<float> probs(size);
+    temperatureSoftmax(scores, size, temperature, probs.data());
     index_scores.resize(size);
     for (int i = 0; i < size; i++) {
         IndexScore m;
@@ -149,6 +172,26 @@ int packSoftmax(Express::VARP logits, std::vector<IndexScore>& index_scores, flo
     }
     return size;
 }
+
+// Visit index_scores in the order given by cmp until visit returns false. Only the visited
+// prefix gets sorted: each round partial-sorts the next chunk out of the unsorted tail, and
+// the chunk grows geometrically, so an early stop costs O(n log k) instead of O(n log n).
+template <typename Compare, typename Visitor>
+void partialSortVisit(std::vector<IndexScore>& index_scores, Compare cmp, Visitor visit) {
+    size_t begin = 0;
+    size_t chunk = 64;
+    while (begin < index_scores.size()) {
+        size_t end = std::min(index_scores.size(), begin + chunk);
+        std::partial_sort(index_scores.begin() + begin, index_scores.begin() + end, index_scores.end(), cmp);
+        for (size_t i = begin; i < end; ++i) {
+            if (!visit(index_scores[i])) {
+                return;
+            }
+        }
+        begin = end;
+        chunk *= 4;
+    }
+}
 // sampler compute functions end
 
 Sampler* Sampler::createSampler(std::shared_ptr<LlmContext> context, std::shared_ptr<LlmConfig> config) {
@@ -258,32 +301,36 @@ void Sampler::SamplerConfig::configMixed(std::shared_ptr<LlmConfig> llmConfig) {
 }
 
 struct SubsetLogits Sampler::topK(struct SubsetLogits superset) {
-    int K = mConfig.topK;
     auto scores = (float*)(superset.logits->readMap<float>());
-    auto size = superset.logits->getInfo()->size;
-    // 1. time complexity: O(nlogk)
-    std::priority_queue<IndexScore, std::vector<IndexScore>, IndexScoreCmpGreater> heap;
-    for (int i = 0; i < size; i++) {
-        IndexScore m;
-        m.index = i;
-        m.score = scores[i];
-        if (heap.size() < K) {
-            heap.push(m);
-        }
-        else {
-            if (heap.top().score < m.score) {
-                heap.pop();
-                heap.push(m);
-            }
+    int size = superset.logits->getInfo()->size;
+    int K = std::min(mConfig.topK, size);
+    if (K <= 0) {
+        return superset;
+    }
+    // 1. time complexity: O(nlogk), a min heap of the best K, most candidates are
+    // rejected by a single compare against its top
+    std::vector<IndexScore> heap(K);
+    for (int i = 0; i < K; i++) {
+        heap[i].index = i;
+        heap[i].score = scores[i];
+    }
+    std::make_heap(heap.begin(), heap.end(), IndexScoreCmpGreater());
+    for (int i = K; i < size; i++) {
+        if (scores[i] <= heap.front().score) {
+            continue;
         }
+        std::pop_heap(heap.begin(), heap.end(), IndexScoreCmpGreater());
+        heap.back().index = i;
+        heap.back().score = scores[i];
+        std::push_heap(heap.begin(), heap.end(), IndexScoreCmpGreater());
     }
     // 2. store top K results
+    std::sort_heap(heap.begin(), heap.end(), IndexScoreCmpGreater());
     auto subset = createSubsetLogits(K);
     float* topKscores = (float*)(subset.logits->writeMap<float>());
     for (int i = 0; i < K; i++) {
-        subset.index[K-i-1] = heap.top().index;
-        topKscores[K-i-1]  = heap.top().score;
-        heap.pop();
+        subset.index[i] = heap[i].index;
+        topKscores[i] = heap[i].score;
     }
     transformIndex(superset, subset);
     return subset;
@@ -292,22 +339,21 @@ struct SubsetLogits Sampler::topK(struct SubsetLogits superset) {
 struct SubsetLogits Sampler::topP(struct SubsetLogits superset) {
     float p = mConfig.topP, temperature = mConfig.temperature;
     std::vector<IndexScore> index_scores;
-    int size = packSoftmax(superset.logits, index_scores, temperature);
-    // 1. make max heap
-    std::make_heap(index_scores.begin(), index_scores.end(), IndexScoreCmpLess());
-    // 2. top p algorithm
+    packSoftmax(superset.logits, index_scores, temperature);
+    // 1. top p algorithm, only the head of the distribution is sorted
     auto scores = (float*)(superset.logits->readMap<float>());
     std::vector<int> index;
     std::vector<float> subset_logits;
     float cumulative = 0.0f;
-    while (cumulative < p && !index_scores.empty()) {
-        std::pop_heap(index_scores.begin(), index_scores.end(), IndexScoreCmpLess());
-        IndexScore m = index_scores.back();
-        index_scores.pop_back();
+    partialSortVisit(index_scores, IndexScoreCmpGreater(), [&](const IndexScore& m) {
+        if (cumulative >= p) {
+            return false;
+        }
         index.push_back(m.index);
         subset_logits.push_back(scores[m.index]);
         cumulative += m.score;
-    }
+        return true;
+    });
     auto subset = createSubsetLogits(subset_logits, index);
     transformIndex(superset, subset);
     return subset;
@@ -317,17 +363,27 @@ struct SubsetLogits Sampler::minP(struct SubsetLogits superset) {
     float p = mConfig.minP, temperature = mConfig.temperature;
     std::vector<IndexScore> index_scores;
     int size = packSoftmax(superset.logits, index_scores, temperature);
-    // 1. make max heap
-    std::make_heap(index_scores.begin(), index_scores.end(), IndexScoreCmpLess());
-    // 2. min p algorithm
+    // 1. min p algorithm, keep every token above p and at least the most probable one
+    int keep = 0;
+    int best = 0;
+    for (int i = 0; i < size; ++i) {
+        if (index_scores[i].score > index_scores[best].score) {
+            best = i;
+        }
+        if (index_scores[i].score >= p) {
+            index_scores[keep++] = index_scores[i];
+        }
+    }
+    if (keep == 0 && size > 0) {
+        index_scores[keep++] = index_scores[best];
+    }
+    index_scores.resize(keep);
+    // 2. only the kept tokens are sorted
+    std::sort(index_scores.begin(), index_scores.end(), IndexScoreCmpGreater());
     auto scores = (float*)(superset.logits->readMap<float>());
     std::vector<int> index;
     std::vector<float> subset_logits;
-    for (int i = 0; i < size; ++i) {
-        std::pop_heap(index_scores.begin(), index_scores.end(), IndexScoreCmpLess());
-        IndexScore m = index_scores.back();
-        if (m.score < p && !index.empty()) break;
-        index_scores.pop_back();
+    for (auto& m : index_scores) {
         index.push_back(m.index);
         subset_logits.push_back(scores[m.index]);
     }
@@ -338,11 +394,15 @@ struct SubsetLogits Sampler::minP(struct SubsetLogits superset) {
 
 struct SubsetLogits Sampler::tfs(struct SubsetLogits superset) {
     float z = mConfig.tfsZ, temperature = mConfig.temperature;
+    // z >= 1 disables tfs, skip the softmax and the full sort
+    if (z >= 1.0f || superset.logits->getInfo()->size < 3) {
+        return superset;
+    }
     // tfs algorithm
     // 1. softmax
     std::vector<IndexScore> index_scores;
     int size = packSoftmax(superset.logits, index_scores, temperature);
-    // 2. sort
+    // 2. sort, the normalization needs the derivatives of the whole sorted distribution
     std::sort(index_scores.begin(), index_scores.end(), IndexScoreCmpGreater());
     auto scores = (float*)(superset.logits->readMap<float>());
     // 3. calculate derivatives
@@ -377,9 +437,13 @@ struct SubsetLogits Sampler::tfs(struct SubsetLogits superset) {
 
 struct SubsetLogits Sampler::typical(struct SubsetLogits superset) {
     float p = mConfig.typical, temperature = mConfig.temperature;
-    auto prob_varp = _TempratureSoftmax(superset.logits, temperature);
-    auto probs = (float*)(prob_varp->readMap<float>());
-    auto size = prob_varp->getInfo()->size;
+    // p >= 1 keeps the whole distribution
+    if (p >= 1.0f) {
+        return superset;
+    }
+    int size = superset.logits->getInfo()->size;
+    std::vector<float> probs(size);
+    temperatureSoftmax(superset.logits->readMap<float>(), size, temperature, probs.data());
     std::vector<IndexScore> index_scores;
     index_scores.resize(size);
     // 1. calcaluate dist
@@ -391,22 +455,20 @@ struct SubsetLogits Sampler::typical(struct SubsetLogits superset) {
         m.score = std::fabs(entropy + std::log(probs[i]));
         index_scores[i] = m;
     }
-    // 2. make min heap for dist
-    std::make_heap(index_scores.begin(), index_scores.end(), IndexScoreCmpGreater());
-    // 3. typical p algorithm
+    // 2. typical p algorithm, visit tokens by ascending dist, only the visited ones are sorted
     auto scores = (float*)(superset.logits->readMap<float>());
     float cumulative = 0.0f;
     std::vector<int> index;
     std::vector<float> subset_logits;
-    for (int i = 0; i < size; ++i) {
-        std::pop_heap(index_scores.begin(), index_scores.end(), IndexScoreCmpGreater());
-        IndexScore m = index_scores.back();
+    partialSortVisit(index_scores, IndexScoreCmpLess(), [&](const IndexScore& m) {
         cumulative += probs[m.index];
-        if (cumulative >= p && !index.empty()) break;
-        index_scores.pop_back();
+        if (cumulative >= p && !index.empty()) {
+            return false;
+        }
         index.push_back(m.index);
         subset_logits.push_back(scores[m.index]);
-    }
+        return true;
+    });
     auto subset = createSubsetLogits(subset_logits, index);
     transformIndex(superset, subset);
     return subset;
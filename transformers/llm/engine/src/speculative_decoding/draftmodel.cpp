@@ -0,0 +1,211 @@
+//
+//  draftmodel.cpp
+//
+//  Created by MNN on 2026/10/16.
+//
+//
+
+#include <algorithm>
+#include "generate.hpp"
+
+using namespace MNN::Express;
+namespace MNN {
+namespace Transformer {
+
+DraftModelGeneration::DraftModelGeneration(Llm* llm, std::shared_ptr<LlmContext> context, std::shared_ptr<LlmConfig> config) : Generation(llm, context) {
+    mMaxDraftLength = llm->mDraftLength;
+    mDraftLength = mMaxDraftLength;
+}
+
+void DraftModelGeneration::load(Module::Config module_config) {
+    // verify modules for every draft length the adaption may choose
+    mLlm->mRuntimeManager->setHintPtr(Interpreter::KVCACHE_INFO, mLlm->mMeta.get());
+    for (int i = 2; i <= mMaxDraftLength + 1; i++) {
+        auto key = std::make_pair(i, true);
+        if (mLlm->mModulePool.find(key) == mLlm->mModulePool.end()) {
+            mLlm->mModulePool[key].reset(Module::clone(mLlm->mModule.get()));
+        }
+    }
+    // the draft model must share the vocabulary of the target model
+    auto draft_path = mLlm->mConfig->draft_model();
+    mDraft.reset(Llm::createLLM(draft_path), Llm::destroy);
+    if (!mDraft->load()) {
+        MNN_ERROR("[Error]: Load draft model %s failed, decode without drafts.\n", draft_path.c_str());
+        mDraft.reset();
+    }
+}
+
+VARP DraftModelGeneration::draftForward(const std::vector<int>& input_ids) {
+    // several tokens are caught up through the prefill module
+    mDraft->mContext->gen_seq_len = input_ids.size() > 1 ? 0 : 1;
+    auto outputs = mDraft->forwardVec(input_ids);
+    if (outputs.empty() || nullptr == outputs[0]->readMap<float>()) {
+        // the draft cache is unknown now, start over next time
+        mDraft->reset();
+        mDraftTokens.clear();
+        return nullptr;
+    }
+    mDraft->updateContext((int)input_ids.size(), 0);
+    mDraftTokens.insert(mDraftTokens.end(), input_ids.begin(), input_ids.end());
+    return outputs[0];
+}
+
+void DraftModelGeneration::draftRollback(int number) {
+    // removed from the kv cache by the next forward
+    mDraft->mMeta->remove += number;
+    mDraft->updateContext(-number, 0);
+    mDraftTokens.resize(mDraftTokens.size() - number);
+}
+
+void DraftModelGeneration::propose(std::vector<int>& drafts, int length) {
+    if (nullptr == mDraft || length <= 0) {
+        return;
+    }
+    // the draft cache must hold the accepted tokens: history followed by the current token
+    const auto& history = mContext->history_tokens;
+    size_t total = history.size() + 1;
+    auto tokenAt = [&](size_t i) {
+        return i < history.size() ? history[i] : mContext->current_token;
+    };
+    size_t common = 0;
+    while (common < mDraftTokens.size() && common < total && mDraftTokens[common] == tokenAt(common)) {
+        common++;
+    }
+    // keep at least one token to compute the next logits
+    if (common == total) {
+        common--;
+    }
+    if (common < mDraftTokens.size()) {
+        draftRollback((int)(mDraftTokens.size() - common));
+    }
+    std::vector<int> pending;
+    for (size_t i = common; i < total; i++) {
+        pending.push_back(tokenAt(i));
+    }
+    auto logits = draftForward(pending);
+    for (int i = 0; i < length && nullptr != logits; i++) {
+        auto token = mDraft->sample(logits, mDraft->mGenerateParam->validLogitStart, mDraft->mGenerateParam->validLogitSize);
+        drafts.push_back(token);
+        // the target decides whether to stop, nothing to draft beyond it
+        if (mDraft->is_stop(token) || i == length - 1) {
+            break;
+        }
+        logits = draftForward({token});
+    }
+}
+
+void DraftModelGeneration::generate(GenerationParams& param) {
+    if (-1 == mContext->current_token) {
+        mContext->current_token = mLlm->sample(param.outputs[0], param.validLogitStart, param.validLogitSize);
+    }
+    int max_token = param.max_new_tokens;
+    int len = 0;
+    bool stop = false;
+#ifdef DUMP_PROFILE_INFO
+    // speculative total draft token numbers
+    int spl_decode = 0;
+    // speculative accept draft token numbers
+    int spl_accept = 0;
+    // speculative number of times
+    int spl_count = 0;
+#endif
+
+    while (len < max_token) {
+        if(mContext->status == LlmStatus::USER_CANCEL) {
+            break;
+        }
+        MNN::Timer _t;
+        std::vector<int> drafts;
+        drafts.push_back(mContext->current_token);
+
+        mLlm->outputToken(mContext->current_token);
+        // mContext->current_token add to gen_seq_len
+        mLlm->updateContext(0, 1);
+
+        {
+            // draft model proposes tokens autoregressively
+            propose(drafts, mDraftLength);
+            mLlm->mMeta->add = drafts.size();
+
+            AUTOTIME;
+            // do draft token parallel verify
+            auto outputs = mLlm->forwardVec(drafts);
+            for (auto o : outputs) {
+                if(nullptr == o->readMap<float>()) {
+                    mContext->status = LlmStatus::INTERNAL_ERROR;
+                    break;
+                }
+            }
+            if(outputs.empty()) {
+                break;
+            }
+            auto logits = outputs[0];
+            if (nullptr == logits.get()) {
+                break;
+            }
+            if (logits->getInfo()->size == 0) {
+                break;
+            }
+
+            // verify draft token whether be accepted
+            int i_dft = draftVerify(logits, drafts, stop);
+
+            // adapt the draft length to the running acceptance rate
+            int proposed = (int)drafts.size() - 1;
+            if (proposed > 0) {
+                float rate = (float)(i_dft - 1) / (float)proposed;
+                mAcceptRate = 0.8f * mAcceptRate + 0.2f * rate;
+                mDraftLength = std::max(1, std::min(mMaxDraftLength, (int)(mAcceptRate * mMaxDraftLength + 0.5f)));
+            }
+
+            // clear dirty kv-cache, the draft cache is rolled back by the next propose
+            mLlm->mMeta->remove = drafts.size() - i_dft;
+            len += i_dft;
+
+            // update context state
+            int seq_len = i_dft;
+            int gen_len = i_dft - 1; // current_token has been added, add others
+            mLlm->updateContext(seq_len, gen_len);
+
+            // count time cost
+            mContext->decode_us += _t.durationInUs();
+
+            // add all accept tokens to string
+            mContext->history_tokens.insert(mContext->history_tokens.end(), drafts.begin(), drafts.begin() + i_dft);
+            mContext->output_tokens.insert(mContext->output_tokens.end(), drafts.begin(), drafts.begin() + i_dft);
+
+        #ifdef DUMP_PROFILE_INFO
+            MNN_PRINT("\ndraft num:%d, adopt num:%d, next draft length:%d\n", proposed, i_dft - 1, mDraftLength);
+            spl_decode += proposed;
+            spl_accept += i_dft - 1;
+            spl_count++;
+        #endif
+            if(stop) {
+                mContext->history_tokens.push_back(mContext->current_token);
+                mContext->output_tokens.push_back(mContext->current_token);
+                mLlm->updateContext(0, 1);
+                break;
+            }
+            if (mLlm->is_stop(mContext->current_token)) {
+                mContext->history_tokens.push_back(mContext->current_token);
+                mContext->output_tokens.push_back(mContext->current_token);
+                mLlm->updateContext(0, 1);
+                mLlm->outputStop(mContext->current_token);
+                break;
+            }
+        }
+    }
+    if(len >= max_token) {
+        mContext->status = LlmStatus::MAX_TOKENS_FINISHED;
+    }
+#ifdef DUMP_PROFILE_INFO
+    MNN_PRINT("\n============== Draft Model Decoding Statistics Start ===============\n");
+    MNN_PRINT("Average draft accept rate: %.2f%%\n", 100.0 * spl_accept / std::max(spl_decode, 1));
+    MNN_PRINT("Average accepted tokens per target forward: %.2f\n", 1.0 * (spl_accept + spl_count) / std::max(spl_count, 1));
+    MNN_PRINT("============== Draft Model Decoding Statistics End =================\n");
+#endif
+    return;
+}
+
+} // namespace Transformer
+} // namespace MNN
@@ -25,6 +25,8 @@ std::shared_ptr<Generation> GenerationStrategyFactory::create(Llm* llm, std::sha
             res.reset(new MtpGeneration(llm, context, config));
         } else if(config->speculative_type() == "eagle") {
             res.reset(new EagleGeneration(llm, context, config));
+        } else if(config->speculative_type() == "draftmodel") {
+            res.reset(new DraftModelGeneration(llm, context, config));
         } else {
             // autoregressive generation
             res.reset(new ArGeneration(llm, context, config));
@@ -53,19 +55,12 @@ void ArGeneration::generate(GenerationParams& param) {
         mContext->output_tokens.push_back(mContext->current_token);
         mLlm->updateContext(0, 1);
         if (mLlm->is_stop(mContext->current_token)) {
-            if (nullptr != mContext->os) {
-                *mContext->os << mContext->end_with << std::flush;
-            }
+            mLlm->outputStop(mContext->current_token);
             break;
         }
         // Decode and Output
         MNN::Timer _t;
-        auto decodeStr = mLlm->tokenizer_decode(mContext->current_token);
-        mContext->generate_str += decodeStr;
-        if (nullptr != mContext->os) {
-            *mContext->os << decodeStr;
-            *mContext->os << std::flush;
-        }
+        mLlm->outputToken(mContext->current_token);
         // Compute Next Logits
         auto outputs = mLlm->forwardVec({mContext->current_token});
         for (auto o : outputs) {
@@ -101,9 +96,7 @@ int Generation::draftVerify(VARP logits, const std::vector<int> &drafts, bool& s
             // stop token just break the process
             if (mLlm->is_stop(predict)) {
                 mContext->current_token = predict;
-                if (nullptr != mContext->os) {
-                    *mContext->os << mContext->end_with << std::flush;
-                }
+                mLlm->outputStop(mContext->current_token);
                 stop = true;
                 break;
             }
@@ -113,10 +106,7 @@ int Generation::draftVerify(VARP logits, const std::vector<int> &drafts, bool& s
                 break;
             }
 
-            if (nullptr != mContext->os) {
-                *mContext->os << mLlm->tokenizer_decode(predict);
-                *mContext->os << std::flush;
-            }
+            mLlm->outputToken(predict);
         }
         // all drafts are corrcet!
         if(i_dft == drafts.size()) {
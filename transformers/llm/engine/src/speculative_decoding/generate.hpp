@@ -113,6 +113,24 @@ private:
     int mEaglePastLen = 0, mEagleRemove = 0;
 };
 
+class DraftModelGeneration: public Generation {
+public:
+    DraftModelGeneration(Llm* llm, std::shared_ptr<LlmContext> context, std::shared_ptr<LlmConfig> config);
+    virtual ~DraftModelGeneration() = default;
+    virtual void load(Module::Config module_config) override;
+    virtual void generate(GenerationParams& param) override;
+private:
+    MNN::Express::VARP draftForward(const std::vector<int>& input_ids);
+    void draftRollback(int number);
+    void propose(std::vector<int>& drafts, int length);
+    std::shared_ptr<Llm> mDraft;
+    // tokens in the kv cache of the draft model
+    std::vector<int> mDraftTokens;
+    // running ratio of accepted drafts, drives mDraftLength in [1, mMaxDraftLength]
+    float mAcceptRate = 1.0f;
+    int mDraftLength;
+    int mMaxDraftLength;
+};
 
 class GenerationStrategyFactory {
 public:
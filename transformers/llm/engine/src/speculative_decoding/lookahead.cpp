@@ -96,12 +96,9 @@ void LookaheadGeneration::generate(GenerationParams& param) {
         std::vector<int> drafts;
         drafts.push_back(mContext->current_token);
         
-        auto decodeStr = mLlm->tokenizer_decode(mContext->current_token);
-        mContext->generate_str += decodeStr;
-        if (nullptr != mContext->os) {
-            *mContext->os << decodeStr;
-            *mContext->os << std::flush;
-        }
+        auto offset = mContext->generate_str.size();
+        mLlm->outputToken(mContext->current_token);
+        auto decodeStr = mContext->generate_str.substr(offset);
         // mContext->current_token add to gen_seq_len
         mLlm->updateContext(0, 1);
 
@@ -194,9 +191,7 @@ void LookaheadGeneration::generate(GenerationParams& param) {
                 mContext->history_tokens.push_back(mContext->current_token);
                 mContext->output_tokens.push_back(mContext->current_token);
                 mLlm->updateContext(0, 1);
-                if (nullptr != mContext->os) {
-                    *mContext->os << mContext->end_with << std::flush;
-                }
+                mLlm->outputStop(mContext->current_token);
                 break;
             }
         }
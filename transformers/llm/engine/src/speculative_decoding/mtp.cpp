@@ -158,12 +158,7 @@ void MtpGeneration::generate(GenerationParams& param) {
         std::vector<int> drafts;
         drafts.push_back(mContext->current_token);
         
-        auto decodeStr = mLlm->tokenizer_decode(mContext->current_token);
-        mContext->generate_str += decodeStr;
-        if (nullptr != mContext->os) {
-            *mContext->os << decodeStr;
-            *mContext->os << std::flush;
-        }
+        mLlm->outputToken(mContext->current_token);
         // mContext->current_token add to gen_seq_len
         mLlm->updateContext(0, 1);
 
@@ -240,9 +235,7 @@ void MtpGeneration::generate(GenerationParams& param) {
                 mContext->history_tokens.push_back(mContext->current_token);
                 mContext->output_tokens.push_back(mContext->current_token);
                 mLlm->updateContext(0, 1);
-                if (nullptr != mContext->os) {
-                    *mContext->os << mContext->end_with << std::flush;
-                }
+                mLlm->outputStop(mContext->current_token);
                 break;
             }
         }
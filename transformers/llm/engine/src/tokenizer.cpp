@@ -15,8 +15,8 @@
 #include <functional>
 #include <random>
 #include <codecvt>
-#include <regex>
-#include <set>
+#include <thread>
+#include <algorithm>
 #include <climits>
 #include <cctype>
 #include <cstring>
@@ -740,17 +740,6 @@ std::string wstring_to_utf8(const std::wstring& str) {
     return res;
 }
 
-// Given a token as a UTF8 string, encode each byte into an wchar_t
-void byte_encode_token(const std::string& token,
-                       const std::unordered_map<uint8_t, wchar_t>& b2u,
-                       std::wstring* result) {
-    result->resize(0);
-    for (char c : token) {
-        wchar_t wc = b2u.at(uint8_t(c));
-        result->push_back(wc);
-    }
-}
-
 bool HuggingfaceTokenizer::load_vocab(std::ifstream& tok_file) {
     std::string line;
     line.reserve(256); // Reduce allocation during getline
@@ -774,19 +763,27 @@ bool HuggingfaceTokenizer::load_vocab(std::ifstream& tok_file) {
         encoder_.emplace(decoder_[i], i);
     }
 
-    // 3. Load merge_rules
-    bpe_ranks_.reserve(merge_len);
+    // 3. Load merge_rules as (left id, right id) -> (rank, merged id)
+    merges_.reserve(merge_len);
+    std::string merged;
     for (int i = 0; i < merge_len; i++) {
         std::getline(tok_file, line);
 
         size_t d = line.find(' ');
-        if (d != std::string::npos) {
-            // Use pointer-based conversion to avoid creating temporary substr strings
-            bpe_ranks_.emplace(std::make_pair(
-                utf8_to_wstring(line.data(), d),
-                utf8_to_wstring(line.data() + d + 1, line.size() - d - 1)
-            ), i);
+        if (d == std::string::npos) {
+            continue;
         }
+        merged.assign(line.data(), d);
+        auto left = encoder_.find(merged);
+        merged.append(line.data() + d + 1, line.size() - d - 1);
+        auto right = encoder_.find(merged.substr(d));
+        auto result = encoder_.find(merged);
+        if (left == encoder_.end() || right == encoder_.end() || result == encoder_.end()) {
+            // A merge out of the vocab can't produce a valid token
+            continue;
+        }
+        uint64_t key = (static_cast<uint64_t>(left->second) << 32) | static_cast<uint32_t>(right->second);
+        merges_.emplace(key, std::make_pair(i, result->second));
     }
 
     // 4. bytes_to_unicode initialization
@@ -811,119 +808,227 @@ bool HuggingfaceTokenizer::load_vocab(std::ifstream& tok_file) {
         }
     }
 
-    // Batch insert into member maps
-    b2u_.clear();
     u2b_.clear();
-    // Hint: Assuming typical map implementations, insertion order matters slightly,
-    // but just bulk inserting is clean enough.
     for (int i = 0; i < 256; ++i) {
         uint8_t u8 = static_cast<uint8_t>(i);
         wchar_t wc = temp_map[i];
-        b2u_.emplace(u8, wc);
         u2b_.emplace(wc, u8);
+        auto iter = encoder_.find(wstring_to_utf8(std::wstring(1, wc)));
+        byte_ids_[i] = iter == encoder_.end() ? -1 : iter->second;
     }
 
     return true;
 }
 
-void get_pairs(const std::wstring& word, std::vector<std::pair<std::wstring, std::wstring>>* pairs) {
-    pairs->clear();
+static inline bool is_alpha_(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+static inline bool is_digit_(char c) {
+    return c >= '0' && c <= '9';
+}
+static inline bool is_space_(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+static inline bool is_newline_(char c) {
+    return c == '\r' || c == '\n';
+}
+static inline char to_lower_(char c) {
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
 
-    if (word.size() < 2) return;
+// Returns the end of the word starting at pos, matches the regex below with std::regex semantics
+// (first matching alternative wins, classes are ascii only, other bytes count as punctuation):
+// ('s|'t|'re|'ve|'m|'ll|'d)|[^\r\n[:alpha:][:digit:]]?[[:alpha:]]+|[[:digit:]]| ?[^\s[:alpha:][:digit:]]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+
+static size_t match_word(const char* s, size_t size, size_t pos) {
+    // 's|'t|'re|'ve|'m|'ll|'d, case insensitive
+    if (s[pos] == '\'' && pos + 1 < size) {
+        char c1 = to_lower_(s[pos + 1]);
+        if (c1 == 's' || c1 == 't' || c1 == 'm' || c1 == 'd') {
+            return pos + 2;
+        }
+        if (pos + 2 < size) {
+            char c2 = to_lower_(s[pos + 2]);
+            if ((c1 == 'r' && c2 == 'e') || (c1 == 'v' && c2 == 'e') || (c1 == 'l' && c2 == 'l')) {
+                return pos + 3;
+            }
+        }
+    }
+    // [^\r\n[:alpha:][:digit:]]?[[:alpha:]]+
+    size_t end = pos;
+    if (!is_newline_(s[end]) && !is_alpha_(s[end]) && !is_digit_(s[end])) {
+        end++;
+    }
+    if (end < size && is_alpha_(s[end])) {
+        while (end < size && is_alpha_(s[end])) {
+            end++;
+        }
+        return end;
+    }
+    // [[:digit:]]
+    if (is_digit_(s[pos])) {
+        return pos + 1;
+    }
+    // ' ?[^\s[:alpha:][:digit:]]+[\r\n]*', only the no-space branch is left if s[pos] is not a space
+    auto is_punct = [](char c) {
+        return !is_space_(c) && !is_alpha_(c) && !is_digit_(c);
+    };
+    end = s[pos] == ' ' ? pos + 1 : pos;
+    if (end < size && is_punct(s[end])) {
+        while (end < size && is_punct(s[end])) {
+            end++;
+        }
+        while (end < size && is_newline_(s[end])) {
+            end++;
+        }
+        return end;
+    }
+    // Only whitespace is left here
+    end = pos;
+    size_t newline = size;
+    while (end < size && is_space_(s[end])) {
+        if (is_newline_(s[end])) {
+            newline = end;
+        }
+        end++;
+    }
+    // \s*[\r\n]+ ends after the last newline of the run
+    if (newline != size) {
+        return newline + 1;
+    }
+    // \s+(?!\S) leaves the last space to the next word, \s+ otherwise
+    if (end < size && end - pos >= 2) {
+        return end - 1;
+    }
+    return end;
+}
 
-    wchar_t previous = word[0];
-    for (int i = 1; i < word.size(); i++) {
-        pairs->push_back({std::wstring(1, previous), std::wstring(1, word[i])});
-        previous = word[i];
+void HuggingfaceTokenizer::pretokenize(const std::string& str, std::vector<string_view_>& words) {
+    size_t pos = 0;
+    while (pos < str.size()) {
+        auto end = match_word(str.data(), str.size(), pos);
+        words.emplace_back(str.data() + pos, end - pos);
+        pos = end;
     }
 }
 
-void HuggingfaceTokenizer::bpe(const std::wstring& token, const BPERanks& bpe_ranks, std::vector<std::wstring>* result) {
-    std::set<int> merged;  // records indices in pairs that were merged.
-    auto _left = [](int i, std::set<int>& merged) {
-        for (int j = i - 1; j >= -1; j--) {
-            if (merged.find(j) == merged.end()) return j;
+void HuggingfaceTokenizer::bpe(string_view_ word, std::vector<int>& ids) const {
+    // Symbols are a linked list over the bytes of word, the candidate merges a min heap of
+    // (rank, left position), stale candidates are dropped when popped
+    struct Symbol {
+        int id;
+        int prev;
+        int next;
+    };
+    struct Candidate {
+        int rank;
+        int left;
+        int right;
+        int leftId;
+        int rightId;
+        int merged;
+        bool operator<(const Candidate& other) const {
+            // priority_queue pops the largest, the lowest rank then the leftmost pair wins
+            return rank != other.rank ? rank > other.rank : left > other.left;
         }
-        return -1;
     };
-    auto _right = [](int i, int cap, std::set<int>& merged) {
-        for (int j = i + 1; j < cap; j++) {
-            if (merged.find(j) == merged.end()) return j;
+    int size = static_cast<int>(word.size());
+    std::vector<Symbol> symbols(size);
+    for (int i = 0; i < size; ++i) {
+        symbols[i].id = byte_ids_[static_cast<uint8_t>(word[i])];
+        symbols[i].prev = i - 1;
+        symbols[i].next = i + 1 < size ? i + 1 : -1;
+    }
+    std::priority_queue<Candidate> candidates;
+    auto push = [&](int left, int right) {
+        if (left < 0 || right < 0) {
+            return;
+        }
+        uint64_t key = (static_cast<uint64_t>(symbols[left].id) << 32) | static_cast<uint32_t>(symbols[right].id);
+        auto iter = merges_.find(key);
+        if (iter != merges_.end()) {
+            candidates.push({iter->second.first, left, right, symbols[left].id, symbols[right].id, iter->second.second});
         }
-        return cap;
     };
-
-    std::vector<std::pair<std::wstring, std::wstring>> pairs;
-    get_pairs(token, &pairs);
-
-    while (true) {
-        int min_score = INT_MAX;
-        int to_merge = -1;  // indices into pairs.
-
-        for (int i = 0; i < pairs.size(); ++i) {
-            if (merged.find(i) == merged.end()) {  // pair i is not merged.
-                auto iter = bpe_ranks.find(pairs[i]);
-                int score = iter != bpe_ranks.end() ? iter->second : INT_MAX;
-                if (score < min_score) {
-                    min_score = score;
-                    to_merge = i;
-                }
-            }
+    for (int i = 0; i + 1 < size; ++i) {
+        push(i, i + 1);
+    }
+    while (!candidates.empty()) {
+        auto top = candidates.top();
+        candidates.pop();
+        auto& left = symbols[top.left];
+        auto& right = symbols[top.right];
+        if (left.next != top.right || left.id != top.leftId || right.id != top.rightId) {
+            continue;
         }
+        left.id = top.merged;
+        left.next = right.next;
+        if (right.next >= 0) {
+            symbols[right.next].prev = top.left;
+        }
+        right.id = -1;
+        push(left.prev, top.left);
+        push(top.left, left.next);
+    }
+    for (int i = 0; i >= 0 && i < size; i = symbols[i].next) {
+        if (symbols[i].id >= 0) {
+            ids.push_back(symbols[i].id);
+        }
+    }
+}
 
-        if (to_merge == -1) break;
-
-        merged.insert(to_merge);
-        std::wstring merge_into = pairs[to_merge].first + pairs[to_merge].second;
-
-        int l = _left(to_merge, merged);
-        if (l >= 0) pairs[l].second = merge_into;
-        int r = _right(to_merge, pairs.size(), merged);
-        if (r < pairs.size()) pairs[r].first = merge_into;
-    }  // end while (true)
-
-    if (merged.size() == pairs.size()) {
-        result->push_back(token);
-
-    } else {
-        for (int i = 0; i < pairs.size(); ++i) {
-            if (merged.find(i) == merged.end()) {
-                if (_left(i, merged) < 0) result->push_back(pairs[i].first);
-                result->push_back(pairs[i].second);
+void HuggingfaceTokenizer::encode_words(const string_view_* words, size_t size, std::vector<int>& ids, WordCache& cache) const {
+    std::string key;
+    for (size_t i = 0; i < size; ++i) {
+        key.assign(words[i].data(), words[i].size());
+        auto iter = word_cache_.find(key);
+        if (iter == word_cache_.end()) {
+            iter = cache.find(key);
+            if (iter == cache.end()) {
+                std::vector<int> wordIds;
+                bpe(words[i], wordIds);
+                iter = cache.emplace(key, std::move(wordIds)).first;
             }
         }
+        ids.insert(ids.end(), iter->second.begin(), iter->second.end());
     }
 }
 
 void HuggingfaceTokenizer::encode(const std::string& str, std::vector<int>& ids) {
-    /* original regex from tokenizer.json
-        "(?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\\r\\n\\p{L}\\p{N}]?\\p{L}+|\\p{N}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+"
-     //    std::regex re("('s|'t|'re|'ve|'m|'ll|'d| ?[[:alpha:]]+| ?[[:digit:]]+| ?[^\\s\\w]+|\\s+)");
-     */
-    static const std::regex re("('s|'t|'re|'ve|'m|'ll|'d)|[^\\r\\n[:alpha:][:digit:]]?[[:alpha:]]+|[[:digit:]]| ?[^\\s[:alpha:][:digit:]]+[\r\n]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+", std::regex_constants::icase);
-
-    std::string input = str;
-    std::vector<std::string> result;
-    std::smatch match;
-
-    std::string token;
-    while (std::regex_search(input, match, re)) {
-        token = match.str(0);
-        input = match.suffix().str();
-        std::wstring wtoken;
-        for (char c : token) {
-            wtoken.push_back(b2u_.at(uint8_t(c)));
+    // Words per thread before a long input is encoded in parallel chunks
+    static const size_t kWordsPerThread = 4096;
+    // Limit of cached words, the cache is dropped once it grows beyond it
+    static const size_t kMaxCachedWords = 1 << 16;
+    std::vector<string_view_> words;
+    pretokenize(str, words);
+    // Workers only read word_cache_, their new words are merged back after they finish
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    size_t threadNumber = std::min<size_t>(words.size() / kWordsPerThread, std::thread::hardware_concurrency());
+    std::vector<WordCache> caches(std::max<size_t>(threadNumber, 1));
+    if (threadNumber <= 1) {
+        encode_words(words.data(), words.size(), ids, caches[0]);
+    } else {
+        std::vector<std::vector<int>> chunks(threadNumber);
+        std::vector<std::thread> threads;
+        size_t step = (words.size() + threadNumber - 1) / threadNumber;
+        for (size_t t = 0; t < threadNumber; ++t) {
+            size_t begin = std::min(t * step, words.size());
+            size_t end = std::min(begin + step, words.size());
+            threads.emplace_back([&, t, begin, end]() {
+                encode_words(words.data() + begin, end - begin, chunks[t], caches[t]);
+            });
         }
-
-        std::vector<std::wstring> bpe_tokens;
-        bpe(wtoken, bpe_ranks_, &bpe_tokens);
-
-        for (auto ws : bpe_tokens) {
-            result.push_back(wstring_to_utf8(ws));
+        for (size_t t = 0; t < threadNumber; ++t) {
+            threads[t].join();
+            ids.insert(ids.end(), chunks[t].begin(), chunks[t].end());
         }
     }
-    for (auto s : result) {
-        ids.push_back(encoder_.at(s));
+    for (auto& cache : caches) {
+        if (word_cache_.size() + cache.size() > kMaxCachedWords) {
+            word_cache_.clear();
+        }
+        if (cache.size() <= kMaxCachedWords) {
+            word_cache_.insert(cache.begin(), cache.end());
+        }
     }
 }
 
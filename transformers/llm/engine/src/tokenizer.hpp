@@ -13,6 +13,7 @@
 #include <string>
 #include <unordered_map>
 #include <iostream>
+#include <mutex>
 // #include <string_view>
 #include <cstring>
 class string_view_ {
@@ -231,15 +232,6 @@ private:
 };
 
 class HuggingfaceTokenizer : public Tokenizer {
-struct hash_pair_wstring {
-    size_t operator()(const std::pair<std::wstring, std::wstring>& p) const {
-        auto hash1 = std::hash<std::wstring>{}(p.first);
-        auto hash2 = std::hash<std::wstring>{}(p.second);
-        // If hash1 == hash2, their XOR is zero.
-        return (hash1 != hash2) ? hash1 ^ hash2 : hash1;
-    }
-};
-using BPERanks = std::unordered_map<std::pair<std::wstring, std::wstring>, int, hash_pair_wstring>;
 public:
     HuggingfaceTokenizer() = default;
     virtual std::string decode(int id) override;
@@ -247,12 +239,21 @@ protected:
     virtual bool load_vocab(std::ifstream& file) override;
     virtual void encode(const std::string& str, std::vector<int>& ids) override;
 private:
-    void bpe(const std::wstring& token, const BPERanks& bpe_ranks, std::vector<std::wstring>* result);
-    BPERanks bpe_ranks_;
-    std::unordered_map<uint8_t, wchar_t> b2u_;
+    using WordCache = std::unordered_map<std::string, std::vector<int>>;
+    // split str into words as the gpt2 style pre-tokenizer regex does
+    static void pretokenize(const std::string& str, std::vector<string_view_>& words);
+    void bpe(string_view_ word, std::vector<int>& ids) const;
+    void encode_words(const string_view_* words, size_t size, std::vector<int>& ids, WordCache& cache) const;
+    // (left id << 32 | right id) -> (rank, merged id)
+    std::unordered_map<uint64_t, std::pair<int, int>> merges_;
+    // vocab id of every single byte
+    int byte_ids_[256];
     std::unordered_map<wchar_t, uint8_t> u2b_;
     std::unordered_map<std::string, int> encoder_;
     std::vector<std::string> decoder_;
+    // encoded ids of recent words, guarded by cache_mutex_
+    WordCache word_cache_;
+    std::mutex cache_mutex_;
 };
 };
 };
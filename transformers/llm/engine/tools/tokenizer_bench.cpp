@@ -0,0 +1,195 @@
+//
+//  tokenizer_bench.cpp
+//
+//  Created by MNN on 2026/10/16.
+//  Copyright (c) 2026 Alibaba Group Holding Limited All rights reserved.
+//
+
+#include <fstream>
+#include <sstream>
+#include <regex>
+#include <set>
+#include <climits>
+#include <chrono>
+#include <MNN/MNNDefine.h>
+#include "tokenizer.hpp"
+using namespace MNN::Transformer;
+
+// The previous HuggingfaceTokenizer encode path: std::regex pre-tokenizer and a bpe rescanning
+// every pair on each merge, kept here as the baseline and the reference of the results
+class ReferenceBpe {
+public:
+    bool load(const std::string& filename) {
+        std::ifstream file(filename);
+        std::string line;
+        int magic = 0, type = 0;
+        std::getline(file, line);
+        std::istringstream(line) >> magic >> type;
+        if (magic != Tokenizer::MAGIC_NUMBER || type != Tokenizer::HUGGINGFACE) {
+            return false;
+        }
+        // special, stop and prefix tokens
+        std::getline(file, line);
+        std::getline(file, line);
+        int vocabLen = 0, mergeLen = 0;
+        std::getline(file, line);
+        std::istringstream(line) >> vocabLen >> mergeLen;
+        for (int i = 0; i < vocabLen; ++i) {
+            std::getline(file, line);
+            mEncoder.emplace(line, i);
+        }
+        for (int i = 0; i < mergeLen; ++i) {
+            std::getline(file, line);
+            auto d = line.find(' ');
+            if (d != std::string::npos) {
+                mRanks.emplace(line.substr(0, d) + " " + line.substr(d + 1), i);
+            }
+        }
+        // bytes_to_unicode
+        std::vector<int> map(256, 0);
+        for (int c = '!'; c <= '~'; ++c) map[c] = c;
+        for (int c = 0xA1; c <= 0xAC; ++c) map[c] = c;
+        for (int c = 0xAE; c <= 0xFF; ++c) map[c] = c;
+        int n = 0;
+        for (int b = 0; b < 256; ++b) {
+            if (map[b] == 0) {
+                map[b] = 256 + n++;
+            }
+            int cp = map[b];
+            std::string utf8;
+            if (cp < 0x80) {
+                utf8.push_back((char)cp);
+            } else {
+                utf8.push_back((char)(0xC0 | (cp >> 6)));
+                utf8.push_back((char)(0x80 | (cp & 0x3F)));
+            }
+            mByteUnit[b] = utf8;
+        }
+        return true;
+    }
+    std::vector<int> encode(const std::string& str) const {
+        static const std::regex re("('s|'t|'re|'ve|'m|'ll|'d)|[^\\r\\n[:alpha:][:digit:]]?[[:alpha:]]+|[[:digit:]]| ?[^\\s[:alpha:][:digit:]]+[\r\n]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+", std::regex_constants::icase);
+        std::vector<int> ids;
+        std::string input = str;
+        std::smatch match;
+        while (std::regex_search(input, match, re)) {
+            auto token = match.str(0);
+            input = match.suffix().str();
+            std::vector<std::string> units;
+            for (char c : token) {
+                units.push_back(mByteUnit[(uint8_t)c]);
+            }
+            for (auto& piece : bpe(units)) {
+                ids.push_back(mEncoder.at(piece));
+            }
+        }
+        return ids;
+    }
+private:
+    std::vector<std::string> bpe(const std::vector<std::string>& units) const {
+        if (units.size() < 2) {
+            return units;
+        }
+        std::vector<std::pair<std::string, std::string>> pairs;
+        for (int i = 1; i < units.size(); ++i) {
+            pairs.emplace_back(units[i - 1], units[i]);
+        }
+        std::set<int> merged;
+        auto left = [&](int i) {
+            for (int j = i - 1; j >= 0; --j) {
+                if (merged.find(j) == merged.end()) return j;
+            }
+            return -1;
+        };
+        auto right = [&](int i) {
+            for (int j = i + 1; j < pairs.size(); ++j) {
+                if (merged.find(j) == merged.end()) return j;
+            }
+            return (int)pairs.size();
+        };
+        while (true) {
+            int minRank = INT_MAX, toMerge = -1;
+            for (int i = 0; i < pairs.size(); ++i) {
+                if (merged.find(i) != merged.end()) {
+                    continue;
+                }
+                auto iter = mRanks.find(pairs[i].first + " " + pairs[i].second);
+                if (iter != mRanks.end() && iter->second < minRank) {
+                    minRank = iter->second;
+                    toMerge = i;
+                }
+            }
+            if (toMerge < 0) {
+                break;
+            }
+            merged.insert(toMerge);
+            auto mergeInto = pairs[toMerge].first + pairs[toMerge].second;
+            int l = left(toMerge);
+            if (l >= 0) pairs[l].second = mergeInto;
+            int r = right(toMerge);
+            if (r < pairs.size()) pairs[r].first = mergeInto;
+        }
+        std::vector<std::string> result;
+        if (merged.size() == pairs.size()) {
+            std::string all;
+            for (auto& u : units) all += u;
+            result.push_back(all);
+            return result;
+        }
+        for (int i = 0; i < pairs.size(); ++i) {
+            if (merged.find(i) == merged.end()) {
+                if (left(i) < 0) result.push_back(pairs[i].first);
+                result.push_back(pairs[i].second);
+            }
+        }
+        return result;
+    }
+    std::unordered_map<std::string, int> mEncoder;
+    std::unordered_map<std::string, int> mRanks;
+    std::string mByteUnit[256];
+};
+
+template <typename T>
+static double _measure(T&& func) {
+    auto begin = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, const char* argv[]) {
+    if (argc < 3) {
+        MNN_PRINT("Usage: ./tokenizer_bench tokenizer.txt text.txt [repeat]\n");
+        return 0;
+    }
+    std::unique_ptr<Tokenizer> tokenizer(Tokenizer::createTokenizer(argv[1]));
+    if (nullptr == tokenizer) {
+        return 1;
+    }
+    std::ifstream textFile(argv[2], std::ios::binary);
+    std::stringstream buffer;
+    buffer << textFile.rdbuf();
+    int repeat = argc > 3 ? std::stoi(argv[3]) : 1;
+    std::string text;
+    for (int i = 0; i < repeat; ++i) {
+        text += buffer.str();
+    }
+    std::vector<int> ids;
+    // The first run fills the word cache, the second one hits it
+    auto cold = _measure([&]() { ids = tokenizer->encode(text); });
+    auto warm = _measure([&]() { ids = tokenizer->encode(text); });
+    MNN_PRINT("text bytes: %lu, tokens: %lu\n", (unsigned long)text.size(), (unsigned long)ids.size());
+    MNN_PRINT("encode cold: %.0f tokens/s, warm: %.0f tokens/s\n", ids.size() / cold, ids.size() / warm);
+    ReferenceBpe reference;
+    if (!reference.load(argv[1])) {
+        MNN_PRINT("Reference only supports huggingface tokenizer\n");
+        return 0;
+    }
+    std::vector<int> expect;
+    auto base = _measure([&]() { expect = reference.encode(text); });
+    MNN_PRINT("regex reference: %.0f tokens/s, speedup cold %.1fx, warm %.1fx\n", expect.size() / base, base / cold, base / warm);
+    if (expect != ids) {
+        MNN_PRINT("Warning: ids differ from the reference (special or prefix tokens are not handled by it)\n");
+    }
+    return 0;
+}
@@ -595,6 +595,8 @@ class EmbeddingExporter(LlmExporter):
             },
             'is_visual': False
         }
+        if self.model_type in ['bert', 'new'] and not self.model.is_reranker:
+            self.llm_config['embedding_batch'] = True
         return model_path
 
     def export_reranker(self):
@@ -646,9 +648,9 @@ class EmbeddingExporter(LlmExporter):
             ],
             output_names=['sentence_embeddings'],
             dynamic_axes={
-                "input_ids" : { 1: "seq_len" },
+                "input_ids" : { 0: "batch", 1: "seq_len" },
                 "position_ids" : { 1: "seq_len" },
-                "attention_mask" : { 2: "seq_len", 3: "seq_len" }
+                "attention_mask" : { 0: "batch", 2: "seq_len", 3: "seq_len" }
             })
         return onnx_model
 
@@ -336,12 +336,14 @@ class EmbeddingModel(LlmModel):
         return self.embed(input_ids.view(1, -1))
 
     def bge_forward(self, inputs_embeds, attention_mask, position_ids):
-        inputs_embeds = inputs_embeds.reshape(1, -1, self.config.hidden_size)
+        # [batch, seq_len, hidden_size], attention_mask is 1 for visible and 0 for padded keys
+        inputs_embeds = inputs_embeds.reshape(-1, position_ids.shape[-1], self.config.hidden_size)
+        attention_bias = (1 - attention_mask) * torch.finfo(torch.float32).min
         position_embeddings = self.position_embeddings(position_ids)
         embeddings = inputs_embeds + position_embeddings + self.token_type_embeddings
         hidden_states = self.embedding_layernorm(embeddings)
         for i in range(self.config.num_hidden_layers):
-            hidden_states = self.blocks[i](hidden_states, attention_mask)[0]
+            hidden_states = self.blocks[i](hidden_states, attention_bias)[0]
         sentence_embeddings = hidden_states[:, 0]
         sentence_embeddings = torch.nn.functional.normalize(sentence_embeddings, p=2, dim=1)
         return sentence_embeddings
@@ -358,11 +360,11 @@ class EmbeddingModel(LlmModel):
         return logits
 
     def gte_embedding_forward(self, inputs_embeds, attention_mask, position_ids):
-        inputs_embeds = inputs_embeds.reshape(1, -1, self.config.hidden_size)
+        inputs_embeds = inputs_embeds.reshape(-1, position_ids.shape[-1], self.config.hidden_size)
         freqs = position_ids.float().reshape(-1, 1) * self.embed.rotary_emb.inv_freq
         emb = torch.cat((freqs, freqs), dim=-1)
         rope_embeds = torch.stack([emb.cos(), emb.sin()]).unsqueeze(-2).unsqueeze(1)
-        attention_bias = 1 - attention_mask.float()
+        attention_bias = (1 - attention_mask.float()) * torch.finfo(torch.float32).min
         hidden_states = self.embedding_layernorm(inputs_embeds + self.token_type_embeddings)
         for i in range(self.config.num_hidden_layers):
             hidden_states = self.blocks[i](hidden_states, attention_bias, rope_embeds)[0]